@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include "common/polygon_mesh.h"
+
+namespace simple_viewer {
+namespace bench {
+
+    // seconds of the fastest of repeat runs of func
+    template <typename Func>
+    double bestOf(int repeat, const Func& func) {
+        double best = std::numeric_limits<double>::max();
+        for (int i = 0; i < repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            func();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // a bumpy grid of n x n vertices facing up, its triangles in rows
+    inline common::PolygonMesh<float> grid(uint32_t n) {
+        common::PolygonMesh<float> mesh;
+        for (uint32_t y = 0; y < n; y++) {
+            for (uint32_t x = 0; x < n; x++) {
+                common::Mesh<float>::Vertex v;
+                v.position = { (float)x, std::sin(x * 0.1f) * std::cos(y * 0.1f), (float)y };
+                v.normal = { 0, 1, 0 };
+                mesh.vertices.push_back(v);
+            }
+        }
+        for (uint32_t y = 0; y + 1 < n; y++) {
+            for (uint32_t x = 0; x + 1 < n; x++) {
+                uint32_t a = y * n + x;
+                mesh.indices.insert(mesh.indices.end(), { a, a + n, a + 1, a + 1, a + n, a + n + 1 });
+            }
+        }
+        return mesh;
+    }
+
+    //// the suites, each printing its own table
+    // command queue push/pop, and submitting objects through the viewer api, headless
+    void commands();
+    // frame time of 10k and 100k spheres drawn one per call and instanced, in a window
+    void primitives();
+    // vertex cache misses of meshes as given and as reordered, and the time the reordering takes
+    void vertexCache();
+    // vertex normals on 1 to all the cores, against the face list per vertex they replaced
+    void normals();
+    // MB/s of the OBJ, PLY and STL loaders on 1 and all the cores, written to temporary files first
+    void loaders();
+
+} // namespace bench
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "command_queue.h"
+#include "opengl_viewer.h"
+
+namespace simple_viewer {
+namespace bench {
+
+    // items per second through one queue, producers pushing count items in all while one thread pops them
+    template <typename Push, typename Pop>
+    static double throughput(int producers, size_t count, const Push& push, const Pop& pop) {
+        double seconds = bestOf(3, [&]() {
+            std::vector<std::thread> threads;
+            for (int p = 0; p < producers; p++) {
+                threads.emplace_back([&, p]() {
+                    for (size_t i = p; i < count; i += producers) {
+                        while (!push((int)i)) std::this_thread::yield();
+                    }
+                });
+            }
+            int value;
+            for (size_t popped = 0; popped < count;) {
+                if (pop(value)) {
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            for (auto& thread : threads) thread.join();
+        });
+        return (double)count / seconds;
+    }
+
+    // the lock-free queue, against the mutex guarded deque it replaced
+    static void queues() {
+        const size_t count = 1 << 20;
+        std::printf("%-10s %14s %14s\n", "producers", "queue Mitem/s", "mutex Mitem/s");
+        for (int producers : { 1, 2, 4 }) {
+            CommandQueue<int> queue(1 << 16);
+            double lock_free = throughput(producers, count, [&](int v) { return queue.push(std::move(v)); },
+                                          [&](int& v) { return queue.pop(v); });
+            std::mutex mutex;
+            std::deque<int> deque;
+            double locked = throughput(producers, count, [&](int v) {
+                std::unique_lock<std::mutex> lock(mutex);
+                deque.push_back(v);
+                return true;
+            }, [&](int& v) {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (deque.empty()) return false;
+                v = deque.front();
+                deque.pop_front();
+                return true;
+            });
+            std::printf("%-10d %14.1f %14.1f\n", producers, lock_free / 1e6, locked / 1e6);
+        }
+    }
+
+    // through the api, without a window: the submitting threads drain the full queue themselves
+    static void submits() {
+        std::printf("%-10s %12s %14s %16s\n", "spheres", "add k/s", "update k/s", "batched k/s");
+        for (int count : { 10000, 100000 }) {
+            std::vector<int> ids(count);
+            double add = bestOf(1, [&]() {
+                for (int i = 0; i < count; i++) ids[i] = addObj({ OBJ_SPHERE, false, 0.5f });
+            });
+            std::vector<ObjTransform> transforms(count);
+            for (int i = 0; i < count; i++) {
+                transforms[i].obj_id = ids[i];
+                transforms[i].transform.setOrigin({ (float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000) });
+            }
+            double update = bestOf(3, [&]() {
+                for (auto& t : transforms) updateObj({ OBJ_UPDATE_TRANSFORM, t.obj_id, OBJ_SPHERE, t.transform });
+            });
+            double batched = bestOf(3, [&]() { setTransforms(transforms.data(), count); });
+            updateObj({ OBJ_CLEAR_ALL });
+            std::printf("%-10d %12.1f %14.1f %16.1f\n", count, count / add / 1e3, count / update / 1e3,
+                        count / batched / 1e3);
+        }
+    }
+
+    void commands() {
+        queues();
+        submits();
+    }
+
+} // namespace bench
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "bench.h"
+#include "mesh_loader.h"
+
+namespace simple_viewer {
+namespace bench {
+
+    static bool writeObj(const std::string& path, const common::PolygonMesh<float>& mesh) {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (file == nullptr) return false;
+        for (auto& v : mesh.vertices) {
+            std::fprintf(file, "v %f %f %f\n", v.position.x(), v.position.y(), v.position.z());
+        }
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            std::fprintf(file, "f %u %u %u\n", mesh.indices[i] + 1, mesh.indices[i + 1] + 1, mesh.indices[i + 2] + 1);
+        }
+        return std::fclose(file) == 0;
+    }
+
+    static bool writePly(const std::string& path, const common::PolygonMesh<float>& mesh, bool binary) {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) return false;
+        std::fprintf(file, "ply\nformat %s 1.0\nelement vertex %zu\nproperty float x\nproperty float y\n"
+                           "property float z\nelement face %zu\nproperty list uchar int vertex_indices\nend_header\n",
+                     binary ? "binary_little_endian" : "ascii", mesh.vertices.size(), mesh.indices.size() / 3);
+        for (auto& v : mesh.vertices) {
+            if (binary) {
+                std::fwrite(v.position.data(), sizeof(float), 3, file);
+            } else {
+                std::fprintf(file, "%f %f %f\n", v.position.x(), v.position.y(), v.position.z());
+            }
+        }
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            if (binary) {
+                unsigned char n = 3;
+                std::fwrite(&n, 1, 1, file);
+                std::fwrite(&mesh.indices[i], sizeof(uint32_t), 3, file);
+            } else {
+                std::fprintf(file, "3 %u %u %u\n", mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]);
+            }
+        }
+        return std::fclose(file) == 0;
+    }
+
+    static bool writeStl(const std::string& path, const common::PolygonMesh<float>& mesh, bool binary) {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) return false;
+        auto count = (uint32_t)(mesh.indices.size() / 3);
+        if (binary) {
+            char header[80] = "SimpleViewerBench";
+            std::fwrite(header, 1, sizeof(header), file);
+            std::fwrite(&count, sizeof(count), 1, file);
+        } else {
+            std::fprintf(file, "solid bench\n");
+        }
+        for (uint32_t t = 0; t < count; t++) {
+            auto& a = mesh.vertices[mesh.indices[t * 3]].position;
+            auto& b = mesh.vertices[mesh.indices[t * 3 + 1]].position;
+            auto& c = mesh.vertices[mesh.indices[t * 3 + 2]].position;
+            const common::Vector3<float> n = (b - a).cross(c - a).normalized();
+            if (binary) {
+                for (auto p : { &n, &a, &b, &c }) std::fwrite(p->data(), sizeof(float), 3, file);
+                uint16_t attributes = 0;
+                std::fwrite(&attributes, sizeof(attributes), 1, file);
+                continue;
+            }
+            std::fprintf(file, "facet normal %f %f %f\nouter loop\n", n.x(), n.y(), n.z());
+            for (auto p : { &a, &b, &c }) std::fprintf(file, "vertex %f %f %f\n", p->x(), p->y(), p->z());
+            std::fprintf(file, "endloop\nendfacet\n");
+        }
+        if (!binary) std::fprintf(file, "endsolid bench\n");
+        return std::fclose(file) == 0;
+    }
+
+    // OBJ positions and faces the way the example parsed them before the loaders, by stream
+    static void streamObj(const std::string& path, common::Mesh<float>& mesh) {
+        std::ifstream in(path);
+        std::string line, word;
+        while (std::getline(in, line)) {
+            std::istringstream words(line);
+            words >> word;
+            if (word == "v") {
+                common::Mesh<float>::Vertex v;
+                words >> v.position.x() >> v.position.y() >> v.position.z();
+                mesh.vertices.push_back(v);
+            } else if (word == "f") {
+                common::Mesh<float>::Face f;
+                while (words >> word) f.indices.push_back((uint32_t)std::stoi(word) - 1);
+                mesh.faces.push_back(f);
+            }
+        }
+    }
+
+    static double fileMegabytes(const std::string& path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        return (double)in.tellg() / (1 << 20);
+    }
+
+    void loaders() {
+        auto mesh = grid(1000);
+        struct File {
+            const char* name;
+            std::string path;
+        };
+        std::vector<File> files = {
+            { "obj", "sv_bench.obj" }, { "ply ascii", "sv_bench_ascii.ply" }, { "ply binary", "sv_bench_binary.ply" },
+            { "stl ascii", "sv_bench_ascii.stl" }, { "stl binary", "sv_bench_binary.stl" },
+        };
+        if (!writeObj(files[0].path, mesh) || !writePly(files[1].path, mesh, false) ||
+            !writePly(files[2].path, mesh, true) || !writeStl(files[3].path, mesh, false) ||
+            !writeStl(files[4].path, mesh, true)) {
+            std::printf("cannot write the files to the working directory\n");
+            for (auto& file : files) std::remove(file.path.c_str());
+            return;
+        }
+
+        int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+        std::printf("%-12s %8s %14s %14s\n", "file", "MB", "1 thread MB/s", "all MB/s");
+        for (auto& file : files) {
+            double megabytes = fileMegabytes(file.path);
+            double seconds[2];
+            for (int i = 0; i < 2; i++) {
+                seconds[i] = bestOf(3, [&]() {
+                    common::PolygonMesh<float> loaded;
+                    MeshLoader::load(file.path.c_str(), loaded, i == 0 ? 1 : cores);
+                });
+            }
+            std::printf("%-12s %8.1f %14.1f %14.1f\n", file.name, megabytes, megabytes / seconds[0],
+                        megabytes / seconds[1]);
+        }
+        double stream = bestOf(1, [&]() {
+            common::Mesh<float> loaded;
+            streamObj(files[0].path, loaded);
+        });
+        std::printf("%-12s %8.1f %14.1f\n", "obj stream", fileMegabytes(files[0].path),
+                    fileMegabytes(files[0].path) / stream);
+        for (auto& file : files) std::remove(file.path.c_str());
+    }
+
+} // namespace bench
+} // namespace simple_viewer
\ No newline at end of file
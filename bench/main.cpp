@@ -0,0 +1,35 @@
+#include <cstring>
+#include <cstdio>
+#include "bench.h"
+
+using namespace simple_viewer;
+
+namespace {
+
+    struct Suite {
+        const char* name;
+        void (*run)();
+        bool window;    // opens a window, only run when named
+    };
+
+    const Suite suites[] = {
+        { "commands", bench::commands, false },
+        { "primitives", bench::primitives, true },
+        { "acmr", bench::vertexCache, false },
+        { "normals", bench::normals, false },
+        { "loaders", bench::loaders, false },
+    };
+
+} // namespace
+
+// SimpleViewerBench [suite...]: the named suites, or all of those without a window
+int main(int argc, char** argv) {
+    for (auto& suite : suites) {
+        bool named = false;
+        for (int i = 1; i < argc; i++) named |= std::strcmp(argv[i], suite.name) == 0;
+        if (argc > 1 ? !named : suite.window) continue;
+        std::printf("== %s\n", suite.name);
+        suite.run();
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include <random>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "common/mesh.h"
+#include "worker_pool.h"
+
+namespace simple_viewer {
+namespace bench {
+
+    // the uniform normals as they were computed before, through a face list per vertex
+    static void adjacencyNormals(common::Mesh<float>& mesh) {
+        std::vector<std::vector<int>> faces(mesh.vertices.size());
+        for (size_t f = 0; f < mesh.faces.size(); f++) {
+            auto& face = mesh.faces[f];
+            auto& p0 = mesh.vertices[face.indices[0]].position;
+            face.normal = (mesh.vertices[face.indices[1]].position - p0)
+                    .cross(mesh.vertices[face.indices[2]].position - p0).normalized();
+            for (auto v : face.indices) faces[v].push_back((int)f);
+        }
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            common::Vector3<float> normal = common::Vector3<float>::Zero();
+            for (auto f : faces[v]) normal += mesh.faces[f].normal;
+            mesh.vertices[v].normal = normal.normalized();
+        }
+    }
+
+    // the grid with a face per triangle
+    static common::Mesh<float> faceGrid(uint32_t n) {
+        auto triangles = grid(n);
+        common::Mesh<float> mesh;
+        mesh.vertices = triangles.vertices;
+        for (size_t i = 0; i < triangles.indices.size(); i += 3) {
+            common::Mesh<float>::Face f;
+            f.indices = { triangles.indices[i], triangles.indices[i + 1], triangles.indices[i + 2] };
+            mesh.faces.push_back(f);
+        }
+        return mesh;
+    }
+
+    static void report(const char* name, const common::Mesh<float>& mesh) {
+        auto copy = mesh;
+        double adjacency = bestOf(3, [&]() { adjacencyNormals(copy); });
+        std::printf("%-10s %8s %10.1f\n", name, "before", adjacency * 1e3);
+        std::vector<int> counts = { 1, 2, 4 };
+        int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+        if (cores > 4) counts.push_back(cores);
+        for (int threads : counts) {
+            double seconds = bestOf(3, [&]() { common::Mesh<float>::perVertexNormal(copy, common::NORMAL_UNIFORM,
+                                                                                      threads); });
+            std::printf("%-10s %8d %10.1f %9.2fx\n", name, threads, seconds * 1e3, adjacency / seconds);
+        }
+    }
+
+    void normals() {
+        std::printf("%u pool workers\n%-10s %8s %10s %10s\n", WorkerPool::shared().size(), "mesh", "threads",
+                    "ms", "speedup");
+        auto rows = faceGrid(1500);
+        report("rows", rows);
+        // faces in a random order span every vertex in every part
+        std::shuffle(rows.faces.begin(), rows.faces.end(), std::mt19937(1));
+        report("shuffled", rows);
+    }
+
+} // namespace bench
+} // namespace simple_viewer
\ No newline at end of file
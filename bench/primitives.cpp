@@ -0,0 +1,56 @@
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "opengl_viewer.h"
+
+namespace simple_viewer {
+namespace bench {
+
+    void primitives() {
+        std::thread window([]() {
+            setCamera({ 0, 0, 150 }, 0, 0);
+            open("SimpleViewerBench", 1280, 720);
+        });
+        while (!isOpen()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        // a grid of spheres facing the camera, all of them in view
+        std::printf("%-10s %14s %14s %12s %12s %16s\n", "spheres", "frame ms", "instanced ms", "draw calls",
+                    "instanced", "instances/draw");
+        for (int count : { 10000, 100000 }) {
+            std::vector<ObjTransform> transforms(count);
+            for (int i = 0; i < count; i++) {
+                transforms[i].obj_id = addObj({ OBJ_SPHERE, false, 0.4f });
+                transforms[i].transform.setOrigin({ (float)(i % 100) - 50, (float)(i / 100 % 100) - 50,
+                                                    -(float)(i / 10000) });
+            }
+            setTransforms(transforms.data(), count);
+            while (true) {
+                auto stats = getStats();
+                if (stats.cmd_queue_depth == 0 && stats.objects_visible + stats.objects_culled >= (size_t)count) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            // the cpu time of the frames over two seconds, drawn one per call and then instanced
+            double frame_ms[2] = { 0, 0 };
+            ViewerStats stats[2];
+            for (int instance = 0; instance < 2; instance++) {
+                setInstancing(instance == 1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                for (int samples = 0; samples < 40; samples++) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                    stats[instance] = getStats();
+                    frame_ms[instance] += stats[instance].frame_time_ms / 40;
+                }
+            }
+            std::printf("%-10d %14.2f %14.2f %12llu %12llu %16.1f\n", count, frame_ms[0], frame_ms[1],
+                        stats[0].draw_calls, stats[1].draw_calls, stats[1].draw_calls ?
+                        (double)stats[1].draw_instances / (double)stats[1].draw_calls : 0.0);
+            updateObj({ OBJ_CLEAR_ALL });
+        }
+
+        close();
+        window.join();
+    }
+
+} // namespace bench
+} // namespace simple_viewer
\ No newline at end of file
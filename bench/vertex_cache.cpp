@@ -0,0 +1,47 @@
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "renderer.h"
+#include "mesh_loader.h"
+
+namespace simple_viewer {
+namespace bench {
+
+    static void report(const char* name, const common::PolygonMesh<float>& mesh) {
+        MeshRenderer* renderer = nullptr;
+        double seconds[2];
+        for (int optimize = 0; optimize < 2; optimize++) {
+            delete renderer;
+            seconds[optimize] = bestOf(1, [&]() {
+                renderer = new MeshRenderer(mesh, false, V_FLOAT, optimize == 1);
+            });
+        }
+        // vertex shader runs of a 16 entry FIFO cache, per triangle and for the whole mesh
+        auto triangles = (double)renderer->triangleCount();
+        std::printf("%-12s %10.0f %8.3f %8.3f %12.2f %12.2f %10.1f\n", name, triangles, renderer->acmrBefore(),
+                    renderer->acmrAfter(), renderer->acmrBefore() * triangles / 1e6,
+                    renderer->acmrAfter() * triangles / 1e6, (seconds[1] - seconds[0]) * 1e3);
+        delete renderer;
+    }
+
+    void vertexCache() {
+        std::printf("%-12s %10s %8s %8s %12s %12s %10s\n", "mesh", "triangles", "acmr", "after",
+                    "Mruns", "after", "pass ms");
+        common::PolygonMesh<float> terrain;
+        if (MeshLoader::load(DATA_DIR "terrain.obj", terrain)) report("terrain", terrain);
+
+        auto rows = grid(512);
+        report("rows", rows);
+        // the same triangles in a random order, as scanned meshes often come
+        std::vector<uint32_t> order(rows.indices.size() / 3);
+        for (uint32_t t = 0; t < order.size(); t++) order[t] = t;
+        std::shuffle(order.begin(), order.end(), std::mt19937(2));
+        auto shuffled = rows;
+        for (size_t t = 0; t < order.size(); t++) {
+            std::copy(&rows.indices[order[t] * 3], &rows.indices[order[t] * 3] + 3, &shuffled.indices[t * 3]);
+        }
+        report("shuffled", shuffled);
+    }
+
+} // namespace bench
+} // namespace simple_viewer
\ No newline at end of file
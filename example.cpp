@@ -20,29 +20,6 @@ void output_obj_debug(const common::Mesh<float>& mesh, const std::string& path)
 	ofs.close();
 }
 
-void input_obj_debug(common::Mesh<float>& mesh, const std::string& path) {
-	std::ifstream ifs(path);
-	std::string type;
-	ifs >> type;
-	while (ifs.good()) {
-		if (type == "v") {
-			float x, y, z;
-			ifs >> x >> y >> z >> type;
-			mesh.vertices.push_back({ {x, y, z}, {0, 1, 0} });
-		}
-		else {
-			mesh.faces.push_back({});
-			auto& face = mesh.faces.back().indices;
-			ifs >> type;
-			while (type != "v" && type != "f" && ifs.good()) {
-				face.push_back(std::stoi(type) - 1);
-				ifs >> type;
-			}
-		}
-	}
-	ifs.close();
-}
-
 int main()
 {
 	std::thread render_thread([] {
@@ -51,10 +28,7 @@ int main()
 		});
 
 	simple_viewer::setTargetFrameRate(60);
-	common::Mesh<float> mesh;
-	input_obj_debug(mesh, DATA_DIR "terrain.obj");
-	common::Mesh<float>::perVertexNormal(mesh);
-	int id0 = simple_viewer::addObj({ simple_viewer::OBJ_MESH, false, mesh });
+	int id0 = simple_viewer::addMeshFile(DATA_DIR "terrain.obj");
     simple_viewer::addObj({simple_viewer::OBJ_LINE, false,
                            {0.0, 1.0, 0.0, 1.0, 2.0, 0.0, 0.0, 3.0, 0.0, -1.0, 2.0, 0.0, 0.0, 1.0, 0.0}});
 	common::Transform<float> trans;
@@ -24,6 +24,8 @@ COMMON_FORCE_INLINE unsigned long long COMMON_GetMicroTickCount() {
 namespace common {
     template <typename Scalar> using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
     template <typename Scalar> using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+    template <typename Scalar> using Vector4 = Eigen::Matrix<Scalar, 4, 1>;
+    template <typename Scalar> using Matrix4 = Eigen::Matrix<Scalar, 4, 4>;
     template <typename Scalar> using Quaternion = Eigen::Quaternion<Scalar>;
 } // namespace common
 
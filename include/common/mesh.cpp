@@ -11,23 +11,146 @@ void Mesh<Scalar>::perFaceNormal(Mesh<Scalar>& mesh) {
     }
 }
 
-template <typename Scalar>
-void Mesh<Scalar>::perVertexNormal(Mesh<Scalar>& mesh) {
-    perFaceNormal(mesh);
-    int v_n = (int)mesh.vertices.size();
-    int f_n = (int)mesh.faces.size();
-    std::vector<std::vector<int>> _map(v_n);
-    for (int i = 0; i < f_n; i++) {
-        for (uint32_t j : mesh.faces[i].indices) {
-            _map[j].push_back(i);
+template <typename Body>
+void detail::parallelFor(size_t count, int threads, const Body& body) {
+    size_t step = (count + threads - 1) / std::max(threads, 1);
+    if (threads <= 1 || step == 0) {
+        body(0, count);
+        return;
+    }
+    // the same parts either way, so the results do not depend on the executor
+    size_t parts = (count + step - 1) / step;
+    auto part = [&](size_t i) { body(i * step, std::min(count, (i + 1) * step)); };
+    if (executor() == nullptr) {
+        for (size_t i = 0; i < parts; i++) part(i);
+        return;
+    }
+    executor()(parts, part);
+}
+
+namespace detail {
+
+// add(vertex, weighted normal) for every corner of the faces [first, last)
+template <typename Vertex, typename Corners, typename FaceNormal, typename Add>
+void scatterFaceNormals(const std::vector<Vertex>& vertices, size_t first, size_t last, const Corners& corners,
+                        const FaceNormal& face_normal, NormalWeight weight, const Add& add) {
+    using Vector = decltype(Vertex().position);
+    using Scalar = typename Vector::Scalar;
+    for (size_t f = first; f < last; f++) {
+        const uint32_t* indices;
+        size_t n = corners(f, indices);
+        auto& p0 = vertices[indices[0]].position;
+        Vector unit = (vertices[indices[1]].position - p0).cross(vertices[indices[2]].position - p0).normalized();
+        face_normal(f, unit);
+        if (weight == NORMAL_UNIFORM) {
+            for (size_t k = 0; k < n; k++) add(indices[k], unit);
+        } else if (weight == NORMAL_AREA) {
+            // twice the area of the polygon, as a fan of triangles
+            Vector area = Vector::Zero();
+            for (size_t k = 1; k + 1 < n; k++) {
+                area += (vertices[indices[k]].position - p0).cross(vertices[indices[k + 1]].position - p0);
+            }
+            Vector normal = unit * (area.norm() / 2);
+            for (size_t k = 0; k < n; k++) add(indices[k], normal);
+        } else {
+            // the angle at a corner is between the unit edges coming in and going out
+            Vector in = (p0 - vertices[indices[n - 1]].position).normalized();
+            for (size_t k = 0; k < n; k++) {
+                auto& next = vertices[indices[k + 1 < n ? k + 1 : 0]].position;
+                Vector out = (next - vertices[indices[k]].position).normalized();
+                Scalar cosine = std::max(Scalar(-1), std::min(Scalar(1), -in.dot(out)));
+                add(indices[k], unit * std::acos(cosine));
+                in = out;
+            }
         }
     }
-    for (int i = 0; i < v_n; i++) {
-        Vector3<Scalar> normal = Vector3<Scalar>::Zero();
-        for (auto j : _map[i]) {
-            normal += mesh.faces[j].normal;
+}
+
+} // namespace detail
+
+template <typename Vertex, typename Corners, typename FaceNormal>
+void detail::perVertexNormal(std::vector<Vertex>& vertices, size_t face_count, const Corners& corners,
+                             const FaceNormal& face_normal, NormalWeight weight, int threads) {
+    using Vector = decltype(Vertex().position);
+    using Scalar = typename Vector::Scalar;
+    size_t v_n = vertices.size();
+    size_t f_n = face_count;
+    for (size_t f = 0; f < f_n; f++) {
+        const uint32_t* indices;
+        if (corners(f, indices) < 3) {
+            throw std::runtime_error("Invalid mesh face: less than 3 vertices");
         }
-        normal /= (Scalar)_map[i].size();
-        mesh.vertices[i].normal = normal.normalized();
     }
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    // handing out the parts costs more than they save on small meshes, and is no use run serially
+    if (f_n < (1 << 14) || executor() == nullptr) threads = 1;
+
+    // the weighted face normals add up in a flat array
+    std::unique_ptr<Scalar[]> sums(new Scalar[v_n * 3]);
+    auto normalize = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            Vector normal(sums[i * 3], sums[i * 3 + 1], sums[i * 3 + 2]);
+            vertices[i].normal = normal.normalized();
+        }
+    };
+    if (threads == 1) {
+        std::fill(sums.get(), sums.get() + v_n * 3, Scalar(0));
+        scatterFaceNormals(vertices, 0, f_n, corners, face_normal, weight, [&](uint32_t v, const Vector& normal) {
+            sums[v * 3] += normal.x();
+            sums[v * 3 + 1] += normal.y();
+            sums[v * 3 + 2] += normal.z();
+        });
+        normalize(0, v_n);
+        return;
+    }
+
+    // every part adds up its faces into partial sums over the vertices they span, which stay small
+    // when the faces are in a coherent order. They are added up in the order of the parts, so the
+    // normals are the same from run to run, however the parts were scheduled
+    struct Partial {
+        size_t first = std::numeric_limits<size_t>::max(), last = 0;
+        std::vector<Scalar> sums;
+    };
+    size_t step = (f_n + threads - 1) / threads;
+    std::vector<Partial> partials((f_n + step - 1) / step);
+    parallelFor(f_n, threads, [&](size_t first, size_t last) {
+        auto& partial = partials[first / step];
+        for (size_t f = first; f < last; f++) {
+            const uint32_t* indices;
+            size_t n = corners(f, indices);
+            for (size_t k = 0; k < n; k++) {
+                partial.first = std::min(partial.first, (size_t)indices[k]);
+                partial.last = std::max(partial.last, (size_t)indices[k] + 1);
+            }
+        }
+    });
+    parallelFor(f_n, threads, [&](size_t first, size_t last) {
+        auto& partial = partials[first / step];
+        partial.sums.assign((partial.last - partial.first) * 3, Scalar(0));
+        Scalar* local = partial.sums.data() - partial.first * 3;
+        scatterFaceNormals(vertices, first, last, corners, face_normal, weight, [&](uint32_t v, const Vector& normal) {
+            local[v * 3] += normal.x();
+            local[v * 3 + 1] += normal.y();
+            local[v * 3 + 2] += normal.z();
+        });
+    });
+    parallelFor(v_n, threads, [&](size_t first, size_t last) {
+        std::fill(sums.get() + first * 3, sums.get() + last * 3, Scalar(0));
+        for (auto& partial : partials) {
+            size_t from = std::max(first, partial.first), to = std::min(last, partial.last);
+            const Scalar* local = partial.sums.data() - partial.first * 3;
+            for (size_t i = from * 3; i < to * 3; i++) sums[i] += local[i];
+        }
+        normalize(first, last);
+    });
+}
+
+template <typename Scalar>
+void Mesh<Scalar>::perVertexNormal(Mesh<Scalar>& mesh, NormalWeight weight, int threads) {
+    auto corners = [&mesh](size_t f, const uint32_t*& indices) {
+        indices = mesh.faces[f].indices.data();
+        return mesh.faces[f].indices.size();
+    };
+    auto face_normal = [&mesh](size_t f, const Vector3<Scalar>& normal) { mesh.faces[f].normal = normal; };
+    detail::perVertexNormal(mesh.vertices, mesh.faces.size(), corners, face_normal, weight, threads);
 }
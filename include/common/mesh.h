@@ -1,10 +1,44 @@
 #pragma once
 
 #include "general.h"
+#include <Eigen/Geometry>
 #include <vector>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 namespace common {
 
+    // how the normals of the faces around a vertex add up to its normal
+    enum NormalWeight {
+        NORMAL_UNIFORM = 0,     // every face counts the same
+        NORMAL_AREA,            // by its area
+        NORMAL_ANGLE            // by its angle at the vertex
+    };
+
+    namespace detail {
+        // runs body(i) for every i in [0, count), returning once all are done. Unset, the parallel
+        // loops below run serially: the viewer library points it at its worker pool, so they must not
+        // run inside a loop of that pool
+        using Executor = void (*)(size_t count, const std::function<void(size_t)>& body);
+        inline Executor& executor() {
+            static Executor executor = nullptr;
+            return executor;
+        }
+        // body(first, last) over [0, count) split into threads parts, given to the executor
+        template <typename Body>
+        void parallelFor(size_t count, int threads, const Body& body);
+        // the vertex normals of face_count faces, corners(f, indices) pointing indices at the corners of
+        // face f and returning how many, and face_normal(f, normal) given the unit normal of each face
+        template <typename Vertex, typename Corners, typename FaceNormal>
+        void perVertexNormal(std::vector<Vertex>& vertices, size_t face_count, const Corners& corners,
+                             const FaceNormal& face_normal, NormalWeight weight, int threads);
+    } // namespace detail
+
     template <typename Scalar>
     class Mesh {
     public:
@@ -29,7 +63,8 @@ namespace common {
         bool empty() const { return vertices.empty() || faces.empty(); }
 
         static void perFaceNormal(Mesh& mesh);
-        static void perVertexNormal(Mesh& mesh);
+        // also sets the face normals, in threads parts (0 for one per core) run by detail::executor()
+        static void perVertexNormal(Mesh& mesh, NormalWeight weight = NORMAL_UNIFORM, int threads = 0);
     };
 
     #include "mesh.cpp"
@@ -0,0 +1,65 @@
+template <typename Scalar>
+void PolygonMesh<Scalar>::reserve(size_t vertex_count, size_t face_count, size_t index_count) {
+    vertices.reserve(vertex_count);
+    indices.reserve(index_count);
+    if (index_count != face_count * 3) offsets.reserve(face_count + 1);
+}
+
+template <typename Scalar>
+void PolygonMesh<Scalar>::addFace(const uint32_t* corners, size_t count) {
+    if (count < 3) {
+        throw std::runtime_error("Invalid mesh face: less than 3 vertices");
+    }
+    if (offsets.empty() && count != 3) {
+        // the first polygon, the triangles before it get their offsets
+        size_t face_count = indices.size() / 3;
+        offsets.reserve(std::max(offsets.capacity(), face_count + 2));
+        for (size_t f = 0; f <= face_count; f++) offsets.push_back((uint32_t)(f * 3));
+    }
+    indices.insert(indices.end(), corners, corners + count);
+    if (!offsets.empty()) offsets.push_back((uint32_t)indices.size());
+}
+
+template <typename Scalar>
+void PolygonMesh<Scalar>::clear() {
+    vertices.clear();
+    indices.clear();
+    offsets.clear();
+}
+
+template <typename Scalar>
+PolygonMesh<Scalar> PolygonMesh<Scalar>::fromMesh(const Mesh<Scalar>& mesh) {
+    PolygonMesh result;
+    size_t index_count = 0;
+    for (auto& face : mesh.faces) index_count += face.indices.size();
+    result.reserve(0, mesh.faces.size(), index_count);
+    result.vertices = mesh.vertices;
+    for (auto& face : mesh.faces) result.addFace(face.indices.data(), face.indices.size());
+    return result;
+}
+
+template <typename Scalar>
+Mesh<Scalar> PolygonMesh<Scalar>::toMesh() const {
+    Mesh<Scalar> mesh;
+    mesh.vertices = vertices;
+    mesh.faces.resize(faceCount());
+    for (size_t f = 0; f < mesh.faces.size(); f++) {
+        const uint32_t* corners = face(f);
+        mesh.faces[f].indices.assign(corners, corners + faceSize(f));
+        mesh.faces[f].normal = Vector3<Scalar>::Zero();
+    }
+    return mesh;
+}
+
+template <typename Scalar>
+void PolygonMesh<Scalar>::perVertexNormal(PolygonMesh<Scalar>& mesh, NormalWeight weight, int threads) {
+    if (!mesh.offsets.empty() && (mesh.offsets.front() != 0 || mesh.offsets.back() != mesh.indices.size())) {
+        throw std::runtime_error("Invalid mesh offsets: not covering the indices");
+    }
+    auto corners = [&mesh](size_t f, const uint32_t*& indices) {
+        indices = mesh.face(f);
+        return mesh.faceSize(f);
+    };
+    auto face_normal = [](size_t, const Vector3<Scalar>&) {};
+    detail::perVertexNormal(mesh.vertices, mesh.faceCount(), corners, face_normal, weight, threads);
+}
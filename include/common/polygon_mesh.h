@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mesh.h"
+#include <vector>
+#include <cstdint>
+
+namespace common {
+
+    /**
+     * The faces of a mesh in two flat arrays instead of a vector each: the
+     * corners of all of them one after the other, and where every face starts.
+     * A mesh of triangles needs no offsets at all.
+     */
+    template <typename Scalar>
+    class PolygonMesh {
+    public:
+        using Vertex = typename Mesh<Scalar>::Vertex;
+
+        std::vector<Vertex> vertices;
+        // corners of the faces, face after face
+        std::vector<uint32_t> indices;
+        // face f has the corners [offsets[f], offsets[f + 1]), empty while all faces are triangles
+        std::vector<uint32_t> offsets;
+
+        PolygonMesh() {}
+        // triangles, 3 indices each
+        PolygonMesh(std::vector<Vertex> vs, std::vector<uint32_t> is):
+            vertices(std::move(vs)), indices(std::move(is)) {}
+        PolygonMesh(std::vector<Vertex> vs, std::vector<uint32_t> is, std::vector<uint32_t> os):
+            vertices(std::move(vs)), indices(std::move(is)), offsets(std::move(os)) {}
+
+        bool empty() const { return vertices.empty() || indices.empty(); }
+        bool isTriangles() const { return offsets.empty(); }
+        size_t faceCount() const { return offsets.empty() ? indices.size() / 3 : offsets.size() - 1; }
+        size_t faceBegin(size_t f) const { return offsets.empty() ? f * 3 : offsets[f]; }
+        size_t faceSize(size_t f) const { return offsets.empty() ? 3 : offsets[f + 1] - offsets[f]; }
+        const uint32_t* face(size_t f) const { return indices.data() + faceBegin(f); }
+        // of the faces split into fans
+        size_t triangleCount() const { return offsets.empty() ? indices.size() / 3 : indices.size() - 2 * faceCount(); }
+
+        void reserve(size_t vertex_count, size_t face_count, size_t index_count);
+        void addFace(const uint32_t* corners, size_t count);
+        void clear();
+
+        // copies the faces of a mesh, without their normals
+        static PolygonMesh fromMesh(const Mesh<Scalar>& mesh);
+        Mesh<Scalar> toMesh() const;
+
+        // as Mesh::perVertexNormal, the face normals being left out
+        static void perVertexNormal(PolygonMesh& mesh, NormalWeight weight = NORMAL_UNIFORM, int threads = 0);
+    };
+
+    #include "polygon_mesh.cpp"
+
+} // namespace common
\ No newline at end of file
@@ -32,12 +32,41 @@
  * - When calling OpenglViewer::addObj() or OpenglViewer::updateObj(), the parameter MUST be 
  *   in consistency with the "ObjType" or "ObjUpdateType", or something not expected will 
  *   happen. Please check the struct ObjInitParam and ObjUpdateParam for more information.
+ * - Object commands are put into a lock-free queue and applied by the render thread at the
+ *   start of the next frame, so adding/updating objects never waits for drawing. Commands
+ *   from one thread are applied in the order they were issued.
+ * - Transform, color and visibility updates (OBJ_UPDATE_TRANSFORM/COLOR/VISIBLE) skip the
+ *   queue: they are written into a versioned per-object state which the render thread
+ *   snapshots at frame start, so a frame never shows a half-written transform.
+ * - Updates of the same kind to one object between two frames coalesce: only the newest
+ *   transform/color/visibility is read, and only the newest geometry is loaded and uploaded.
+ *   Vertex updates (updateMeshVertices()) of a dynamic mesh accumulate instead, and are applied
+ *   after any new geometry, uploading only the vertices they changed. New geometry with the
+ *   faces of the loaded one (OBJ_UPDATE_MESH) is applied the same way, as a vertex update.
+ * - Object ids are handles of a generational slot map: the slot of a deleted object is
+ *   reused, but its old id stays invalid.
+ * - Primitives (cube/cylinder/cone/sphere) of one type share a single unit geometry on the GPU
+ *   scaled per object in the shader, so resizing one is cheap, and all the primitives of a
+ *   type are drawn together with a single instanced draw call per frame.
+ * - The bounds of the shown objects are kept in a dynamic AABB tree, refitted when objects
+ *   move and rebuilt in the background when it degrades. It culls the objects outside of the
+ *   view frustum (on worker threads when there are many), and answers raycast(), overlap()
+ *   and nearest() from any thread, as of the last drawn frame.
+ * - Meshes are split into spatial chunks of up to 64k vertices, culled one by one. Large
+ *   static meshes are simplified chunk by chunk into levels of detail in the background,
+ *   and every chunk is drawn at the coarsest level that looks the same on screen, see
+ *   setLodOptions(). Their indices are 16 bit, and their vertices can be quantized to 8 or
+ *   12 bytes instead of 24, see VertexFormat.
+ * - Meshes added from files by addMeshFile() are cached next to them as uploaded, levels of
+ *   detail included, and later added by mapping the cache and uploading it as it is.
  */
 
 #pragma once
 
 #include <vector>
+#include <limits>
 #include "common/mesh.h"
+#include "common/polygon_mesh.h"
 #include "common/transform.h"
 
 #ifdef _MSC_VER
@@ -73,20 +102,45 @@ namespace simple_viewer {
         OBJ_UPDATE_LINE_WIDTH,
         OBJ_DEL,
         OBJ_CLEAR_ALL_TYPE,
-        OBJ_CLEAR_ALL
+        OBJ_CLEAR_ALL,
+        OBJ_UPDATE_VISIBLE
+    };
+
+    // vertex format of meshes on the gpu, must be consistent with the VertexLayout in renderer.h
+    enum VertexFormat {
+        VERTEX_DEFAULT = 0,         // the one set by setVertexFormat()
+        VERTEX_FLOAT = 1,           // float position and normal: 24 bytes
+        VERTEX_COMPACT = 2,         // 16 bit position, 2x16 bit octahedral normal: 12 bytes
+        VERTEX_COMPACT_SMALL = 3    // 16 bit position, 2x8 bit octahedral normal: 8 bytes
+    };
+
+    // what becomes of the cpu copy of static geometry once uploaded, must be consistent with the
+    // CachePolicy in geometry_cache.h. The released ones are read back from the gpu when the window
+    // closes, and uploaded again from there when it reopens.
+    enum MemoryPolicy {
+        MEMORY_DEFAULT = 0,         // the one set by setMemoryPolicy()
+        MEMORY_KEEP = 1,            // keep the copy for the lifetime of the object
+        MEMORY_RELEASE = 2,         // release it, and keep the read back bytes in memory
+        MEMORY_COMPRESSED = 3,      // release it, and keep the read back bytes compressed
+        MEMORY_DISK = 4             // release it, and keep the read back bytes (compressed) in a temporary file
     };
 
     // object initialize parameter
     struct ObjInitParam {
         ObjType type = ObjType::OBJ_NONE;
         bool dynamic = false;
+        VertexFormat vertex_format = VertexFormat::VERTEX_DEFAULT;     // of meshes
+        MemoryPolicy memory_policy = MemoryPolicy::MEMORY_DEFAULT;     // of static meshes and lines
         union {
             common::Mesh<float> mesh;
             common::Vector3<float> size;
             std::vector<float> line;
         };
+        common::PolygonMesh<float> polygon_mesh;                        // of OBJ_MESH, used instead of mesh if set
         ObjInitParam(ObjType _type, bool _dynamic, common::Mesh<float> _mesh):  // NOLINT
                 type(_type), dynamic(_dynamic), mesh(std::move(_mesh)) {}
+        ObjInitParam(ObjType _type, bool _dynamic, common::PolygonMesh<float> _mesh):   // NOLINT
+                type(_type), dynamic(_dynamic), mesh(), polygon_mesh(std::move(_mesh)) {}
         ObjInitParam(ObjType _type, bool _dynamic, float x, float y, float z):  // NOLINT
                 type(_type), dynamic(_dynamic), size({ x, y, z }) {}
         ObjInitParam(ObjType _type, bool _dynamic, float radius, float height): // NOLINT
@@ -109,6 +163,7 @@ namespace simple_viewer {
             common::Mesh<float> mesh;
             std::vector<float> line;
         };
+        common::PolygonMesh<float> polygon_mesh;        // of OBJ_UPDATE_MESH, used instead of mesh if set
         ObjUpdateParam(ObjUpdateType _act_type, int _obj_id, int _obj_type, const common::Transform<float>& _transform): // NOLINT
             act_type(_act_type), obj_id(_obj_id), obj_type(_obj_type), transform(_transform) {}
         ObjUpdateParam(ObjUpdateType _act_type, int _obj_id, int _obj_type, const common::Vector3<float>& color):        // NOLINT
@@ -121,6 +176,8 @@ namespace simple_viewer {
                 act_type(_act_type), obj_id(_obj_id), obj_type(_obj_type), vec({ single, 0, 0 }) {}
         ObjUpdateParam(ObjUpdateType _act_type, int _obj_id, int _obj_type, common::Mesh<float> _mesh):   // NOLINT
             act_type(_act_type), obj_id(_obj_id), obj_type(_obj_type), mesh(std::move(_mesh)) {}
+        ObjUpdateParam(ObjUpdateType _act_type, int _obj_id, int _obj_type, common::PolygonMesh<float> _mesh):  // NOLINT
+            act_type(_act_type), obj_id(_obj_id), obj_type(_obj_type), mesh(), polygon_mesh(std::move(_mesh)) {}
         ObjUpdateParam(ObjUpdateType _act_type, int _obj_id, int _obj_type, std::vector<float> _line):    // NOLINT
             act_type(_act_type), obj_id(_obj_id), obj_type(_obj_type), line(std::move(_line)) {}
         ObjUpdateParam(ObjUpdateType _act_type, int _obj_id, int _obj_type):                              // NOLINT
@@ -130,6 +187,83 @@ namespace simple_viewer {
         ~ObjUpdateParam() { /* no effect but non-trivial */ }                                             // NOLINT
     };
 
+    // object transform for batched updates
+    struct ObjTransform {
+        int obj_id = -1;
+        common::Transform<float> transform;
+    };
+
+    // rotation layout of raw pose arrays
+    enum PoseFormat {
+        POSE_QUATERNION = 0,    // x, y, z, w
+        POSE_MATRIX3 = 1        // 3x3, column-major
+    };
+
+    // level of detail of large static meshes
+    struct LodOptions {
+        bool enabled = true;
+        float target_error = 1.f;                   // allowed screen space error, in pixels
+        unsigned long long min_triangles = 4096;    // smaller meshes are always drawn in full
+        unsigned long long triangle_budget = 0;     // triangles drawn per frame, 0 for no budget
+        bool coarser_when_moving = false;           // draw one level coarser while the camera moves
+    };
+
+    // levels of detail drawn for a mesh in the last frame
+    struct ObjLod {
+        int obj_id = -1;
+        int level = 0;                              // finest level of its chunks drawn, 0 is the full mesh
+        int levels = 1;                             // of its longest chunk chain
+        int chunks = 0;                             // chunks drawn
+        unsigned long long triangles = 0;
+    };
+
+    // viewer statistics
+    struct ViewerStats {
+        // command queue
+        unsigned long long cmd_queue_depth = 0;     // commands waiting for the render thread
+        unsigned long long cmd_queue_capacity = 0;
+        unsigned long long cmd_queue_overflow = 0;  // pushes that found the queue full
+        unsigned long long cmd_dropped = 0;         // commands lost because the queue stayed full
+        unsigned long long cmd_rejected = 0;        // commands that referred to a missing object
+        unsigned long long tx_committed = 0;        // committed transactions
+        unsigned long long cmd_applied = 0;         // updates taken by the render thread
+        unsigned long long cmd_coalesced = 0;       // updates superseded before the next frame
+        // gl state of the last frame
+        unsigned long long gl_calls = 0;            // uniform/state calls issued
+        unsigned long long gl_calls_elided = 0;     // redundant uniform/state calls skipped
+        unsigned long long draw_calls = 0;          // draw calls issued for the objects
+        unsigned long long draw_instances = 0;      // objects drawn by those calls
+        float frame_time_ms = 0;                    // cpu time spent building and submitting the frame
+        unsigned long long objects_visible = 0;     // shown objects inside the view frustum
+        unsigned long long objects_culled = 0;      // shown objects skipped as outside of it
+        unsigned long long tree_rebuilds = 0;       // background rebuilds of the scene tree
+        float tree_cost = 0;                        // surface area cost of the scene tree
+        unsigned long long triangles_drawn = 0;     // triangles of the objects inside the view frustum
+        unsigned long long chunks_culled = 0;       // mesh chunks outside of the view frustum
+        unsigned long long mesh_vertex_bytes = 0;   // gpu memory of the mesh vertices, in their formats
+        unsigned long long mesh_index_bytes = 0;    // and of their indices, without levels of detail
+        unsigned long long mesh_float_bytes = 0;    // the same as float vertices and 32 bit indices
+        float mesh_acmr_before = 0;                 // vertex cache misses per mesh triangle, as given
+        float mesh_acmr_after = 0;                  // and as drawn (0.5 at best, 3 at worst)
+        unsigned long long mesh_cpu_bytes = 0;      // cpu memory of the mesh geometry, copied, mapped or cached
+        unsigned long long mesh_cache_hits = 0;     // meshes added from the cache of their file by addMeshFile()
+        unsigned long long mesh_cache_misses = 0;   // and loaded from the file itself, the cache being written
+        unsigned long long ring_uploads = 0;        // dynamic geometry updates written into a ring partition
+        unsigned long long ring_reallocations = 0;  // of which grew the ring, reallocating it
+        unsigned long long frame_waits = 0;         // frames that waited for the gpu to finish an older one
+        float lod_error = 0;                        // screen space error used, raised to meet the budget
+        std::vector<ObjLod> lods;                   // visible meshes with levels of detail
+    };
+
+    /**
+     * @brief Result of a pick, obj_id is -1 if nothing is under the pixel
+     */
+    struct PickResult {
+        int obj_id = -1;
+        int triangle = -1;      // index of the triangle hit, faces being split into triangle fans
+        common::Vector3<float> point = common::Vector3<float>::Zero();  // world space
+    };
+
     //// Window
     /**
      * @brief Open a opengl window
@@ -172,13 +306,84 @@ namespace simple_viewer {
     /**
      * @brief Add a object
      * @param param Object initialize parameter (referring to struct PbjInitParam)
+     * @return object id, or -1 if the command queue is full
      */
     SV_API int addObj(const ObjInitParam& param);
     /**
      * @brief Update a object
      * @param param Object Update parameter (referring to struct PbjUpdateParam)
+     * @return whether the command is queued (false for an unknown id or a full queue)
      */
     SV_API bool updateObj(const ObjUpdateParam& param);
+    /**
+     * @brief Update the transforms of many objects with one command
+     * @param transforms (id, transform) pairs
+     * @param count number of pairs
+     * @param stride bytes between two pairs (0 for tightly packed)
+     * @return whether the command is queued
+     */
+    SV_API bool setTransforms(const ObjTransform* transforms, int count, int stride = 0);
+    /**
+     * @brief Update the transforms of many objects from raw (e.g. SoA) pose arrays
+     * @param ids object ids
+     * @param positions x, y, z of each object
+     * @param rotations rotation of each object in the given format (nullptr for identity)
+     * @param count number of objects
+     * @param format rotation layout (referring to enum PoseFormat)
+     * @param id_stride bytes between two ids (0 for tightly packed)
+     * @param position_stride bytes between two positions (0 for tightly packed)
+     * @param rotation_stride bytes between two rotations (0 for tightly packed)
+     * @return whether the command is queued
+     */
+    SV_API bool setTransforms(const int* ids, const float* positions, const float* rotations, int count,
+                              PoseFormat format = POSE_QUATERNION,
+                              int id_stride = 0, int position_stride = 0, int rotation_stride = 0);
+    /**
+     * @brief Update the positions and/or normals of some vertices of a dynamic mesh, keeping its
+     * faces, so only the changed vertices are uploaded and the indices are kept
+     * @param id object id of the mesh
+     * @param first first vertex, in the order of the mesh vertices
+     * @param count number of vertices
+     * @param positions x, y, z of each vertex (nullptr to keep them)
+     * @param normals x, y, z of each vertex (nullptr to keep them, even if the positions change)
+     * @return whether the command is queued, false if the mesh is not dynamic or the vertices are
+     * out of the range of its last given vertices
+     */
+    SV_API bool updateMeshVertices(int id, int first, int count, const float* positions, const float* normals);
+
+    //// Transaction
+    /**
+     * @brief Begin a transaction on the calling thread: the following addObj/updateObj/
+     * setTransforms calls of this thread are recorded instead of being applied (nestable)
+     */
+    SV_API void beginUpdate();
+    /**
+     * @brief Commit the transaction of the calling thread: all the recorded commands are
+     * pushed as one group and become visible in the same frame. The ids deleted by the
+     * transaction stay valid for its later commands, and become stale here
+     * @return whether the group is queued (true for an inner, nested commit)
+     */
+    SV_API bool commitUpdate();
+
+    /**
+     * @brief Scoped transaction, committed by commit(), or when it goes out of scope if not
+     * committed before. Only commit() tells whether the group was queued
+     */
+    class SceneTransaction {
+    public:
+        SceneTransaction(): _committed(false) { beginUpdate(); }
+        SceneTransaction(const SceneTransaction& other) = delete;
+        ~SceneTransaction() { if (!_committed) commitUpdate(); }
+        // see commitUpdate(), once
+        bool commit() {
+            if (_committed) return false;
+            _committed = true;
+            return commitUpdate();
+        }
+
+    private:
+        bool _committed;
+    };
 
     //// Axis and Line
     /**
@@ -192,6 +397,65 @@ namespace simple_viewer {
      */
     SV_API void showLine(bool show = true, int width = 1);
 
+    //// Vertex format
+    /**
+     * @brief Set the vertex format of the meshes added later with VERTEX_DEFAULT (VERTEX_FLOAT
+     * initially). The compact formats quantize positions to 16 bits within the bounds of the
+     * mesh, so their precision is its largest side / 65535.
+     */
+    SV_API void setVertexFormat(VertexFormat format);
+    /**
+     * @brief Reorder the triangles of the meshes added later for the vertex cache, and their
+     * vertices in the order they are fetched (true by default). Costs some time in addObj().
+     */
+    SV_API void setMeshOptimization(bool optimize = true);
+
+    //// Memory
+    /**
+     * @brief Set what becomes of the cpu copy of the static meshes and lines added later with
+     * MEMORY_DEFAULT (MEMORY_KEEP initially). The positions and indices picking keeps follow the
+     * policy too: compressed or on disk they are loaded again by the first pick, and released
+     * (MEMORY_RELEASE) they are read back from the gpu by the next frames, so pick() misses such a
+     * mesh until a frame after its first pick. pickBuffer() is unaffected.
+     */
+    SV_API void setMemoryPolicy(MemoryPolicy policy);
+
+    //// Level of detail
+    /**
+     * @brief Set how large static meshes are simplified and drawn. The chunks of each mesh with
+     * at least min_triangles get a chain of simplified levels, built on a background thread
+     * after it is uploaded, and every frame draws each chunk at the coarsest level whose error
+     * projects to at most target_error pixels. When the triangles drawn exceed triangle_budget, the error allowed
+     * is doubled until they fit (up to 8 times).
+     */
+    SV_API void setLodOptions(const LodOptions& options);
+    SV_API LodOptions getLodOptions();
+
+    //// Mesh file
+    /**
+     * @brief Load a mesh from an OBJ, PLY or STL file, text or binary, by its extension. The
+     * file is mapped into memory and parsed in parallel. Vertex normals are read from PLY files
+     * that have them, and computed otherwise. Texture coordinates and materials are left out.
+     * @param path path of the file
+     * @param mesh the mesh loaded, triangles keeping flat indices without offsets
+     * @param threads threads to parse on (0 for one per core)
+     * @return false if the file cannot be read, is not valid or has no faces, leaving mesh empty
+     */
+    SV_API bool loadMeshFile(const std::string& path, common::PolygonMesh<float>& mesh, int threads = 0);
+    SV_API bool loadMeshFile(const std::string& path, common::Mesh<float>& mesh, int threads = 0);
+    /**
+     * @brief Add a static mesh from a file, through a cache next to it ("<path>.svmc"). The cache
+     * holds the mesh as uploaded: its chunks, vertices in their format, indices and levels of
+     * detail, so a valid one is mapped and uploaded without parsing. It is valid for the same file
+     * (by its size and time, or by its hash once they change), vertex format and setMeshOptimization().
+     * Otherwise the file is loaded as by loadMeshFile(), and the cache written by a worker thread,
+     * with the levels of detail of the current setLodOptions(). Closing the window waits for it.
+     * @param path path of an OBJ, PLY or STL file
+     * @param format vertex format of the mesh
+     * @return object id, or -1 if the file cannot be loaded or the command queue is full
+     */
+    SV_API int addMeshFile(const std::string& path, VertexFormat format = VERTEX_DEFAULT);
+
     //// State
     /**
      * @brief Mouse state: 0 pressed, 1 released, 2 pressing down, 3 releasing up
@@ -209,4 +473,52 @@ namespace simple_viewer {
      */
     SV_API int getKeyState(char key);
 
+    //// Scene queries, on the bounding boxes of the shown objects as of the last drawn frame
+    /**
+     * @brief Cast a ray
+     * @param origin start of the ray
+     * @param direction direction of the ray, need not be normalized
+     * @param max_distance length of the ray
+     * @return ids of the objects whose box is hit, nearest first
+     */
+    SV_API std::vector<int> raycast(const common::Vector3<float>& origin, const common::Vector3<float>& direction,
+                                    float max_distance = std::numeric_limits<float>::max());
+    /**
+     * @brief Find the objects whose box overlaps an axis-aligned box
+     * @return ids of the objects, in no particular order
+     */
+    SV_API std::vector<int> overlap(const common::Vector3<float>& min, const common::Vector3<float>& max);
+    /**
+     * @brief Find the object whose box is nearest to a point (0 inside the box)
+     * @param distance if not null, receives the distance to the box
+     * @return id of the object, -1 if there is none within max_distance
+     */
+    SV_API int nearest(const common::Vector3<float>& point,
+                       float max_distance = std::numeric_limits<float>::max(), float* distance = nullptr);
+
+    /**
+     * @brief Pick the object under a window pixel (from the top-left corner), by casting a
+     * ray through the scene tree, then the triangle tree of the objects it hits. The triangle
+     * tree of an object is built by its first pick. Never waits for the render thread, so a mesh
+     * released with MEMORY_RELEASE is missed until its triangles are read back (see setMemoryPolicy()).
+     */
+    SV_API PickResult pick(int x, int y);
+    /**
+     * @brief Pick the object under a window pixel by reading back an id buffer, rendered by
+     * the next frame on request and read back without stalling it, so answered a frame or two
+     * later. Waits for that frame, so never call it in a viewer callback.
+     */
+    SV_API PickResult pickBuffer(int x, int y);
+
+    //// Statistics
+    /**
+     * @brief Get a snapshot of the viewer statistics
+     */
+    SV_API ViewerStats getStats();
+    /**
+     * @brief Draw each run of objects sharing their geometry by one instanced call (true by
+     * default). False draws them one per call, to measure what instancing saves.
+     */
+    SV_API void setInstancing(bool instance = true);
+
 } // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "bounds.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace simple_viewer {
+
+    Bounds Bounds::fromVertices(const float* vertices, size_t count, size_t stride) {
+        Bounds bounds;
+        if (vertices == nullptr || count == 0) return bounds;
+        bounds.min = bounds.max = Eigen::Map<const common::Vector3<float>>(vertices);
+        for (size_t i = 1; i < count; i++) {
+            Eigen::Map<const common::Vector3<float>> v(vertices + i * stride);
+            bounds.min = bounds.min.cwiseMin(v);
+            bounds.max = bounds.max.cwiseMax(v);
+        }
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        float radius2 = 0;
+        for (size_t i = 0; i < count; i++) {
+            Eigen::Map<const common::Vector3<float>> v(vertices + i * stride);
+            radius2 = std::max(radius2, (v - bounds.center).squaredNorm());
+        }
+        bounds.radius = std::sqrt(radius2);
+        return bounds;
+    }
+
+    Bounds Bounds::transformed(const common::Transform<float>& transform,
+                               const common::Vector3<float>& scale) const {
+        auto& basis = transform.getBasis();
+        auto& origin = transform.getOrigin();
+        common::Vector3<float> box_center = (min + max).cwiseProduct(scale) * 0.5f;
+        common::Vector3<float> box_extent = (max - min).cwiseProduct(scale.cwiseAbs()) * 0.5f;
+        box_center = basis * box_center + origin;
+        box_extent = basis.cwiseAbs() * box_extent;
+
+        Bounds bounds;
+        bounds.min = box_center - box_extent;
+        bounds.max = box_center + box_extent;
+        bounds.center = basis * center.cwiseProduct(scale) + origin;
+        bounds.radius = radius * scale.cwiseAbs().maxCoeff();
+        return bounds;
+    }
+
+    Frustum::Frustum(const common::Matrix4<float>& view_proj) {
+        // left, right, bottom, top, near, far
+        for (int i = 0; i < 3; i++) {
+            _planes[i * 2] = (view_proj.row(3) + view_proj.row(i)).transpose();
+            _planes[i * 2 + 1] = (view_proj.row(3) - view_proj.row(i)).transpose();
+        }
+        for (auto& plane : _planes) {
+            float norm = plane.head<3>().norm();
+            if (norm > 0) plane /= norm;
+        }
+    }
+
+    bool Frustum::intersects(const Bounds& bounds) const {
+        for (auto& plane : _planes) {
+            auto normal = plane.head<3>();
+            if (normal.dot(bounds.center) + plane.w() < -bounds.radius) return false;
+            // the box corner furthest along the plane normal
+            common::Vector3<float> corner = (normal.array() >= 0).select(bounds.max, bounds.min);
+            if (normal.dot(corner) + plane.w() < 0) return false;
+        }
+        return true;
+    }
+
+    Frustum::Result Frustum::test(const common::Vector3<float>& min, const common::Vector3<float>& max) const {
+        auto result = Result::INSIDE;
+        for (auto& plane : _planes) {
+            auto normal = plane.head<3>();
+            // the box corners furthest along and against the plane normal
+            common::Vector3<float> far = (normal.array() >= 0).select(max, min);
+            common::Vector3<float> near = (normal.array() >= 0).select(min, max);
+            if (normal.dot(far) + plane.w() < 0) return Result::OUTSIDE;
+            if (normal.dot(near) + plane.w() < 0) result = Result::INTERSECTING;
+        }
+        return result;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include "common/general.h"
+#include "common/transform.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief Axis-aligned box and bounding sphere of some geometry
+     */
+    struct Bounds {
+        common::Vector3<float> min = common::Vector3<float>::Zero();
+        common::Vector3<float> max = common::Vector3<float>::Zero();
+        common::Vector3<float> center = common::Vector3<float>::Zero();
+        float radius = 0;
+
+        // bounds of interleaved vertices, whose position is the first 3 floats of every stride
+        static Bounds fromVertices(const float* vertices, size_t count, size_t stride);
+        // bounds of the geometry scaled, then placed by transform
+        Bounds transformed(const common::Transform<float>& transform, const common::Vector3<float>& scale) const;
+    };
+
+    /**
+     * @brief The six clip planes of a view-projection matrix, pointing inwards
+     */
+    class Frustum {
+    public:
+        enum Result { OUTSIDE, INTERSECTING, INSIDE };
+
+        explicit Frustum(const common::Matrix4<float>& view_proj);
+
+        // conservative: may accept some bounds that are just outside a corner
+        bool intersects(const Bounds& bounds) const;
+        Result test(const common::Vector3<float>& min, const common::Vector3<float>& max) const;
+
+    private:
+        common::Vector4<float> _planes[6];
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
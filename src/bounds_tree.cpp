@@ -0,0 +1,409 @@
+#include "bounds_tree.h"
+
+#include <deque>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace simple_viewer {
+
+    static float area(const common::Vector3<float>& min, const common::Vector3<float>& max) {
+        common::Vector3<float> d = (max - min).cwiseMax(0);
+        return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+
+    BoundsTree::BoundsTree(): _root(-1), _leaf_count(0), _internal_area(0) {}
+
+    int BoundsTree::allocate() {
+        int node;
+        if (!_free.empty()) {
+            node = _free.back();
+            _free.pop_back();
+        } else {
+            node = (int)_nodes.size();
+            _nodes.emplace_back();
+        }
+        auto& n = _nodes[node];
+        n.min = n.max = common::Vector3<float>::Zero();
+        n.parent = n.child[0] = n.child[1] = n.id = -1;
+        return node;
+    }
+
+    void BoundsTree::release(int node) {
+        if (!_nodes[node].isLeaf()) _internal_area -= area(_nodes[node].min, _nodes[node].max);
+        _nodes[node].parent = -1;
+        _free.push_back(node);
+    }
+
+    void BoundsTree::setBox(int node, const common::Vector3<float>& min, const common::Vector3<float>& max) {
+        auto& n = _nodes[node];
+        if (!n.isLeaf()) _internal_area += area(min, max) - area(n.min, n.max);
+        n.min = min;
+        n.max = max;
+    }
+
+    void BoundsTree::refit(int node) {
+        while (node >= 0) {
+            auto& n = _nodes[node];
+            auto& a = _nodes[n.child[0]];
+            auto& b = _nodes[n.child[1]];
+            common::Vector3<float> min = a.min.cwiseMin(b.min), max = a.max.cwiseMax(b.max);
+            // ancestors can only change if this box did
+            if (min == n.min && max == n.max) return;
+            setBox(node, min, max);
+            node = n.parent;
+        }
+    }
+
+    int BoundsTree::insert(int id, const Bounds& bounds) {
+        int leaf = allocate();
+        _nodes[leaf].id = id;
+        setBox(leaf, bounds.min, bounds.max);
+        _leaf_count++;
+        if (_root < 0) {
+            _root = leaf;
+            return leaf;
+        }
+
+        // descend towards the child whose area grows least
+        int sibling = _root;
+        while (!_nodes[sibling].isLeaf()) {
+            auto& n = _nodes[sibling];
+            float grow[2];
+            for (int i = 0; i < 2; i++) {
+                auto& c = _nodes[n.child[i]];
+                grow[i] = area(c.min.cwiseMin(bounds.min), c.max.cwiseMax(bounds.max)) - area(c.min, c.max);
+            }
+            sibling = n.child[grow[0] <= grow[1] ? 0 : 1];
+        }
+
+        // a new parent takes the place of the sibling
+        int parent = allocate();
+        int old_parent = _nodes[sibling].parent;
+        _nodes[parent].parent = old_parent;
+        _nodes[parent].child[0] = sibling;
+        _nodes[parent].child[1] = leaf;
+        _nodes[sibling].parent = parent;
+        _nodes[leaf].parent = parent;
+        if (old_parent < 0) {
+            _root = parent;
+        } else {
+            auto& p = _nodes[old_parent];
+            p.child[p.child[0] == sibling ? 0 : 1] = parent;
+        }
+        setBox(parent, _nodes[sibling].min.cwiseMin(bounds.min), _nodes[sibling].max.cwiseMax(bounds.max));
+        if (old_parent >= 0) refit(old_parent);
+        return leaf;
+    }
+
+    void BoundsTree::remove(int leaf) {
+        _leaf_count--;
+        int parent = _nodes[leaf].parent;
+        release(leaf);
+        if (parent < 0) {
+            _root = -1;
+            return;
+        }
+
+        // the sibling takes the place of the parent
+        auto& p = _nodes[parent];
+        int sibling = p.child[p.child[0] == leaf ? 1 : 0];
+        int grand = p.parent;
+        _nodes[sibling].parent = grand;
+        release(parent);
+        if (grand < 0) {
+            _root = sibling;
+        } else {
+            auto& g = _nodes[grand];
+            g.child[g.child[0] == parent ? 0 : 1] = sibling;
+            refit(grand);
+        }
+    }
+
+    void BoundsTree::update(int leaf, const Bounds& bounds) {
+        setBox(leaf, bounds.min, bounds.max);
+        if (_nodes[leaf].parent >= 0) refit(_nodes[leaf].parent);
+    }
+
+    void BoundsTree::assign(int leaf, const Bounds& bounds) {
+        setBox(leaf, bounds.min, bounds.max);
+    }
+
+    void BoundsTree::refitAll() {
+        if (_root < 0) return;
+        // post-order walk, children before their parent
+        std::vector<int> order, stack = { _root };
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+            if (_nodes[node].isLeaf()) continue;
+            order.push_back(node);
+            stack.push_back(_nodes[node].child[0]);
+            stack.push_back(_nodes[node].child[1]);
+        }
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            auto& n = _nodes[*it];
+            setBox(*it, _nodes[n.child[0]].min.cwiseMin(_nodes[n.child[1]].min),
+                   _nodes[n.child[0]].max.cwiseMax(_nodes[n.child[1]].max));
+        }
+    }
+
+    std::vector<BoundsTree::Leaf> BoundsTree::leaves() const {
+        std::vector<Leaf> leaves;
+        leaves.reserve(_leaf_count);
+        forEachLeaf([&](int node, int id) {
+            leaves.push_back({ id, _nodes[node].min, _nodes[node].max });
+        });
+        return leaves;
+    }
+
+    void BoundsTree::forEachLeaf(const std::function<void(int, int)>& func) const {
+        if (_root < 0) return;
+        std::vector<int> stack = { _root };
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+            auto& n = _nodes[node];
+            if (n.isLeaf()) {
+                func(node, n.id);
+            } else {
+                stack.push_back(n.child[0]);
+                stack.push_back(n.child[1]);
+            }
+        }
+    }
+
+    float BoundsTree::cost() const {
+        if (_root < 0 || _nodes[_root].isLeaf()) return 0;
+        float root_area = area(_nodes[_root].min, _nodes[_root].max);
+        return root_area > 0 ? (float)(_internal_area / root_area) : 0;
+    }
+
+    void BoundsTree::build(std::vector<Leaf> leaves) {
+        _nodes.clear();
+        _free.clear();
+        _root = -1;
+        _leaf_count = leaves.size();
+        _internal_area = 0;
+        if (leaves.empty()) return;
+        _nodes.reserve(leaves.size() * 2);
+        _root = buildRange(leaves, 0, leaves.size(), -1);
+    }
+
+    int BoundsTree::buildRange(std::vector<Leaf>& leaves, size_t begin, size_t end, int parent) {
+        int node = allocate();
+        _nodes[node].parent = parent;
+        if (end - begin == 1) {
+            _nodes[node].id = leaves[begin].id;
+            setBox(node, leaves[begin].min, leaves[begin].max);
+            return node;
+        }
+
+        common::Vector3<float> min = leaves[begin].min, max = leaves[begin].max;
+        common::Vector3<float> cmin = leaves[begin].min + leaves[begin].max, cmax = cmin;
+        for (size_t i = begin + 1; i < end; i++) {
+            min = min.cwiseMin(leaves[i].min);
+            max = max.cwiseMax(leaves[i].max);
+            common::Vector3<float> c = leaves[i].min + leaves[i].max;
+            cmin = cmin.cwiseMin(c);
+            cmax = cmax.cwiseMax(c);
+        }
+
+        // bin the centroids along the widest axis and take the cheapest split
+        const int BinCount = 16;
+        int axis;
+        float extent = (cmax - cmin).maxCoeff(&axis);
+        size_t mid = begin + (end - begin) / 2;
+        if (extent > 0) {
+            struct Bin { common::Vector3<float> min, max; size_t count = 0; } bins[BinCount];
+            auto binOf = [&](const Leaf& leaf) {
+                int b = (int)((leaf.min[axis] + leaf.max[axis] - cmin[axis]) / extent * BinCount);
+                return std::min(b, BinCount - 1);
+            };
+            for (size_t i = begin; i < end; i++) {
+                auto& bin = bins[binOf(leaves[i])];
+                bin.min = bin.count ? bin.min.cwiseMin(leaves[i].min) : leaves[i].min;
+                bin.max = bin.count ? bin.max.cwiseMax(leaves[i].max) : leaves[i].max;
+                bin.count++;
+            }
+            float right_area[BinCount];
+            size_t right_count[BinCount];
+            common::Vector3<float> rmin, rmax;
+            size_t count = 0;
+            for (int i = BinCount - 1; i > 0; i--) {
+                if (bins[i].count) {
+                    rmin = count ? rmin.cwiseMin(bins[i].min) : bins[i].min;
+                    rmax = count ? rmax.cwiseMax(bins[i].max) : bins[i].max;
+                    count += bins[i].count;
+                }
+                right_area[i] = count ? area(rmin, rmax) : 0;
+                right_count[i] = count;
+            }
+            common::Vector3<float> lmin, lmax;
+            float best = std::numeric_limits<float>::max();
+            int split = -1;
+            count = 0;
+            for (int i = 0; i < BinCount - 1; i++) {
+                if (bins[i].count) {
+                    lmin = count ? lmin.cwiseMin(bins[i].min) : bins[i].min;
+                    lmax = count ? lmax.cwiseMax(bins[i].max) : bins[i].max;
+                    count += bins[i].count;
+                }
+                if (count == 0 || right_count[i + 1] == 0) continue;
+                float cost = area(lmin, lmax) * count + right_area[i + 1] * right_count[i + 1];
+                if (cost < best) {
+                    best = cost;
+                    split = i;
+                }
+            }
+            if (split >= 0) {
+                auto it = std::partition(leaves.begin() + begin, leaves.begin() + end,
+                                         [&](const Leaf& leaf) { return binOf(leaf) <= split; });
+                mid = it - leaves.begin();
+            }
+        }
+
+        int left = buildRange(leaves, begin, mid, node);
+        int right = buildRange(leaves, mid, end, node);
+        _nodes[node].child[0] = left;
+        _nodes[node].child[1] = right;
+        setBox(node, min, max);
+        return node;
+    }
+
+    void BoundsTree::collect(int node, std::vector<int>& ids) const {
+        std::vector<int> stack = { node };
+        while (!stack.empty()) {
+            auto& n = _nodes[stack.back()];
+            stack.pop_back();
+            if (n.isLeaf()) {
+                ids.push_back(n.id);
+            } else {
+                stack.push_back(n.child[0]);
+                stack.push_back(n.child[1]);
+            }
+        }
+    }
+
+    void BoundsTree::queryFrustum(const Frustum& frustum, std::vector<int>& ids) const {
+        if (_root >= 0) queryFrustum(_root, frustum, ids);
+    }
+
+    std::vector<int> BoundsTree::subtrees(size_t count) const {
+        std::vector<int> nodes;
+        if (_root < 0) return nodes;
+        // expand breadth-first, so the subtrees are of similar depth
+        std::deque<int> queue = { _root };
+        while (!queue.empty() && queue.size() + nodes.size() < count) {
+            int node = queue.front();
+            queue.pop_front();
+            if (_nodes[node].isLeaf()) {
+                nodes.push_back(node);
+            } else {
+                queue.push_back(_nodes[node].child[0]);
+                queue.push_back(_nodes[node].child[1]);
+            }
+        }
+        nodes.insert(nodes.end(), queue.begin(), queue.end());
+        return nodes;
+    }
+
+    void BoundsTree::queryFrustum(int subtree, const Frustum& frustum, std::vector<int>& ids) const {
+        std::vector<int> stack = { subtree };
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+            auto& n = _nodes[node];
+            auto result = frustum.test(n.min, n.max);
+            if (result == Frustum::OUTSIDE) continue;
+            if (result == Frustum::INSIDE || n.isLeaf()) {
+                collect(node, ids);
+            } else {
+                stack.push_back(n.child[0]);
+                stack.push_back(n.child[1]);
+            }
+        }
+    }
+
+    // entry distance of a ray into a box, negative if missed
+    static float rayBox(const common::Vector3<float>& origin, const common::Vector3<float>& inv_dir,
+                        const common::Vector3<float>& min, const common::Vector3<float>& max, float max_distance) {
+        common::Vector3<float> t0 = (min - origin).cwiseProduct(inv_dir);
+        common::Vector3<float> t1 = (max - origin).cwiseProduct(inv_dir);
+        float near = std::max(t0.cwiseMin(t1).maxCoeff(), 0.f);
+        float far = std::min(t0.cwiseMax(t1).minCoeff(), max_distance);
+        return near <= far ? near : -1;
+    }
+
+    void BoundsTree::queryRay(const common::Vector3<float>& origin, const common::Vector3<float>& direction,
+                             float max_distance, std::vector<std::pair<float, int>>& hits) const {
+        if (_root < 0) return;
+        common::Vector3<float> inv_dir = direction.cwiseInverse();
+        size_t first = hits.size();
+        std::vector<int> stack = { _root };
+        while (!stack.empty()) {
+            auto& n = _nodes[stack.back()];
+            stack.pop_back();
+            float t = rayBox(origin, inv_dir, n.min, n.max, max_distance);
+            if (t < 0) continue;
+            if (n.isLeaf()) {
+                hits.emplace_back(t, n.id);
+            } else {
+                stack.push_back(n.child[0]);
+                stack.push_back(n.child[1]);
+            }
+        }
+        std::sort(hits.begin() + first, hits.end());
+    }
+
+    void BoundsTree::queryBox(const common::Vector3<float>& min, const common::Vector3<float>& max,
+                             std::vector<int>& ids) const {
+        if (_root < 0) return;
+        std::vector<int> stack = { _root };
+        while (!stack.empty()) {
+            auto& n = _nodes[stack.back()];
+            stack.pop_back();
+            if ((n.min.array() > max.array()).any() || (n.max.array() < min.array()).any()) continue;
+            if (n.isLeaf()) {
+                ids.push_back(n.id);
+            } else {
+                stack.push_back(n.child[0]);
+                stack.push_back(n.child[1]);
+            }
+        }
+    }
+
+    int BoundsTree::queryNearest(const common::Vector3<float>& point, float max_distance, float* distance) const {
+        int best = -1;
+        float best_d2 = max_distance * max_distance;
+        auto dist2 = [&](const Node& n) {
+            return (n.min - point).cwiseMax(point - n.max).cwiseMax(0).squaredNorm();
+        };
+        if (_root < 0 || dist2(_nodes[_root]) > best_d2) return -1;
+
+        std::vector<std::pair<float, int>> stack = { { dist2(_nodes[_root]), _root } };
+        while (!stack.empty()) {
+            auto top = stack.back();
+            stack.pop_back();
+            if (top.first > best_d2) continue;
+            auto& n = _nodes[top.second];
+            if (n.isLeaf()) {
+                best_d2 = top.first;
+                best = n.id;
+                continue;
+            }
+            // visit the nearer child first
+            float d0 = dist2(_nodes[n.child[0]]), d1 = dist2(_nodes[n.child[1]]);
+            if (d0 < d1) {
+                stack.emplace_back(d1, n.child[1]);
+                stack.emplace_back(d0, n.child[0]);
+            } else {
+                stack.emplace_back(d0, n.child[0]);
+                stack.emplace_back(d1, n.child[1]);
+            }
+        }
+        if (best >= 0 && distance != nullptr) *distance = std::sqrt(best_d2);
+        return best;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
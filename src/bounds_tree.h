@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "bounds.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief Dynamic AABB tree over object bounds
+     *
+     * Every leaf holds one object id and its box. Inserting descends towards the
+     * child whose surface area grows least, and moving a leaf only refits its
+     * ancestors, so the tree is cheap to keep up to date but slowly loses
+     * quality. cost() tracks that (surface area heuristic of the internal nodes
+     * relative to the root), and build() makes a fresh tree with a binned SAH
+     * split, which can be done on another thread from a snapshot of leaves().
+     *
+     * Not thread-safe: the owner has to guard concurrent queries and writes.
+     */
+    class BoundsTree {
+    public:
+        struct Leaf {
+            int id;
+            common::Vector3<float> min, max;
+        };
+
+        BoundsTree();
+
+        int insert(int id, const Bounds& bounds);
+        void remove(int leaf);
+        void update(int leaf, const Bounds& bounds);
+        // set the box of a leaf without refitting, refitAll() has to follow
+        void assign(int leaf, const Bounds& bounds);
+        void refitAll();
+
+        void build(std::vector<Leaf> leaves);
+        std::vector<Leaf> leaves() const;
+        int id(int leaf) const { return _nodes[leaf].id; }
+        // leaf nodes as (node, id) pairs
+        void forEachLeaf(const std::function<void(int, int)>& func) const;
+
+        size_t leafCount() const { return _leaf_count; }
+        float cost() const;
+
+        //// queries, ids are appended to the output
+        void queryFrustum(const Frustum& frustum, std::vector<int>& ids) const;
+        // split the tree into about count subtrees, whose frustum queries may run in parallel
+        std::vector<int> subtrees(size_t count) const;
+        void queryFrustum(int subtree, const Frustum& frustum, std::vector<int>& ids) const;
+        // (entry distance, id) of the boxes hit, sorted by distance
+        void queryRay(const common::Vector3<float>& origin, const common::Vector3<float>& direction,
+                     float max_distance, std::vector<std::pair<float, int>>& hits) const;
+        void queryBox(const common::Vector3<float>& min, const common::Vector3<float>& max,
+                     std::vector<int>& ids) const;
+        // id of the box nearest to a point, -1 if none within max_distance
+        int queryNearest(const common::Vector3<float>& point, float max_distance, float* distance) const;
+
+    private:
+        struct Node {
+            common::Vector3<float> min, max;
+            int parent;
+            int child[2];
+            int id;             // object id of a leaf, -1 for internal nodes
+
+            bool isLeaf() const { return child[0] < 0; }
+        };
+
+        int allocate();
+        void release(int node);
+        void setBox(int node, const common::Vector3<float>& min, const common::Vector3<float>& max);
+        void refit(int node);
+        int buildRange(std::vector<Leaf>& leaves, size_t begin, size_t end, int parent);
+        void collect(int node, std::vector<int>& ids) const;
+
+        std::vector<Node> _nodes;
+        std::vector<int> _free;
+        int _root;
+        size_t _leaf_count;
+        // surface area of all the internal nodes, for cost()
+        double _internal_area;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -138,6 +138,27 @@ namespace simple_viewer {
         return _proj[i];
     }
 
+    common::Matrix4<float> Camera::getViewProj(const common::Transform<float>& transform,
+                                               const common::Vector3<float>& screen_offset) const {
+        // world to camera space
+        common::Matrix4<float> view = common::Matrix4<float>::Identity();
+        auto inv_basis = transform.getBasis().transpose();
+        view.topLeftCorner<3, 3>() = inv_basis;
+        view.topRightCorner<3, 1>() = -(inv_basis * transform.getOrigin());
+
+        // camera to clip space, with the screen offset applied in clip space
+        common::Matrix4<float> proj = common::Matrix4<float>::Zero();
+        proj(0, 0) = _proj[0];
+        proj(1, 1) = _proj[1];
+        proj(2, 2) = _proj[2];
+        proj(2, 3) = _proj[3];
+        proj(3, 2) = -1.f;
+        proj(0, 2) -= screen_offset.x();
+        proj(1, 2) -= screen_offset.y();
+        proj(2, 2) -= screen_offset.z();
+        return proj * view;
+    }
+
     void Camera::reset() {
         _state_left = _state_middle = _state_right = 1;
         _state_w = _state_a = _state_s = _state_d = 1;
@@ -24,6 +24,8 @@ namespace simple_viewer {
 
         const common::Transform<float>& getTransform(long long time);
         float getProj(int i) const;
+        common::Matrix4<float> getViewProj(const common::Transform<float>& transform,
+                                           const common::Vector3<float>& screen_offset) const;
 
         void reset();
 
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace simple_viewer {
+
+    /**
+     * @brief A bounded, lock-free, multi-producer single-consumer queue
+     *
+     * Each cell carries a sequence number telling whether it is free for the
+     * producer of the current lap or filled for the consumer, so producers only
+     * contend on one atomic counter and never wait for the consumer.
+     * push() fails (and counts an overflow) instead of blocking when full.
+     * pop() must only be called by one thread at a time.
+     */
+    template <typename T>
+    class CommandQueue {
+    public:
+        explicit CommandQueue(size_t capacity);
+        CommandQueue(const CommandQueue& other) = delete;
+
+        bool push(T&& value);
+        bool pop(T& value);
+
+        size_t depth() const;
+        size_t capacity() const { return _mask + 1; }
+        unsigned long long overflowCount() const { return _overflow.load(std::memory_order_relaxed); }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> _cells;
+        size_t _mask;
+        // keep producer and consumer counters on separate cache lines
+        char _pad0[64];
+        std::atomic<size_t> _enqueue_pos;
+        char _pad1[64];
+        std::atomic<size_t> _dequeue_pos;
+        char _pad2[64];
+        std::atomic<unsigned long long> _overflow;
+    };
+
+    template <typename T>
+    CommandQueue<T>::CommandQueue(size_t capacity): // NOLINT
+            _enqueue_pos(0), _dequeue_pos(0), _overflow(0) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        _mask = size - 1;
+        _cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename T>
+    bool CommandQueue<T>::push(T&& value) {
+        size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (diff == 0) {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                _overflow.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename T>
+    bool CommandQueue<T>::pop(T& value) {
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell = &_cells[pos & _mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if ((ptrdiff_t)seq - (ptrdiff_t)(pos + 1) < 0) return false;
+        _dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        value = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename T>
+    size_t CommandQueue<T>::depth() const {
+        size_t head = _dequeue_pos.load(std::memory_order_relaxed);
+        size_t tail = _enqueue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
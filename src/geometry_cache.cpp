@@ -0,0 +1,207 @@
+#include "geometry_cache.h"
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+namespace simple_viewer {
+
+    static const size_t MinMatch = 4;
+    static const size_t MaxOffset = 65535;
+    static const int HashBits = 16;
+
+    static uint32_t read32(const unsigned char* p) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint32_t hash4(const unsigned char* p) {
+        return (read32(p) * 2654435761u) >> (32 - HashBits);
+    }
+
+    // lengths of 15 and more continue in the following bytes, 255 meaning yet another one
+    static void writeLength(std::vector<unsigned char>& out, size_t length) {
+        for (; length >= 255; length -= 255) out.push_back(255);
+        out.push_back((unsigned char)length);
+    }
+
+    static bool readLength(const unsigned char*& p, const unsigned char* end, size_t& length) {
+        unsigned char byte;
+        do {
+            if (p >= end) return false;
+            byte = *p++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // a sequence is a token (literal length, match length - MinMatch), the literals, and a 16 bit match offset
+    static void writeSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t literal_count,
+                              size_t offset, size_t match) {
+        bool last = match == 0;
+        size_t match_code = last ? 0 : match - MinMatch;
+        out.push_back((unsigned char)((std::min<size_t>(literal_count, 15) << 4) | std::min<size_t>(match_code, 15)));
+        if (literal_count >= 15) writeLength(out, literal_count - 15);
+        out.insert(out.end(), literals, literals + literal_count);
+        if (last) return;
+        out.push_back((unsigned char)(offset & 0xff));
+        out.push_back((unsigned char)(offset >> 8));
+        if (match_code >= 15) writeLength(out, match_code - 15);
+    }
+
+    static std::vector<unsigned char> lzCompress(const std::vector<unsigned char>& in) {
+        std::vector<unsigned char> out;
+        out.reserve(in.size() / 2 + 16);
+        std::vector<uint32_t> table((size_t)1 << HashBits, 0);
+        size_t anchor = 0, i = 0, n = in.size();
+        while (n >= MinMatch && i + MinMatch <= n) {
+            uint32_t h = hash4(&in[i]);
+            size_t candidate = table[h];
+            table[h] = (uint32_t)i;
+            if (candidate >= i || i - candidate > MaxOffset || read32(&in[candidate]) != read32(&in[i])) {
+                i++;
+                continue;
+            }
+            size_t match = MinMatch;
+            while (i + match < n && in[candidate + match] == in[i + match]) match++;
+            writeSequence(out, &in[anchor], i - anchor, i - candidate, match);
+            i += match;
+            anchor = i;
+        }
+        writeSequence(out, in.data() + anchor, n - anchor, 0, 0);
+        return out;
+    }
+
+    // into out, sized to the expected bytes
+    static bool lzDecompress(const unsigned char* p, size_t size, std::vector<unsigned char>& out) {
+        const unsigned char* end = p + size;
+        size_t o = 0;
+        while (p < end) {
+            unsigned char token = *p++;
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(p, end, literals)) return false;
+            if ((size_t)(end - p) < literals || out.size() - o < literals) return false;
+            std::memcpy(out.data() + o, p, literals);
+            o += literals;
+            p += literals;
+            if (p == end) return o == out.size();
+            if (end - p < 2) return false;
+            size_t offset = p[0] | ((size_t)p[1] << 8);
+            p += 2;
+            size_t match = token & 15;
+            if (match == 15 && !readLength(p, end, match)) return false;
+            match += MinMatch;
+            if (offset == 0 || offset > o || out.size() - o < match) return false;
+            // byte by byte, as the match may overlap what it copies
+            unsigned char* dst = out.data() + o;
+            const unsigned char* src = dst - offset;
+            for (size_t k = 0; k < match; k++) dst[k] = src[k];
+            o += match;
+        }
+        return o == out.size();
+    }
+
+    // elements become differences with the same element of the previous vertex, grouped by byte significance
+    static std::vector<unsigned char> filter(const std::vector<unsigned char>& data, size_t stride, size_t element) {
+        size_t count = data.size() / element, distance = stride / element;
+        std::vector<unsigned char> out(data.size());
+        for (size_t i = 0; i < count; i++) {
+            uint32_t value = 0, previous = 0;
+            std::memcpy(&value, &data[i * element], element);
+            if (i >= distance) std::memcpy(&previous, &data[(i - distance) * element], element);
+            uint32_t delta = value - previous;
+            for (size_t b = 0; b < element; b++) out[b * count + i] = (unsigned char)(delta >> (8 * b));
+        }
+        // trailing bytes not making a whole element are kept as they are
+        std::copy(data.begin() + count * element, data.end(), out.begin() + count * element);
+        return out;
+    }
+
+    static void unfilter(std::vector<unsigned char>& data, size_t stride, size_t element) {
+        size_t count = data.size() / element, distance = stride / element;
+        std::vector<unsigned char> out(data.size());
+        for (size_t i = 0; i < count; i++) {
+            uint32_t delta = 0, previous = 0;
+            for (size_t b = 0; b < element; b++) delta |= (uint32_t)data[b * count + i] << (8 * b);
+            if (i >= distance) std::memcpy(&previous, &out[(i - distance) * element], element);
+            uint32_t value = previous + delta;
+            std::memcpy(&out[i * element], &value, element);
+        }
+        std::copy(data.begin() + count * element, data.end(), out.begin() + count * element);
+        data.swap(out);
+    }
+
+    std::vector<unsigned char> GeometryCache::compress(const std::vector<unsigned char>& data, size_t stride,
+                                                       size_t element) {
+        return lzCompress(filter(data, stride, element));
+    }
+
+    bool GeometryCache::decompress(const unsigned char* data, size_t size, size_t stride, size_t element,
+                                   std::vector<unsigned char>& out) {
+        if (!lzDecompress(data, size, out)) return false;
+        unfilter(out, stride, element);
+        return true;
+    }
+
+    GeometryCache::GeometryCache(int policy, std::vector<unsigned char> vertices, size_t vertex_stride,
+                                 size_t vertex_element, std::vector<unsigned char> indices, size_t index_size):
+            _policy(policy), _file(nullptr), _stored_bytes(0) {
+        _vertices = { 0, vertices.size(), vertices.size(), vertex_stride, vertex_element };
+        _indices = { 0, indices.size(), indices.size(), index_size, index_size };
+        if (_policy == C_COMPRESSED || _policy == C_DISK) {
+            // a file is compressed too, so less is written and read back
+            vertices = compress(vertices, vertex_stride, vertex_element);
+            indices = compress(indices, index_size, index_size);
+            _vertices.size = vertices.size();
+            _indices.size = indices.size();
+        }
+        _indices.offset = _vertices.size;
+        _data.reserve(vertices.size() + indices.size());
+        _data.insert(_data.end(), vertices.begin(), vertices.end());
+        _data.insert(_data.end(), indices.begin(), indices.end());
+        _stored_bytes = _data.size();
+        if (_policy != C_DISK) return;
+        _file = std::tmpfile();
+        if (_file != nullptr && std::fwrite(_data.data(), 1, _data.size(), _file) == _data.size() &&
+            std::fflush(_file) == 0) {
+            std::vector<unsigned char>().swap(_data);
+        } else if (_file != nullptr) {
+            // no room on the disk, the memory keeps them
+            std::fclose(_file);
+            _file = nullptr;
+        }
+    }
+
+    GeometryCache::~GeometryCache() {
+        if (_file != nullptr) std::fclose(_file);
+    }
+
+    bool GeometryCache::loadStream(const Stream& stream, std::vector<unsigned char>& out) const {
+        std::vector<unsigned char> stored;
+        const unsigned char* data = _data.data() + stream.offset;
+        if (_file != nullptr) {
+            stored.resize(stream.size);
+            if (std::fseek(_file, (long)stream.offset, SEEK_SET) != 0 ||
+                std::fread(stored.data(), 1, stream.size, _file) != stream.size) {
+                return false;
+            }
+            data = stored.data();
+        }
+        if (_policy != C_COMPRESSED && _policy != C_DISK) {
+            out.assign(data, data + stream.size);
+            return true;
+        }
+        out.resize(stream.raw_size);
+        return decompress(data, stream.size, stream.stride, stream.element, out);
+    }
+
+    bool GeometryCache::load(std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices) const {
+        return loadStream(_vertices, vertices) && loadStream(_indices, indices);
+    }
+
+    size_t GeometryCache::residentBytes() const {
+        return _data.capacity();
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
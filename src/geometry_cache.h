@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+
+namespace simple_viewer {
+
+    // must be consistent with the MemoryPolicy in opengl_viewer.h
+    enum CachePolicy {
+        C_KEEP = 1,             // keep the cpu copy of the geometry
+        C_MEMORY = 2,           // drop it once uploaded, and read it back into memory when the gpu copy goes
+        C_COMPRESSED = 3,       // the same, compressed
+        C_DISK = 4              // the same, into a temporary file
+    };
+
+    /**
+     * @brief The uploaded bytes of some geometry, kept while its gpu buffers are gone
+     *
+     * Compression first filters every stream: its elements (e.g. the 16 bit
+     * components of compact vertices) become the difference with the same one
+     * of the previous vertex, and their bytes are grouped by significance, so
+     * the slowly varying geometry turns into runs that a byte oriented LZ77
+     * compresses well. A temporary file is removed once the cache goes.
+     */
+    class GeometryCache {
+    public:
+        // vertices and indices as uploaded: bytes of a vertex, and of the elements it is made of
+        GeometryCache(int policy, std::vector<unsigned char> vertices, size_t vertex_stride, size_t vertex_element,
+                      std::vector<unsigned char> indices, size_t index_size);
+        GeometryCache(const GeometryCache& other) = delete;
+        ~GeometryCache();
+
+        // false if they were lost, e.g. the temporary file could not be read back
+        bool load(std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices) const;
+        // memory held, which is nothing for a file
+        size_t residentBytes() const;
+        size_t storedBytes() const { return _stored_bytes; }
+
+        static std::vector<unsigned char> compress(const std::vector<unsigned char>& data, size_t stride,
+                                                   size_t element);
+        // into out, sized to the bytes expected
+        static bool decompress(const unsigned char* data, size_t size, size_t stride, size_t element,
+                               std::vector<unsigned char>& out);
+
+    private:
+        struct Stream {
+            size_t offset, size;    // in the stored bytes
+            size_t raw_size;        // once loaded
+            size_t stride, element;
+        };
+
+        bool loadStream(const Stream& stream, std::vector<unsigned char>& out) const;
+
+        int _policy;
+        Stream _vertices, _indices;
+        std::vector<unsigned char> _data;
+        std::FILE* _file;
+        size_t _stored_bytes;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "mesh_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "renderer.h"
+#include "mesh_loader.h"
+
+namespace simple_viewer {
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertex_format, optimize;
+        uint64_t source_size, source_time, source_hash;
+        uint64_t vertex_count, triangle_count, index_count, chunk_count, lod_count;
+        float local_bounds[10];
+        float position_offset[3], position_scale[3];
+        float acmr_before, acmr_after;
+        uint64_t payload_size, payload_hash;    // of everything after the header
+    };
+
+    static const char Magic[4] = { 'S', 'V', 'M', 'C' };
+    static std::atomic<unsigned int> temporary_count(0);
+
+    //// hash
+
+    static const uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+    static const uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+    static const uint64_t Prime3 = 0x165667B19E3779F9ull;
+    static const uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+    static const uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+    static uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static uint64_t read64(const unsigned char* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint64_t mixLane(uint64_t acc, uint64_t lane) {
+        return rotl(acc + lane * Prime2, 31) * Prime1;
+    }
+
+    static uint64_t mergeLane(uint64_t h, uint64_t acc) {
+        return (h ^ mixLane(0, acc)) * Prime1 + Prime4;
+    }
+
+    // XXH64 with a seed of 0
+    uint64_t MeshCache::hash(const void* data, size_t size) {
+        auto p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+        uint64_t h = Prime5;
+        if (size >= 32) {
+            uint64_t acc[4] = { Prime1 + Prime2, Prime2, 0, 0 - Prime1 };
+            for (; end - p >= 32; p += 32) {
+                for (int i = 0; i < 4; i++) acc[i] = mixLane(acc[i], read64(p + i * 8));
+            }
+            h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+            for (auto lane : acc) h = mergeLane(h, lane);
+        }
+        h += size;
+        for (; end - p >= 8; p += 8) h = rotl(h ^ mixLane(0, read64(p)), 27) * Prime1 + Prime4;
+        if (end - p >= 4) {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            h = rotl(h ^ (v * Prime1), 23) * Prime2 + Prime3;
+            p += 4;
+        }
+        for (; p < end; p++) h = rotl(h ^ (*p * Prime5), 11) * Prime1;
+        h ^= h >> 33;
+        h *= Prime2;
+        h ^= h >> 29;
+        h *= Prime3;
+        return h ^ (h >> 32);
+    }
+
+    void MeshCache::storeBounds(const Bounds& bounds, float* out) {
+        std::copy(bounds.min.data(), bounds.min.data() + 3, out);
+        std::copy(bounds.max.data(), bounds.max.data() + 3, out + 3);
+        std::copy(bounds.center.data(), bounds.center.data() + 3, out + 6);
+        out[9] = bounds.radius;
+    }
+
+    Bounds MeshCache::loadBounds(const float* in) {
+        Bounds bounds;
+        bounds.min = Eigen::Map<const common::Vector3<float>>(in);
+        bounds.max = Eigen::Map<const common::Vector3<float>>(in + 3);
+        bounds.center = Eigen::Map<const common::Vector3<float>>(in + 6);
+        bounds.radius = in[9];
+        return bounds;
+    }
+
+    //// layout
+
+    static uint64_t align(uint64_t offset) {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    static size_t strideOf(int vertex_format) {
+        switch (vertex_format) {
+            case V_COMPACT: return 12;
+            case V_COMPACT_SMALL: return 8;
+            default: return sizeof(float) * 6;
+        }
+    }
+
+    // where every section starts after the header, and where the last one ends
+    struct Layout {
+        uint64_t chunks, lods, chunk_triangles, vertices, indices, end;
+
+        Layout(uint64_t chunk_count, uint64_t lod_count, uint64_t triangle_count, uint64_t vertex_count,
+               size_t vertex_stride, uint64_t index_count) {
+            chunks = align(sizeof(FileHeader));
+            lods = align(chunks + chunk_count * sizeof(MeshCache::ChunkRecord));
+            chunk_triangles = align(lods + lod_count * sizeof(MeshCache::LodRecord));
+            vertices = align(chunk_triangles + triangle_count * sizeof(uint32_t));
+            indices = align(vertices + vertex_count * vertex_stride);
+            end = indices + index_count * sizeof(uint16_t);
+        }
+    };
+
+    // the triangles and levels of every chunk within the arrays, and their corners within the chunk
+    static bool validate(const MeshCache::Geometry& g) {
+        for (uint64_t t = 0; t < g.triangle_count; t++) {
+            if (g.chunk_triangles[t] >= g.triangle_count) return false;
+        }
+        uint64_t triangles = 0;
+        for (uint64_t c = 0; c < g.chunk_count; c++) {
+            auto& chunk = g.chunks[c];
+            if (chunk.vertex_count > g.vertex_count || chunk.base_vertex > g.vertex_count - chunk.vertex_count ||
+                chunk.first_triangle != triangles || chunk.triangle_count > g.triangle_count - triangles ||
+                chunk.lod_count > g.lod_count || chunk.first_lod > g.lod_count - chunk.lod_count) {
+                return false;
+            }
+            triangles += chunk.triangle_count;
+            auto check = [&](uint64_t first, uint64_t count) {
+                if (first > g.index_count || count > (g.index_count - first) / 3) return false;
+                for (uint64_t i = first; i < first + count * 3; i++) {
+                    if (g.indices[i] >= chunk.vertex_count) return false;
+                }
+                return true;
+            };
+            if (!check(chunk.first_triangle * 3, chunk.triangle_count)) return false;
+            for (uint32_t l = 0; l < chunk.lod_count; l++) {
+                auto& lod = g.lods[chunk.first_lod + l];
+                if (!check(lod.first, lod.triangle_count)) return false;
+            }
+        }
+        return triangles == g.triangle_count;
+    }
+
+    //// files
+
+    static bool stampOf(const std::string& path, MeshCache::Source& source) {
+#ifdef _WIN32
+        struct _stat64 info;
+        if (_stat64(path.c_str(), &info) != 0) return false;
+        source.time = (uint64_t)info.st_mtime;
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return false;
+#ifdef __linux__
+        source.time = (uint64_t)info.st_mtim.tv_sec * 1000000000ull + (uint64_t)info.st_mtim.tv_nsec;
+#else
+        source.time = (uint64_t)info.st_mtime;
+#endif
+#endif
+        source.size = (uint64_t)info.st_size;
+        return true;
+    }
+
+    // into a temporary file renamed over the cache once complete, so readers see the old cache or the whole new
+    // one. The temporary is named by process and by write, as several may write the same cache
+    static bool replaceFile(const std::string& path, const unsigned char* data, size_t size) {
+#ifdef _WIN32
+        auto process = (unsigned long)_getpid();
+#else
+        auto process = (unsigned long)getpid();
+#endif
+        std::string temporary = path + "." + std::to_string(process) + "." + std::to_string(temporary_count++) +
+                                ".tmp";
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr) return false;
+        bool written = std::fwrite(data, 1, size, file) == size;
+        written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+        if (written) std::remove(path.c_str());
+#endif
+        if (written && std::rename(temporary.c_str(), path.c_str()) == 0) return true;
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    std::string MeshCache::pathOf(const std::string& source_path) {
+        return source_path + ".svmc";
+    }
+
+    bool MeshCache::read(const std::string& source_path, int vertex_format, bool optimize, Geometry& geometry,
+                         Source& source) {
+        source = Source();
+        if (!stampOf(source_path, source)) return false;
+        bool hashed = false;
+        auto hashSource = [&]() {
+            if (hashed) return source.hash;
+            hashed = true;
+            MappedFile file(source_path.c_str());
+            source.hash = file.valid() ? hash(file.data(), file.size()) : 0;
+            return source.hash;
+        };
+
+        std::string path = pathOf(source_path);
+        auto file = std::make_shared<MappedFile>(path.c_str());
+        FileHeader header = {};
+        if (file->valid() && file->size() >= sizeof(header)) std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+            (int)header.vertex_format != vertex_format || (header.optimize != 0) != optimize) {
+            hashSource();
+            return false;
+        }
+        // touched or copied, but the same
+        bool restamp = header.source_size != source.size || header.source_time != source.time;
+        if (restamp && hashSource() != header.source_hash) return false;
+        source.hash = header.source_hash;
+
+        // counts larger than the file would overflow the layout
+        uint64_t size = file->size();
+        size_t stride = strideOf(vertex_format);
+        if (header.chunk_count > size || header.lod_count > size || header.triangle_count > size ||
+            header.vertex_count > size || header.index_count > size) {
+            return false;
+        }
+        Layout layout(header.chunk_count, header.lod_count, header.triangle_count, header.vertex_count, stride,
+                      header.index_count);
+        if (layout.end != size || header.payload_size != size - sizeof(header) ||
+            hash(file->data() + sizeof(header), header.payload_size) != header.payload_hash) {
+            return false;
+        }
+
+        Geometry g;
+        auto data = reinterpret_cast<const unsigned char*>(file->data());
+        g.vertex_format = vertex_format;
+        g.optimize = optimize;
+        g.vertex_count = header.vertex_count;
+        g.triangle_count = header.triangle_count;
+        g.index_count = header.index_count;
+        g.chunk_count = header.chunk_count;
+        g.lod_count = header.lod_count;
+        g.local_bounds = loadBounds(header.local_bounds);
+        g.position_offset = Eigen::Map<const common::Vector3<float>>(header.position_offset);
+        g.position_scale = Eigen::Map<const common::Vector3<float>>(header.position_scale);
+        g.acmr_before = header.acmr_before;
+        g.acmr_after = header.acmr_after;
+        g.chunks = reinterpret_cast<const ChunkRecord*>(data + layout.chunks);
+        g.lods = reinterpret_cast<const LodRecord*>(data + layout.lods);
+        g.chunk_triangles = reinterpret_cast<const uint32_t*>(data + layout.chunk_triangles);
+        g.vertices = data + layout.vertices;
+        g.indices = reinterpret_cast<const uint16_t*>(data + layout.indices);
+        if (!validate(g)) return false;
+        g.owner = file;
+        if (restamp) {
+            // a new file with the new stamp, the mapped one staying as it is
+            std::vector<unsigned char> stamped(data, data + size);
+            header.source_size = source.size;
+            header.source_time = source.time;
+            std::memcpy(stamped.data(), &header, sizeof(header));
+            replaceFile(path, stamped.data(), stamped.size());
+        }
+        geometry = g;
+        return true;
+    }
+
+    bool MeshCache::write(const std::string& source_path, const Source& source, const Geometry& geometry) {
+        auto& g = geometry;
+        size_t stride = strideOf(g.vertex_format);
+        Layout layout(g.chunk_count, g.lod_count, g.triangle_count, g.vertex_count, stride, g.index_count);
+        std::vector<unsigned char> data(layout.end, 0);
+        auto put = [&](uint64_t offset, const void* section, uint64_t bytes) {
+            if (bytes > 0) std::memcpy(&data[offset], section, bytes);
+        };
+        put(layout.chunks, g.chunks, g.chunk_count * sizeof(ChunkRecord));
+        put(layout.lods, g.lods, g.lod_count * sizeof(LodRecord));
+        put(layout.chunk_triangles, g.chunk_triangles, g.triangle_count * sizeof(uint32_t));
+        put(layout.vertices, g.vertices, g.vertex_count * stride);
+        put(layout.indices, g.indices, g.index_count * sizeof(uint16_t));
+
+        FileHeader header = {};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.vertex_format = (uint32_t)g.vertex_format;
+        header.optimize = g.optimize ? 1 : 0;
+        header.source_size = source.size;
+        header.source_time = source.time;
+        header.source_hash = source.hash;
+        header.vertex_count = g.vertex_count;
+        header.triangle_count = g.triangle_count;
+        header.index_count = g.index_count;
+        header.chunk_count = g.chunk_count;
+        header.lod_count = g.lod_count;
+        storeBounds(g.local_bounds, header.local_bounds);
+        std::memcpy(header.position_offset, g.position_offset.data(), sizeof(header.position_offset));
+        std::memcpy(header.position_scale, g.position_scale.data(), sizeof(header.position_scale));
+        header.acmr_before = g.acmr_before;
+        header.acmr_after = g.acmr_after;
+        header.payload_size = layout.end - sizeof(header);
+        header.payload_hash = hash(data.data() + sizeof(header), header.payload_size);
+        std::memcpy(data.data(), &header, sizeof(header));
+
+        return replaceFile(pathOf(source_path), data.data(), data.size());
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
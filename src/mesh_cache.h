@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "bounds.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief A file of the geometry of a static mesh as MeshRenderer uploads it, next to its source
+     *
+     * It holds the chunk table with the levels of detail of every chunk, the
+     * order of the triangles as given, the vertices in their format and the 16
+     * bit indices with the levels appended, each section 16 byte aligned in the
+     * native byte order, so the file is mapped and drawn from in place.
+     *
+     * A cache is valid for one source file, vertex format and optimization. It
+     * records the size, time and hash of the source, which is hashed again
+     * only when its size or time changed, and a hash of everything after its
+     * header, against torn writes. It is written, and written again with the
+     * new stamp of a source touched but the same, into a temporary file renamed
+     * over the cache once complete.
+     */
+    class MeshCache {
+    public:
+        static const uint32_t Version = 1;
+
+        struct LodRecord {
+            uint64_t first;                 // first index in the indices
+            uint64_t triangle_count;
+            float error;
+            uint32_t reserved;
+        };
+        struct ChunkRecord {
+            uint64_t base_vertex, vertex_count;
+            uint64_t first_triangle, triangle_count;
+            float bounds[10];               // min, max, center and radius
+            uint32_t first_lod, lod_count;  // in the lod records, level 0 being the chunk itself
+        };
+        // the geometry in place, in a mapped file or in arrays, which owner keeps alive
+        struct Geometry {
+            int vertex_format = 0;
+            bool optimize = false;
+            uint64_t vertex_count = 0, triangle_count = 0;
+            uint64_t index_count = 0;       // with the levels
+            uint64_t chunk_count = 0, lod_count = 0;
+            Bounds local_bounds;
+            common::Vector3<float> position_offset = common::Vector3<float>::Zero();
+            common::Vector3<float> position_scale = common::Vector3<float>::Ones();
+            float acmr_before = 0, acmr_after = 0;
+            const ChunkRecord* chunks = nullptr;
+            const LodRecord* lods = nullptr;
+            const uint32_t* chunk_triangles = nullptr;  // the triangle as given of each drawn one
+            const unsigned char* vertices = nullptr;
+            const uint16_t* indices = nullptr;
+            std::shared_ptr<const void> owner;
+        };
+        // the source file a cache is made of
+        struct Source {
+            uint64_t size = 0, time = 0, hash = 0;
+        };
+
+        static std::string pathOf(const std::string& source_path);
+        // the cache of a source file, false if it is missing, corrupt or of another source or format.
+        // The source is described either way, to write the cache with
+        static bool read(const std::string& source_path, int vertex_format, bool optimize, Geometry& geometry,
+                         Source& source);
+        static bool write(const std::string& source_path, const Source& source, const Geometry& geometry);
+        static uint64_t hash(const void* data, size_t size);
+        // bounds as the 10 floats of a record, and back
+        static void storeBounds(const Bounds& bounds, float* out);
+        static Bounds loadBounds(const float* in);
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,764 @@
+#include "mesh_loader.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cctype>
+#include <string>
+#include <thread>
+#include <algorithm>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace simple_viewer {
+
+    using common::PolygonMesh;
+    using common::Vector3;
+
+    //// file
+
+    MappedFile::MappedFile(const char* path): _data(nullptr), _size(0), _valid(false), _mapped(false) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size)) {
+            _size = (size_t)size.QuadPart;
+            _valid = true;
+            HANDLE mapping = _size > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+            if (mapping != nullptr) {
+                _data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                _mapped = _data != nullptr;
+                // the view keeps the mapping
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat info = {};
+        if (fstat(fd, &info) == 0) {
+            _size = (size_t)info.st_size;
+            _valid = true;
+            void* data = _size > 0 ? mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            if (data != MAP_FAILED) {
+                // every thread reads its range from the start
+                madvise(data, _size, MADV_WILLNEED);
+                _data = (const char*)data;
+                _mapped = true;
+            }
+        }
+        close(fd);
+#endif
+        if (_mapped || !_valid || _size == 0) return;
+        // a file system that cannot map it
+        std::FILE* file = std::fopen(path, "rb");
+        _buffer.resize(_size);
+        _valid = file != nullptr && std::fread(_buffer.data(), 1, _size, file) == _size;
+        if (file != nullptr) std::fclose(file);
+        _data = _buffer.data();
+    }
+
+    MappedFile::~MappedFile() {
+        if (!_mapped) return;
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        munmap((void*)_data, _size);
+#endif
+    }
+
+    //// text
+
+    // a thread parses at least this much
+    static const size_t MinPartBytes = 1 << 20;
+    static const uint32_t InvalidIndex = 0xffffffffu;
+    static const double Powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    static bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char* skipBlanks(const char* p, const char* end) {
+        while (p < end && isBlank(*p)) p++;
+        return p;
+    }
+
+    static const char* skipWord(const char* p, const char* end) {
+        while (p < end && !isBlank(*p) && *p != '\n') p++;
+        return p;
+    }
+
+    static const char* lineEnd(const char* p, const char* end) {
+        auto eol = (const char*)std::memchr(p, '\n', end - p);
+        return eol != nullptr ? eol : end;
+    }
+
+    static const char* nextLine(const char* p, const char* end) {
+        const char* eol = lineEnd(p, end);
+        return eol < end ? eol + 1 : end;
+    }
+
+    static bool startsWith(const char* p, const char* end, const char* word) {
+        size_t size = std::strlen(word);
+        return (size_t)(end - p) > size && std::memcmp(p, word, size) == 0 && isBlank(p[size]);
+    }
+
+    // of threads threads asked for (0 for one per core), to parse size bytes
+    static size_t partCount(int threads, size_t size) {
+        if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+        return std::max<size_t>(1, std::min<size_t>((size_t)threads, size / MinPartBytes));
+    }
+
+    // where each of parts ranges of whole lines covering [begin, end) starts, and end
+    static std::vector<const char*> splitLines(const char* begin, const char* end, size_t parts) {
+        std::vector<const char*> bounds(1, begin);
+        for (size_t i = 1; i < parts; i++) {
+            const char* p = std::max(begin + (size_t)(end - begin) * i / parts, bounds.back());
+            bounds.push_back(p > begin ? nextLine(p - 1, end) : p);
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+
+    template <typename Body>
+    static void forEachPart(size_t parts, const Body& body) {
+        common::detail::parallelFor(parts, (int)parts, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) body(i);
+        });
+    }
+
+    static bool parseInt(const char*& p, const char* end, long long& value) {
+        const char* s = p;
+        bool negative = s < end && *s == '-';
+        if (s < end && (*s == '-' || *s == '+')) s++;
+        const char* digits = s;
+        unsigned long long v = 0;
+        for (; s < end && (unsigned)(*s - '0') < 10; s++) v = v * 10 + (unsigned)(*s - '0');
+        if (s == digits) return false;
+        value = negative ? -(long long)v : (long long)v;
+        p = s;
+        return true;
+    }
+
+    bool MeshLoader::parseFloat(const char*& p, const char* end, float& value) {
+        const char* s = p;
+        bool negative = s < end && *s == '-';
+        if (s < end && (*s == '-' || *s == '+')) s++;
+        // up to 19 significant digits, the exponent counting the ones left out
+        unsigned long long mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        for (; s < end && (unsigned)(*s - '0') < 10; s++, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (unsigned)(*s - '0');
+                if (mantissa != 0) digits++;
+            } else {
+                exponent++;
+            }
+        }
+        if (s < end && *s == '.') {
+            for (s++; s < end && (unsigned)(*s - '0') < 10; s++, any = true) {
+                if (digits >= 19) continue;
+                mantissa = mantissa * 10 + (unsigned)(*s - '0');
+                if (mantissa != 0) digits++;
+                exponent--;
+            }
+        }
+        if (!any) {
+            // inf, nan and the like
+            char text[64];
+            const char* word_end = std::min(skipWord(p, end), p + sizeof(text) - 1);
+            std::memcpy(text, p, word_end - p);
+            text[word_end - p] = 0;
+            char* parsed;
+            value = std::strtof(text, &parsed);
+            if (parsed == text) return false;
+            p += parsed - text;
+            return true;
+        }
+        if (s < end && (*s == 'e' || *s == 'E')) {
+            const char* e = s + 1;
+            long long power;
+            if (parseInt(e, end, power)) {
+                exponent += (int)std::max(-1000ll, std::min(1000ll, power));
+                s = e;
+            }
+        }
+        double result;
+        if (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+            // both exact, so the result is rounded once
+            result = exponent < 0 ? (double)mantissa / Powers[-exponent] : (double)mantissa * Powers[exponent];
+        } else {
+            result = (double)mantissa * std::pow(10.0, exponent);
+        }
+        value = (float)(negative ? -result : result);
+        p = s;
+        return true;
+    }
+
+    //// parts
+
+    // what one thread parsed of a file
+    struct Part {
+        std::vector<float> positions, normals;      // 3 floats per vertex, normals when the file has them
+        std::vector<uint32_t> indices;              // corners of the faces
+        std::vector<uint32_t> sizes;                // corners of each face, once one is not a triangle
+        std::vector<size_t> relative;               // corners counted back from the vertices before the part
+        bool polygons = false;
+        bool valid = true;
+
+        // after the corners of a face were added
+        void endFace(size_t count) {
+            if (count != 3 && !polygons) {
+                polygons = true;
+                sizes.assign((indices.size() - count) / 3, 3);
+            }
+            if (polygons) sizes.push_back((uint32_t)count);
+            if (count < 3) valid = false;
+        }
+        size_t faceCount() const { return polygons ? sizes.size() : indices.size() / 3; }
+    };
+
+    // the parts one after another into the mesh, false if one is not valid or a corner is not a vertex
+    static bool merge(std::vector<Part>& parts, PolygonMesh<float>& mesh, bool normals) {
+        size_t n = parts.size();
+        std::vector<size_t> first_vertex(n + 1, 0), first_index(n + 1, 0), first_face(n + 1, 0);
+        bool polygons = false;
+        for (size_t i = 0; i < n; i++) {
+            auto& part = parts[i];
+            if (!part.valid || (normals && part.normals.size() != part.positions.size())) return false;
+            first_vertex[i + 1] = first_vertex[i] + part.positions.size() / 3;
+            first_index[i + 1] = first_index[i] + part.indices.size();
+            first_face[i + 1] = first_face[i] + part.faceCount();
+            polygons = polygons || part.polygons;
+        }
+        size_t vertex_count = first_vertex[n];
+        if (vertex_count >= InvalidIndex || first_index[n] >= InvalidIndex) return false;
+
+        mesh.vertices.resize(vertex_count);
+        mesh.indices.resize(first_index[n]);
+        mesh.offsets.clear();
+        if (polygons) mesh.offsets.resize(first_face[n] + 1, (uint32_t)first_index[n]);
+        std::vector<char> valid(n, 1);
+        forEachPart(n, [&](size_t i) {
+            auto& part = parts[i];
+            auto vertices = mesh.vertices.data() + first_vertex[i];
+            for (size_t v = 0; v < part.positions.size() / 3; v++) {
+                vertices[v].position = Eigen::Map<const Vector3<float>>(&part.positions[v * 3]);
+                if (normals) {
+                    vertices[v].normal = Eigen::Map<const Vector3<float>>(&part.normals[v * 3]);
+                } else {
+                    vertices[v].normal.setZero();
+                }
+            }
+            uint32_t* indices = mesh.indices.data() + first_index[i];
+            std::copy(part.indices.begin(), part.indices.end(), indices);
+            // modulo 2^32, as they were stored
+            for (size_t c : part.relative) indices[c] += (uint32_t)first_vertex[i];
+            for (size_t c = 0; c < part.indices.size(); c++) {
+                if (indices[c] >= vertex_count) valid[i] = 0;
+            }
+            if (polygons) {
+                uint32_t* offsets = mesh.offsets.data() + first_face[i];
+                auto offset = (uint32_t)first_index[i];
+                for (size_t f = 0; f < part.faceCount(); f++) {
+                    offsets[f] = offset;
+                    offset += part.polygons ? part.sizes[f] : 3;
+                }
+            }
+            part = Part();
+        });
+        if (std::find(valid.begin(), valid.end(), 0) == valid.end()) return true;
+        mesh.clear();
+        return false;
+    }
+
+    //// OBJ
+
+    bool MeshLoader::loadObj(const char* data, size_t size, PolygonMesh<float>& mesh, int threads, bool& normals) {
+        normals = false;
+        auto bounds = splitLines(data, data + size, partCount(threads, size));
+        std::vector<Part> parts(bounds.size() - 1);
+        forEachPart(parts.size(), [&](size_t i) {
+            auto& part = parts[i];
+            const char* end = bounds[i + 1];
+            for (const char* p = bounds[i]; p < end && part.valid; p = nextLine(p, end)) {
+                const char* eol = lineEnd(p, end);
+                p = skipBlanks(p, eol);
+                if (startsWith(p, eol, "v")) {
+                    p += 2;
+                    for (int k = 0; k < 3; k++) {
+                        float value = 0;
+                        p = skipBlanks(p, eol);
+                        part.valid = part.valid && parseFloat(p, eol, value);
+                        part.positions.push_back(value);
+                    }
+                } else if (startsWith(p, eol, "f")) {
+                    // v, v/vt, v//vn or v/vt/vn, counting from 1 or back from the last vertex
+                    auto vertex_count = (long long)(part.positions.size() / 3);
+                    size_t count = 0;
+                    for (p = skipBlanks(p + 2, eol); p < eol; p = skipBlanks(skipWord(p, eol), eol), count++) {
+                        long long index;
+                        if (!parseInt(p, eol, index)) {
+                            part.valid = false;
+                            break;
+                        }
+                        if (index < 0) {
+                            part.relative.push_back(part.indices.size());
+                            part.indices.push_back((uint32_t)(vertex_count + index));
+                        } else {
+                            part.indices.push_back(index > 0 && index <= InvalidIndex ?
+                                                   (uint32_t)(index - 1) : InvalidIndex);
+                        }
+                    }
+                    part.endFace(count);
+                }
+                p = eol;
+            }
+        });
+        return merge(parts, mesh, false);
+    }
+
+    //// PLY
+
+    enum PlyType { P_INT8, P_UINT8, P_INT16, P_UINT16, P_INT32, P_UINT32, P_FLOAT32, P_FLOAT64, P_NONE };
+    static const size_t PlySizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+    struct PlyProperty {
+        std::string name;
+        int type;
+        int count_type;             // of a list, P_NONE for a single value
+    };
+
+    struct PlyElement {
+        std::string name;
+        size_t count;
+        std::vector<PlyProperty> properties;
+
+        // bytes of one in a binary file, 0 with lists
+        size_t stride() const {
+            size_t bytes = 0;
+            for (auto& property : properties) {
+                if (property.count_type != P_NONE) return 0;
+                bytes += PlySizes[property.type];
+            }
+            return bytes;
+        }
+        int find(const char* property) const {
+            for (size_t i = 0; i < properties.size(); i++) {
+                if (properties[i].name == property) return (int)i;
+            }
+            return -1;
+        }
+    };
+
+    static int plyType(const std::string& name) {
+        static const char* const names[] = {
+            "char", "int8", "uchar", "uint8", "short", "int16", "ushort", "uint16",
+            "int", "int32", "uint", "uint32", "float", "float32", "double", "float64"
+        };
+        for (int i = 0; i < 16; i++) {
+            if (name == names[i]) return i / 2;
+        }
+        return P_NONE;
+    }
+
+    static double readValue(const char* p, int type, bool swap) {
+        unsigned char bytes[8];
+        std::memcpy(bytes, p, PlySizes[type]);
+        if (swap) std::reverse(bytes, bytes + PlySizes[type]);
+        switch (type) {
+            case P_INT8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+            case P_UINT8: return bytes[0];
+            case P_INT16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+            case P_UINT16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+            case P_INT32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+            case P_UINT32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+            case P_FLOAT32: { float v; std::memcpy(&v, bytes, 4); return v; }
+            default: { double v; std::memcpy(&v, bytes, 8); return v; }
+        }
+    }
+
+    enum PlyFormat { P_ASCII, P_LITTLE_ENDIAN, P_BIG_ENDIAN };
+
+    // the elements it declares and where the data starts, false if it is not a PLY header
+    static bool parsePlyHeader(const char* data, size_t size, std::vector<PlyElement>& elements, int& format,
+                               const char*& body) {
+        const char* end = data + size;
+        const char* p = data;
+        bool magic = false;
+        format = -1;
+        while (p < end) {
+            const char* eol = lineEnd(p, end);
+            std::vector<std::string> words;
+            for (p = skipBlanks(p, eol); p < eol; p = skipBlanks(p, eol)) {
+                const char* word = p;
+                p = skipWord(p, eol);
+                words.emplace_back(word, p);
+            }
+            p = eol < end ? eol + 1 : end;
+            if (!magic) {
+                if (words.size() != 1 || words[0] != "ply") return false;
+                magic = true;
+            } else if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+                continue;
+            } else if (words[0] == "format" && words.size() >= 2) {
+                if (words[1] == "ascii") format = P_ASCII;
+                else if (words[1] == "binary_little_endian") format = P_LITTLE_ENDIAN;
+                else if (words[1] == "binary_big_endian") format = P_BIG_ENDIAN;
+                else return false;
+            } else if (words[0] == "element" && words.size() == 3) {
+                elements.push_back({ words[1], (size_t)std::strtoull(words[2].c_str(), nullptr, 10), {} });
+            } else if (words[0] == "property" && words.size() == 3 && !elements.empty()) {
+                int type = plyType(words[1]);
+                if (type == P_NONE) return false;
+                elements.back().properties.push_back({ words[2], type, P_NONE });
+            } else if (words[0] == "property" && words.size() == 5 && words[1] == "list" && !elements.empty()) {
+                int count_type = plyType(words[2]), type = plyType(words[3]);
+                if (count_type == P_NONE || type == P_NONE) return false;
+                elements.back().properties.push_back({ words[4], type, count_type });
+            } else if (words[0] == "end_header") {
+                body = p;
+                return format >= 0;
+            } else {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    // what the vertex properties are read into
+    struct PlyVertex {
+        int position[3], normal[3];     // index of the property of each component, -1 without one
+
+        explicit PlyVertex(const PlyElement& element) {
+            const char* names[] = { "x", "y", "z", "nx", "ny", "nz" };
+            for (int k = 0; k < 3; k++) {
+                position[k] = element.find(names[k]);
+                normal[k] = element.find(names[k + 3]);
+            }
+        }
+        bool valid() const { return position[0] >= 0 && position[1] >= 0 && position[2] >= 0; }
+        bool normals() const { return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0; }
+    };
+
+    static int plyIndices(const PlyElement& element) {
+        int list = element.find("vertex_indices");
+        if (list < 0) list = element.find("vertex_index");
+        return list >= 0 && element.properties[list].count_type != P_NONE ? list : -1;
+    }
+
+    // the vertices [first, last) of the element at data
+    static void readPlyVertices(const char* data, const PlyElement& element, const PlyVertex& vertex, bool swap,
+                                size_t first, size_t last, Part& part) {
+        size_t stride = element.stride();
+        std::vector<size_t> offsets(1, 0);
+        for (auto& property : element.properties) offsets.push_back(offsets.back() + PlySizes[property.type]);
+        part.positions.resize((last - first) * 3);
+        if (vertex.normals()) part.normals.resize((last - first) * 3);
+        auto read = [&](const char* p, int i) {
+            return (float)readValue(p + offsets[i], element.properties[i].type, swap);
+        };
+        for (size_t v = first; v < last; v++) {
+            const char* p = data + v * stride;
+            for (int k = 0; k < 3; k++) {
+                part.positions[(v - first) * 3 + k] = read(p, vertex.position[k]);
+                if (vertex.normals()) part.normals[(v - first) * 3 + k] = read(p, vertex.normal[k]);
+            }
+        }
+    }
+
+    // the faces of the element at p one after another, moving p past them. No part: only past the rows
+    static bool readPlyFaces(const char*& p, const char* end, const PlyElement& element, bool swap, Part* part) {
+        int list = part != nullptr ? plyIndices(element) : -1;
+        for (size_t f = 0; f < element.count; f++) {
+            size_t face_count = 0;
+            for (int i = 0; i < (int)element.properties.size(); i++) {
+                auto& property = element.properties[i];
+                size_t count = 1;
+                if (property.count_type != P_NONE) {
+                    if ((size_t)(end - p) < PlySizes[property.count_type]) return false;
+                    count = (size_t)readValue(p, property.count_type, swap);
+                    p += PlySizes[property.count_type];
+                }
+                size_t bytes = count * PlySizes[property.type];
+                if ((size_t)(end - p) < bytes) return false;
+                if (i == list) {
+                    for (size_t k = 0; k < count; k++) {
+                        double index = readValue(p + k * PlySizes[property.type], property.type, swap);
+                        part->indices.push_back(index >= 0 && index < InvalidIndex ? (uint32_t)index : InvalidIndex);
+                    }
+                    face_count = count;
+                }
+                p += bytes;
+            }
+            if (part != nullptr) part->endFace(face_count);
+        }
+        return part == nullptr || part->valid;
+    }
+
+    // the same when every face is a triangle and nothing but its list: false to read them one by one
+    static bool readPlyTriangles(const char* p, const char* end, const PlyElement& element, bool swap,
+                                 int threads, std::vector<Part>& parts) {
+        if (element.properties.size() != 1 || plyIndices(element) != 0) return false;
+        auto& property = element.properties[0];
+        size_t index_size = PlySizes[property.type];
+        size_t stride = PlySizes[property.count_type] + index_size * 3;
+        if ((size_t)(end - p) < element.count * stride) return false;
+        size_t count = element.count, n = partCount(threads, count * stride);
+        std::vector<Part> triangles(n);
+        forEachPart(n, [&](size_t i) {
+            auto& part = triangles[i];
+            size_t first = count * i / n, last = count * (i + 1) / n;
+            part.indices.resize((last - first) * 3);
+            for (size_t f = first; f < last && part.valid; f++) {
+                const char* face = p + f * stride;
+                if (readValue(face, property.count_type, swap) != 3) part.valid = false;
+                face += PlySizes[property.count_type];
+                for (size_t k = 0; k < 3; k++) {
+                    double index = readValue(face + k * index_size, property.type, swap);
+                    part.indices[(f - first) * 3 + k] = index >= 0 && index < InvalidIndex ?
+                                                        (uint32_t)index : InvalidIndex;
+                }
+            }
+        });
+        for (auto& part : triangles) {
+            if (!part.valid) return false;
+        }
+        for (auto& part : triangles) parts.push_back(std::move(part));
+        return true;
+    }
+
+    // the lines of the element at p in parallel, moving p past them
+    template <typename ParseLine>
+    static bool readPlyLines(const char*& p, const char* end, size_t count, int threads, std::vector<Part>& parts,
+                             const ParseLine& parse_line) {
+        const char* begin = p;
+        for (size_t i = 0; i < count; i++) {
+            if (p >= end) return false;
+            p = nextLine(p, end);
+        }
+        auto bounds = splitLines(begin, p, partCount(threads, p - begin));
+        size_t first = parts.size();
+        parts.resize(first + bounds.size() - 1);
+        forEachPart(bounds.size() - 1, [&](size_t i) {
+            auto& part = parts[first + i];
+            for (const char* line = bounds[i]; line < bounds[i + 1] && part.valid; line = nextLine(line, end)) {
+                parse_line(line, lineEnd(line, end), part);
+            }
+        });
+        return true;
+    }
+
+    bool MeshLoader::loadPly(const char* data, size_t size, PolygonMesh<float>& mesh, int threads, bool& normals) {
+        normals = false;
+        std::vector<PlyElement> elements;
+        int format;
+        const char* p;
+        if (!parsePlyHeader(data, size, elements, format, p)) return false;
+        const char* end = data + size;
+        uint16_t one = 1;
+        bool little_endian = *(const unsigned char*)&one == 1;
+        bool swap = format != P_ASCII && (format == P_LITTLE_ENDIAN) != little_endian;
+
+        std::vector<Part> parts;
+        size_t vertex_count = 0;
+        for (auto& element : elements) {
+            bool is_vertex = element.name == "vertex", is_face = element.name == "face";
+            PlyVertex vertex(element);
+            if (is_vertex) {
+                if (!vertex.valid() || element.stride() == 0) return false;
+                normals = vertex.normals();
+                vertex_count = element.count;
+            }
+            int list = is_face ? plyIndices(element) : -1;
+            if (is_face && list < 0) return false;
+
+            if (format == P_ASCII) {
+                // every value as a float, to be picked by its property
+                bool read = readPlyLines(p, end, element.count, threads, parts,
+                                         [&](const char* line, const char* eol, Part& part) {
+                    if (!is_vertex && !is_face) return;
+                    float values[6];
+                    size_t count = 0;
+                    for (int i = 0; i < (int)element.properties.size() && part.valid; i++) {
+                        auto& property = element.properties[i];
+                        float value = 0;
+                        line = skipBlanks(line, eol);
+                        part.valid = parseFloat(line, eol, value);
+                        if (property.count_type == P_NONE) {
+                            for (int k = 0; k < 3 && is_vertex; k++) {
+                                if (vertex.position[k] == i) values[k] = value;
+                                if (vertex.normal[k] == i) values[k + 3] = value;
+                            }
+                            continue;
+                        }
+                        bool indices = i == list;
+                        auto list_count = (size_t)value;
+                        if (indices) count = list_count;
+                        for (size_t k = 0; k < list_count && part.valid; k++) {
+                            line = skipBlanks(line, eol);
+                            part.valid = parseFloat(line, eol, value);
+                            if (indices) part.indices.push_back(value >= 0 && value < InvalidIndex ?
+                                                                (uint32_t)value : InvalidIndex);
+                        }
+                    }
+                    if (is_face) part.endFace(count);
+                    if (!is_vertex) return;
+                    part.positions.insert(part.positions.end(), values, values + 3);
+                    if (normals) part.normals.insert(part.normals.end(), values + 3, values + 6);
+                });
+                if (!read) return false;
+            } else if (element.stride() != 0) {
+                size_t bytes = element.count * element.stride();
+                if ((size_t)(end - p) < bytes) return false;
+                if (is_vertex) {
+                    size_t n = partCount(threads, bytes), first = parts.size();
+                    parts.resize(first + n);
+                    forEachPart(n, [&](size_t i) {
+                        readPlyVertices(p, element, vertex, swap, element.count * i / n, element.count * (i + 1) / n,
+                                        parts[first + i]);
+                    });
+                }
+                p += bytes;
+            } else if (is_face && readPlyTriangles(p, end, element, swap, threads, parts)) {
+                p += element.count * (PlySizes[element.properties[0].count_type] +
+                                      3 * PlySizes[element.properties[0].type]);
+            } else if (is_face) {
+                parts.emplace_back();
+                if (!readPlyFaces(p, end, element, swap, &parts.back())) return false;
+            } else if (!readPlyFaces(p, end, element, swap, nullptr)) {
+                return false;
+            }
+        }
+        size_t read = 0;
+        for (auto& part : parts) read += part.positions.size() / 3;
+        return read == vertex_count && merge(parts, mesh, normals);
+    }
+
+    //// STL
+
+    // the corners of the triangles, merged into one vertex where they are at the same position
+    static bool weld(std::vector<Part>& parts, PolygonMesh<float>& mesh) {
+        size_t corner_count = 0;
+        for (auto& part : parts) {
+            if (!part.valid) return false;
+            corner_count += part.positions.size() / 3;
+        }
+        if (corner_count % 3 != 0 || corner_count >= InvalidIndex) return false;
+        size_t capacity = 16;
+        while (capacity < corner_count * 2) capacity *= 2;
+        std::vector<uint32_t> table(capacity, InvalidIndex);
+        mesh.clear();
+        mesh.indices.resize(corner_count);
+        size_t c = 0;
+        for (auto& part : parts) {
+            for (size_t k = 0; k < part.positions.size(); k += 3, c++) {
+                Eigen::Map<const Vector3<float>> position(&part.positions[k]);
+                uint32_t bits[3];
+                for (int axis = 0; axis < 3; axis++) {
+                    // -0 is at 0
+                    float value = position[axis] == 0 ? 0.0f : position[axis];
+                    std::memcpy(&bits[axis], &value, sizeof(float));
+                }
+                uint64_t hash = (bits[0] * 0x9E3779B97F4A7C15ull ^ bits[1]) * 0xC2B2AE3D27D4EB4Full ^ bits[2];
+                hash *= 0x165667B19E3779F9ull;
+                size_t h = (size_t)(hash ^ (hash >> 32)) & (capacity - 1);
+                for (;; h = (h + 1) & (capacity - 1)) {
+                    uint32_t v = table[h];
+                    if (v == InvalidIndex) {
+                        table[h] = v = (uint32_t)mesh.vertices.size();
+                        mesh.vertices.push_back({ position, Vector3<float>::Zero() });
+                    } else if (mesh.vertices[v].position != position) {
+                        continue;
+                    }
+                    mesh.indices[c] = v;
+                    break;
+                }
+            }
+            part = Part();
+        }
+        return true;
+    }
+
+    bool MeshLoader::loadStl(const char* data, size_t size, PolygonMesh<float>& mesh, int threads, bool& normals) {
+        // the facet normals are not those of the vertices
+        normals = false;
+        std::vector<Part> parts;
+        uint32_t triangle_count = 0;
+        if (size >= 84) std::memcpy(&triangle_count, data + 80, sizeof(triangle_count));
+        if (size >= 84 && size == 84 + (size_t)triangle_count * 50) {
+            // 50 bytes per triangle: the normal, 3 corners and 2 attribute bytes
+            size_t n = partCount(threads, size - 84);
+            parts.resize(n);
+            forEachPart(n, [&](size_t i) {
+                size_t first = triangle_count * i / n, last = triangle_count * (i + 1) / n;
+                auto& positions = parts[i].positions;
+                positions.resize((last - first) * 9);
+                for (size_t t = first; t < last; t++) {
+                    std::memcpy(&positions[(t - first) * 9], data + 84 + t * 50 + 12, sizeof(float) * 9);
+                }
+            });
+        } else {
+            if (size < 5 || std::memcmp(data, "solid", 5) != 0) return false;
+            auto bounds = splitLines(data, data + size, partCount(threads, size));
+            parts.resize(bounds.size() - 1);
+            forEachPart(parts.size(), [&](size_t i) {
+                auto& part = parts[i];
+                const char* end = bounds[i + 1];
+                for (const char* p = bounds[i]; p < end && part.valid; p = nextLine(p, end)) {
+                    const char* eol = lineEnd(p, end);
+                    p = skipBlanks(p, eol);
+                    if (!startsWith(p, eol, "vertex")) continue;
+                    p += 7;
+                    for (int k = 0; k < 3; k++) {
+                        float value = 0;
+                        p = skipBlanks(p, eol);
+                        part.valid = part.valid && parseFloat(p, eol, value);
+                        part.positions.push_back(value);
+                    }
+                }
+            });
+        }
+        return weld(parts, mesh);
+    }
+
+    //// file
+
+    bool MeshLoader::load(const char* path, PolygonMesh<float>& mesh, int threads) {
+        mesh.clear();
+        std::string extension(path);
+        size_t dot = extension.find_last_of("./\\");
+        extension = dot != std::string::npos && extension[dot] == '.' ? extension.substr(dot + 1) : "";
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        MappedFile file(path);
+        if (!file.valid()) return false;
+
+        bool loaded = false, normals = false;
+        if (extension == "obj") loaded = loadObj(file.data(), file.size(), mesh, threads, normals);
+        else if (extension == "ply") loaded = loadPly(file.data(), file.size(), mesh, threads, normals);
+        else if (extension == "stl") loaded = loadStl(file.data(), file.size(), mesh, threads, normals);
+        if (!loaded || mesh.empty()) {
+            mesh.clear();
+            return false;
+        }
+        if (!normals) PolygonMesh<float>::perVertexNormal(mesh, common::NORMAL_UNIFORM, threads);
+        return true;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
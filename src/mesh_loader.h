@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include "common/polygon_mesh.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief A whole file for reading, mapped into memory, or read into it where it cannot be
+     */
+    class MappedFile {
+    public:
+        explicit MappedFile(const char* path);
+        MappedFile(const MappedFile& other) = delete;
+        ~MappedFile();
+
+        bool valid() const { return _valid; }
+        const char* data() const { return _data; }
+        size_t size() const { return _size; }
+
+    private:
+        const char* _data;
+        size_t _size;
+        bool _valid;
+        bool _mapped;
+        std::vector<char> _buffer;
+    };
+
+    /**
+     * @brief Parsers of OBJ, PLY and STL files (text or binary) into flat polygon meshes
+     *
+     * Text is cut into one range of whole lines per thread, and every thread
+     * parses its range into arrays of its own, which are then copied after one
+     * another into the mesh, also in parallel. Binary vertices are read the
+     * same way, cut by their count. Faces of OBJ files may count their corners
+     * back from the last vertex, so those are fixed once the vertices before
+     * every range are known. The triangles of STL files have their corners
+     * merged by position. Vertex normals are read from PLY files that have
+     * them, and computed otherwise.
+     */
+    class MeshLoader {
+    public:
+        // the format by the extension of the path, false if it is unknown or the file is not valid
+        static bool load(const char* path, common::PolygonMesh<float>& mesh, int threads = 0);
+
+        // normals: whether the file gave the vertex normals
+        static bool loadObj(const char* data, size_t size, common::PolygonMesh<float>& mesh, int threads,
+                            bool& normals);
+        static bool loadPly(const char* data, size_t size, common::PolygonMesh<float>& mesh, int threads,
+                            bool& normals);
+        static bool loadStl(const char* data, size_t size, common::PolygonMesh<float>& mesh, int threads,
+                            bool& normals);
+
+        // a number in the text at p, which is moved past it, false if there is none
+        static bool parseFloat(const char*& p, const char* end, float& value);
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "mesh_simplifier.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace simple_viewer {
+
+    MeshSimplifier::MeshSimplifier(const float* vertices, size_t vertex_count, size_t stride,
+                                   const unsigned int* indices, size_t triangle_count):
+            _positions(vertex_count * 3), _indices(indices, indices + triangle_count * 3),
+            _alive(triangle_count, true), _locked(vertex_count, false),
+            _quadrics(vertex_count, Quadric{}),
+            _triangles(vertex_count), _alive_count(triangle_count), _error(0) {
+        for (size_t i = 0; i < vertex_count; i++) {
+            std::copy(vertices + i * stride, vertices + i * stride + 3, &_positions[i * 3]);
+        }
+
+        // plane quadrics of the triangles around every vertex
+        std::vector<uint64_t> edges;
+        edges.reserve(triangle_count * 3);
+        for (unsigned int t = 0; t < triangle_count; t++) {
+            unsigned int* tri = &_indices[t * 3];
+            common::Vector3<double> p0 = position(tri[0]).cast<double>();
+            common::Vector3<double> normal = (position(tri[1]).cast<double>() - p0).cross(
+                    position(tri[2]).cast<double>() - p0);
+            double norm = normal.norm();
+            for (int i = 0; i < 3; i++) {
+                _triangles[tri[i]].push_back(t);
+                if (norm > 0) addPlane(_quadrics[tri[i]], normal / norm, -normal.dot(p0) / norm);
+                unsigned int a = tri[i], b = tri[(i + 1) % 3];
+                edges.push_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b));
+            }
+        }
+
+        // an edge of only one triangle is a border, whose vertices stay
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j] == edges[i]) j++;
+            if (j - i == 1) {
+                _locked[edges[i] >> 32] = true;
+                _locked[edges[i] & 0xffffffffu] = true;
+            }
+            i = j;
+        }
+    }
+
+    void MeshSimplifier::addPlane(Quadric& q, const common::Vector3<double>& n, double d) {
+        double* a = q.a;
+        a[0] += n.x() * n.x(); a[1] += n.x() * n.y(); a[2] += n.x() * n.z(); a[3] += n.x() * d;
+        a[4] += n.y() * n.y(); a[5] += n.y() * n.z(); a[6] += n.y() * d;
+        a[7] += n.z() * n.z(); a[8] += n.z() * d;
+        a[9] += d * d;
+    }
+
+    double MeshSimplifier::evaluate(const Quadric& q, const common::Vector3<float>& p) {
+        const double* a = q.a;
+        double x = p.x(), y = p.y(), z = p.z();
+        return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x +
+               a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y +
+               a[7] * z * z + 2 * a[8] * z + a[9];
+    }
+
+    common::Vector3<float> MeshSimplifier::position(unsigned int v) const {
+        return { _positions[v * 3], _positions[v * 3 + 1], _positions[v * 3 + 2] };
+    }
+
+    void MeshSimplifier::pushEdge(unsigned int a, unsigned int b, std::vector<Collapse>& collapses) const {
+        // the cheaper direction of the edge, whose moving vertex is not locked
+        Quadric q = _quadrics[a];
+        for (int i = 0; i < 10; i++) q.a[i] += _quadrics[b].a[i];
+        double to_b = _locked[a] ? -1 : std::max(evaluate(q, position(b)), 0.);
+        double to_a = _locked[b] ? -1 : std::max(evaluate(q, position(a)), 0.);
+        if (to_b < 0 && to_a < 0) return;
+        if (to_a < 0 || (to_b >= 0 && to_b <= to_a)) {
+            collapses.push_back({ to_b, a, b });
+        } else {
+            collapses.push_back({ to_a, b, a });
+        }
+    }
+
+    bool MeshSimplifier::flips(unsigned int from, unsigned int to) const {
+        auto target = position(to);
+        for (auto t : _triangles[from]) {
+            if (!_alive[t]) continue;
+            const unsigned int* tri = &_indices[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+            common::Vector3<float> p[3] = { position(tri[0]), position(tri[1]), position(tri[2]) };
+            common::Vector3<float> before = (p[1] - p[0]).cross(p[2] - p[0]);
+            for (int i = 0; i < 3; i++) {
+                if (tri[i] == from) p[i] = target;
+            }
+            common::Vector3<float> after = (p[1] - p[0]).cross(p[2] - p[0]);
+            if (after.dot(before) <= 0.2f * before.norm() * after.norm()) return true;
+        }
+        return false;
+    }
+
+    void MeshSimplifier::collapse(unsigned int from, unsigned int to) {
+        for (int i = 0; i < 10; i++) _quadrics[to].a[i] += _quadrics[from].a[i];
+
+        // move the triangles of from onto to, dropping the ones that degenerate
+        for (auto t : _triangles[from]) {
+            if (!_alive[t]) continue;
+            unsigned int* tri = &_indices[t * 3];
+            for (int i = 0; i < 3; i++) {
+                if (tri[i] == from) tri[i] = to;
+            }
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) {
+                _alive[t] = false;
+                _alive_count--;
+            } else {
+                _triangles[to].push_back(t);
+            }
+        }
+        std::vector<unsigned int>().swap(_triangles[from]);
+    }
+
+    MeshSimplifier::Level MeshSimplifier::simplify(size_t target_triangles, float max_error) {
+        double max_cost = (double)max_error * max_error;
+        std::vector<Collapse> collapses;
+        std::vector<char> touched(_locked.size());
+        while (_alive_count > target_triangles) {
+            // every edge of the remaining triangles, the shared ones twice
+            collapses.clear();
+            for (size_t t = 0; t < _alive.size(); t++) {
+                if (!_alive[t]) continue;
+                const unsigned int* tri = &_indices[t * 3];
+                for (int i = 0; i < 3; i++) {
+                    if (tri[i] < tri[(i + 1) % 3]) pushEdge(tri[i], tri[(i + 1) % 3], collapses);
+                }
+            }
+
+            // a collapse removes about two triangles, so only the cheapest few are needed
+            size_t needed = std::min(collapses.size(), _alive_count - target_triangles);
+            auto cheaper = [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; };
+            std::nth_element(collapses.begin(), collapses.begin() + needed, collapses.end(), cheaper);
+            collapses.resize(needed);
+            std::sort(collapses.begin(), collapses.end(), cheaper);
+
+            std::fill(touched.begin(), touched.end(), 0);
+            size_t before = _alive_count;
+            for (auto& c : collapses) {
+                if (_alive_count <= target_triangles || c.cost > max_cost) break;
+                if (touched[c.from] || touched[c.to] || flips(c.from, c.to)) continue;
+                touched[c.from] = touched[c.to] = 1;
+                _error = std::max(_error, (float)std::sqrt(c.cost));
+                collapse(c.from, c.to);
+            }
+            if (_alive_count == before) break;
+        }
+
+        // dead triangles are dropped from the adjacency now and then
+        for (auto& around : _triangles) {
+            around.erase(std::remove_if(around.begin(), around.end(), [this](unsigned int t) { return !_alive[t]; }),
+                         around.end());
+        }
+
+        Level level;
+        level.error = _error;
+        level.indices.reserve(_alive_count * 3);
+        for (size_t t = 0; t < _alive.size(); t++) {
+            if (_alive[t]) level.indices.insert(level.indices.end(), &_indices[t * 3], &_indices[t * 3] + 3);
+        }
+        return level;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "common/transform.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief Quadric error metric simplification of an indexed triangle mesh
+     *
+     * Edges are collapsed cheapest first, each vertex moving onto one of its
+     * neighbours, so the vertices are never moved or added: every level keeps
+     * drawing from the original vertex buffer, only the indices change.
+     * Collapses are made in passes over the sorted edges, a vertex taking part
+     * in at most one collapse per pass so the costs stay valid without a heap.
+     * Border vertices are kept in place, and collapses that flip a triangle
+     * are refused. simplify() continues from the previous call, so a chain of
+     * levels is made by asking for fewer and fewer triangles.
+     */
+    class MeshSimplifier {
+    public:
+        struct Level {
+            std::vector<unsigned int> indices;
+            float error;        // largest collapse error so far, as an object space distance
+        };
+
+        // vertex positions are the first 3 floats of every stride
+        MeshSimplifier(const float* vertices, size_t vertex_count, size_t stride,
+                       const unsigned int* indices, size_t triangle_count);
+        MeshSimplifier(const MeshSimplifier& other) = delete;
+
+        // collapse until at most target_triangles remain, or the next collapse would cost more than max_error
+        Level simplify(size_t target_triangles, float max_error);
+        size_t triangleCount() const { return _alive_count; }
+
+    private:
+        // symmetric 4x4 matrix, upper triangle
+        struct Quadric {
+            double a[10];
+        };
+        struct Collapse {
+            double cost;
+            unsigned int from, to;
+        };
+
+        static void addPlane(Quadric& q, const common::Vector3<double>& normal, double d);
+        static double evaluate(const Quadric& q, const common::Vector3<float>& p);
+        common::Vector3<float> position(unsigned int v) const;
+        void pushEdge(unsigned int a, unsigned int b, std::vector<Collapse>& collapses) const;
+        bool flips(unsigned int from, unsigned int to) const;
+        void collapse(unsigned int from, unsigned int to);
+
+        std::vector<float> _positions;
+        std::vector<unsigned int> _indices;
+        std::vector<char> _alive;
+        std::vector<char> _locked;
+        std::vector<Quadric> _quadrics;
+        std::vector<std::vector<unsigned int>> _triangles;  // of every vertex
+        size_t _alive_count;
+        float _error;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -5,17 +5,34 @@
 #include <mutex>
 #include <vector>
 #include <atomic>
+#include <memory>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <shared_mutex>
 #include "camera.h"
 #include "renderer.h"
+#include "mesh_loader.h"
+#include "mesh_cache.h"
+#include "command_queue.h"
+#include "slot_map.h"
+#include "scene_state.h"
+#include "render_queue.h"
+#include "scene_buffer.h"
+#include "worker_pool.h"
+#include "bounds_tree.h"
 #include "shader_program.h"
 #include "shader_vert.h"
 #include "shader_frag.h"
+#include "shader_id_frag.h"
 #include "common/transform.h"
 
 namespace simple_viewer {
 
-    //// lock: one global lock is enough
+    //// lock: guards the objects, held by the render thread while drawing
     static std::mutex mtx;
+    //// lock: guards the mouse/key state, never held while drawing
+    static std::mutex state_mtx;
 
     //// frame interval
     static std::atomic<int> frame_dt(16);
@@ -24,12 +41,90 @@ namespace simple_viewer {
     static std::atomic<Camera*> camera(nullptr);
     static std::atomic<bool> camera_movable(true);
 
-    //// shader
+    //// shader, and the per-frame camera and object records it reads
     static ShaderProgram* shader = nullptr;
+    static CameraBuffer camera_buffer;
+    static ObjectBuffer object_buffer;
+    static const int VAP_DrawId = 3;
+    static std::atomic<unsigned long long> gl_issued(0);
+    static std::atomic<unsigned long long> draw_calls(0), draw_instances(0);
+    static std::atomic<bool> instancing(true);
+    static std::atomic<float> frame_time(0);
+    static std::atomic<unsigned long long> gl_elided(0);
+    //// frames in flight, bounded for the rings of dynamic geometry
+    static FrameFences frame_fences;
+    static_assert(FrameFences::Count <= Renderer::RingPartitions, "a ring partition may be written while drawn");
+    static std::atomic<unsigned long long> frame_waits(0);
 
-    //// object
-    static std::vector<std::pair<int, Renderer*>> objs;
-    static int max_id = -1;
+    //// object: ids are slot map handles, deleted renderers wait in the
+    //// graveyard until the render thread can release their gl objects
+    static SlotMap<Renderer*> objs;
+    static std::vector<Renderer*> graveyard;
+    //// object state: written by producers, snapshotted by the render thread
+    static SceneState states;
+    // vertices of every dynamic mesh as last given, for checking vertex updates when they are
+    // made: the id in the high 32 bits and the count in the low ones, indexed by the slot
+    static PagedArray<std::atomic<unsigned long long>, 10, SlotMap<Renderer*>::MaxSlots> mesh_vertex_counts;
+
+    static void setMeshVertexCount(int id, size_t count) {
+        mesh_vertex_counts.grow(SlotMap<Renderer*>::indexOf(id))
+                .store((unsigned long long)(unsigned int)id << 32 | (unsigned int)count);
+    }
+
+    static unsigned long long meshVertexCount(int id) {
+        auto entry = mesh_vertex_counts.at(SlotMap<Renderer*>::indexOf(id));
+        if (entry == nullptr) return 0;
+        auto value = entry->load();
+        return (int)(unsigned int)(value >> 32) == id ? value & 0xffffffffu : 0;
+    }
+
+    //// command: producers enqueue, the render thread drains at frame start
+    enum CommandType {
+        CMD_NONE = 0,
+        CMD_ADD,
+        CMD_UPDATE,
+        CMD_TRANSFORMS,
+        CMD_GROUP,
+        CMD_VERTICES
+    };
+    struct TransformBatch {
+        unsigned long long ticket = 0;
+        std::vector<int> ids;
+        std::vector<common::Transform<float>> transforms;
+    };
+    struct CommandGroup;
+    struct ObjCommand {
+        CommandType cmd_type = CMD_NONE;
+        ObjUpdateType act_type = OBJ_UPDATE_NONE;
+        int obj_id = -1;
+        int obj_type = ObjType::OBJ_NONE;
+        unsigned long long ticket = 0;
+        common::Transform<float> transform;
+        common::Vector3<float> vec;
+        std::unique_ptr<Renderer> renderer;
+        std::unique_ptr<common::Mesh<float>> mesh;
+        std::unique_ptr<common::PolygonMesh<float>> polygon_mesh;
+        std::unique_ptr<std::vector<float>> line;
+        std::unique_ptr<TransformBatch> batch;
+        std::unique_ptr<CommandGroup> group;
+        std::unique_ptr<MeshRenderer::VertexEdit> vertices;
+    };
+    struct CommandGroup {
+        std::vector<ObjCommand> commands;
+    };
+    static const size_t CommandQueueCapacity = 1 << 16;
+    static CommandQueue<ObjCommand> commands(CommandQueueCapacity); // NOLINT
+    static std::atomic<unsigned long long> cmd_dropped(0);
+    static std::atomic<unsigned long long> cmd_rejected(0);
+    static std::atomic<unsigned long long> tx_committed(0);
+    static std::atomic<unsigned long long> geom_applied(0);
+    static std::atomic<unsigned long long> geom_coalesced(0);
+
+    //// transaction: commands of the calling thread are recorded, then committed as one group
+    static thread_local int tx_depth = 0;
+    static thread_local std::vector<ObjCommand> tx_commands; // NOLINT
+    // ids deleted by the transaction, which stay valid within it until it is committed
+    static thread_local std::vector<int> tx_deleted; // NOLINT
 
     //// axis
     static LineRenderer* axis_line = nullptr;
@@ -43,153 +138,718 @@ namespace simple_viewer {
     static std::atomic<int> line_width(1);
     static std::atomic<bool> show_line(false);
 
+    //// render queue, rebuilt every frame
+    static RenderQueue render_queue;
+    static unsigned int axis_first_record = 0;
+    static std::vector<std::vector<int>> in_frustum;
+    static std::atomic<unsigned long long> objs_visible(0), objs_culled(0);
+
+    //// level of detail, options set by any thread and the stats of the last frame
+    static std::mutex lod_mtx;
+    static LodOptions lod_options;
+    static std::vector<ObjLod> lod_stats;
+    static std::atomic<float> lod_error(0);
+    static std::atomic<unsigned long long> triangles_drawn(0);
+    // visible mesh chunks with levels, and how many pixels a unit of their error covers
+    struct LodCandidate {
+        MeshRenderer* mesh;
+        int id;
+        size_t chunk;
+        float pixels;
+    };
+    static std::vector<LodCandidate> lod_candidates;
+    static std::atomic<unsigned long long> chunks_culled(0);
+
+    //// vertex format of the meshes added without one, and their gpu memory
+    static std::atomic<int> vertex_format(VERTEX_FLOAT);
+    static std::atomic<unsigned long long> mesh_vertex_bytes(0), mesh_index_bytes(0), mesh_float_bytes(0);
+    static std::atomic<bool> mesh_optimization(true);
+    static std::atomic<float> mesh_acmr_before(0), mesh_acmr_after(0);
+    //// memory policy of the static meshes and lines added without one
+    static std::atomic<int> memory_policy(MEMORY_KEEP);
+    static std::atomic<unsigned long long> mesh_cpu_bytes(0);
+    //// meshes added from files, from their cache or not
+    static std::atomic<unsigned long long> mesh_cache_hits(0), mesh_cache_misses(0);
+    static common::Transform<float> last_camera_transform = common::Transform<float>::identity(); // NOLINT
+
+    //// scene tree over the bounds of the shown objects, written by the render
+    //// thread only, so it reads without locking and locks to write
+    static BoundsTree scene_tree;
+    static std::shared_timed_mutex tree_mtx;
+    static std::future<BoundsTree> tree_rebuild;
+    static float tree_built_cost = 0;
+    static std::atomic<unsigned long long> tree_rebuilds(0);
+    static std::atomic<float> tree_cost(0);
+
+    // what picking needs of a shown object, kept with the scene tree and
+    // indexed by the slot of the object id, so picks only read them
+    struct PickEntry {
+        int id = -1;
+        common::Transform<float> transform;
+        common::Vector3<float> scale = common::Vector3<float>::Ones();
+        std::shared_ptr<const TriangleTree> triangles;
+    };
+    static PagedArray<PickEntry, 10, SlotMap<Renderer*>::MaxSlots> pick_entries;
+
+    //// picking: camera of the last frame, and the requests waiting for the id buffer
+    struct PickRequest {
+        int x, y;
+        std::promise<PickResult> result;
+    };
+    static std::mutex pick_mtx;
+    static common::Matrix4<float> frame_view_proj = common::Matrix4<float>::Identity(); // NOLINT
+    static int frame_width = 0, frame_height = 0;
+    static std::vector<PickRequest> pick_requests;
+    static ShaderProgram* id_shader = nullptr;
+    static IdBuffer id_buffer;
+    //// render thread only: the picks whose pixels are being read back, and the frame they were drawn by
+    static std::vector<PickRequest> pick_reading;
+    static std::vector<int> pick_record_ids;
+    static common::Matrix4<float> pick_view_proj = common::Matrix4<float>::Identity(); // NOLINT
+    static int pick_width = 0, pick_height = 0;
+
     //// state
     static std::vector<int> mouse_state(50, 1); // NOLINT
     static std::vector<int> key_state(128, 1); // NOLINT
 
-#define SV_RENDER_LINE(obj) \
-    do { if (!(obj)->isInited()) (obj)->init(1, 2); \
-    glLineWidth(line_width); (obj)->render(true); } while (0)
+    // lighting (ambient, diffuse) of each shading
+    static const float shading_light[2][2] = { {0.5f, 0.8f}, {1.0f, 0.f} };
+
+    // two records per axis: the strip, then the top arrow
+    static void writeAxisRecords(float* records, const common::Matrix3<float>& basis) {
+        if (!axis_arrow) return;
+        for (int axis = 0; axis < 3; axis++) {
+            common::Matrix3<float> rot;
+            rot << (axis != 0), (axis == 0), 0, -(float)(axis == 0),
+                (axis == 1), -(float)(axis == 2), 0, (axis == 2), (axis != 2);
+            common::Transform<float> transform(basis * rot, common::Vector3<float>(0, 0, -8));
+            ObjectBuffer::writeRecord(records, transform, axis_color[axis], 1.0f, 0);
+            records += ObjectBuffer::RecordSize * 4;
+
+            common::Vector3<float> offset(axis == 0, axis == 1, axis == 2);
+            transform.setOrigin(common::Vector3<float>(0, 0, -8) + basis * offset * 0.5);
+            ObjectBuffer::writeRecord(records, transform, axis_color[axis], 0.5f, 0.8f, axis_arrow->getScale());
+            records += ObjectBuffer::RecordSize * 4;
+        }
+    }
+
+    static void drawAxes(unsigned int first_record) {
+        if (!axis_line || !axis_arrow) return;
+        if (!axis_line->isInited()) axis_line->init(1, 2);
+        if (!axis_arrow->isInited()) axis_arrow->init(1, 2);
+        shader->setPolygonMode(GL_FILL);
+        shader->setLineWidth(2);
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            glVertexAttribI1ui(VAP_DrawId, first_record + axis * 2);
+            shader->bindVertexArray(axis_line->vertexArray());
+            axis_line->draw(1);
+            glVertexAttribI1ui(VAP_DrawId, first_record + axis * 2 + 1);
+            shader->bindVertexArray(axis_arrow->vertexArray());
+            axis_arrow->draw(1);
+        }
+        shader->bindVertexArray(0);
+    }
+
+    static Renderer* findObj(int id, int type) {
+        auto obj = objs.find(id);
+        if (obj == nullptr || (*obj)->type() != type) return nullptr;
+        return *obj;
+    }
+
+    static void removeObj(int id) {
+        graveyard.push_back(objs.erase(id));
+    }
+
+    static bool applyTransforms(const TransformBatch& batch) {
+        bool all = true;
+        RenderState state;
+        for (size_t i = 0; i < batch.ids.size(); i++) {
+            state.transform = batch.transforms[i];
+            all &= states.write(batch.ids[i], -1, SceneState::S_TRANSFORM, state, batch.ticket);
+        }
+        return all;
+    }
+
+    static bool applyState(const ObjCommand& cmd) {
+        RenderState state;
+        switch (cmd.act_type) {
+            case OBJ_UPDATE_TRANSFORM:
+                state.transform = cmd.transform;
+                return states.write(cmd.obj_id, cmd.obj_type, SceneState::S_TRANSFORM, state, cmd.ticket);
+            case OBJ_UPDATE_COLOR:
+                state.color = cmd.vec;
+                return states.write(cmd.obj_id, cmd.obj_type, SceneState::S_COLOR, state, cmd.ticket);
+            case OBJ_UPDATE_VISIBLE:
+                state.visible = cmd.vec[0] != 0;
+                return states.write(cmd.obj_id, cmd.obj_type, SceneState::S_VISIBLE, state, cmd.ticket);
+            default:
+                return false;
+        }
+    }
+
+    static bool applyCommand(ObjCommand& cmd) {
+        if (cmd.cmd_type == CMD_ADD) {
+            objs.insert(cmd.obj_id, cmd.renderer.release());
+            return true;
+        }
+        if (cmd.cmd_type == CMD_TRANSFORMS) {
+            return applyTransforms(*cmd.batch);
+        }
+        if (cmd.cmd_type == CMD_VERTICES) {
+            // vertex edits accumulate until the next upload, none supersedes another
+            auto obj = findObj(cmd.obj_id, ObjType::OBJ_MESH);
+            return obj != nullptr && static_cast<MeshRenderer*>(obj)->updateVertices(std::move(*cmd.vertices));
+        }
+        if (cmd.cmd_type == CMD_GROUP) {
+            bool all = true;
+            for (auto& sub : cmd.group->commands) {
+                if (applyCommand(sub)) continue;
+                cmd_rejected++;
+                all = false;
+            }
+            return all;
+        }
+
+        Renderer* obj = nullptr;
+        if (cmd.act_type != OBJ_CLEAR_ALL_TYPE && cmd.act_type != OBJ_CLEAR_ALL) {
+            obj = findObj(cmd.obj_id, cmd.obj_type);
+            if (obj == nullptr) return false;
+        }
+
+        // a geometry update still waiting for upload is superseded by this one
+        if (cmd.act_type >= OBJ_UPDATE_MESH && cmd.act_type <= OBJ_UPDATE_LINE &&
+            obj->hasPendingUpdate()) {
+            geom_coalesced++;
+        }
+
+        switch (cmd.act_type) {
+            case OBJ_UPDATE_TRANSFORM:
+            case OBJ_UPDATE_COLOR:
+            case OBJ_UPDATE_VISIBLE:
+                return applyState(cmd);
+            case OBJ_UPDATE_MESH:
+                if (cmd.polygon_mesh) {
+                    return dynamic_cast<MeshRenderer*>(obj)->updateMesh(std::move(*cmd.polygon_mesh));
+                }
+                return dynamic_cast<MeshRenderer*>(obj)->updateMesh(std::move(*cmd.mesh));
+            case OBJ_UPDATE_CUBE:
+                return dynamic_cast<CubeRenderer*>(obj)->updateCube(cmd.vec);
+            case OBJ_UPDATE_CYLINDER:
+                return dynamic_cast<CylinderRenderer*>(obj)->updateCylinder(cmd.vec.x(), cmd.vec.y());
+            case OBJ_UPDATE_CONE:
+                return dynamic_cast<ConeRenderer*>(obj)->updateCone(cmd.vec.x(), cmd.vec.y());
+            case OBJ_UPDATE_SPHERE:
+                return dynamic_cast<SphereRenderer*>(obj)->updateSphere(cmd.vec.x());
+            case OBJ_UPDATE_LINE:
+                return dynamic_cast<LineRenderer*>(obj)->updateLine(std::move(*cmd.line));
+            case OBJ_UPDATE_LINE_WIDTH:
+                dynamic_cast<LineRenderer*>(obj)->setWidth(cmd.vec[0]);
+                return true;
+            case OBJ_DEL:
+                removeObj(cmd.obj_id);
+                return true;
+            case OBJ_CLEAR_ALL_TYPE:
+                for (int i = (int)objs.size() - 1; i >= 0; i--) {
+                    if (objs.valueAt(i)->type() == cmd.obj_type) {
+                        removeObj(objs.handleAt(i));
+                    }
+                }
+                return true;
+            case OBJ_CLEAR_ALL:
+                for (int i = (int)objs.size() - 1; i >= 0; i--) {
+                    removeObj(objs.handleAt(i));
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
 
-#define SV_RENDER_OBJ(obj) \
-    do { if (!(obj)->isInited()) (obj)->init(1, 2); \
-    (obj)->render(false); } while (0)
+    // must be called with mtx held; the count bound keeps busy producers
+    // from starving the caller
+    static void drainCommands(size_t max_count) {
+        ObjCommand cmd;
+        for (size_t i = 0; i < max_count && commands.pop(cmd); i++) {
+            if (!applyCommand(cmd) && cmd.cmd_type != CMD_GROUP) cmd_rejected++;
+        }
+    }
 
-#define SV_RENDER_OBJ_WITH_LINE(obj) \
-    do { if (show_line) { \
-        shader->setVec3("gColor", common::Vector3<float>(1, 1, 1)); \
-        shader->setFloat("gAmbientIntensity", 1.0f); \
-        shader->setFloat("gDiffuseIntensity", 0); \
-        SV_RENDER_LINE(obj); \
-    } } while (0)
+    // give back the ids reserved by a command that never reaches the render thread
+    static void dropCommand(ObjCommand& cmd) {
+        if (cmd.cmd_type == CMD_ADD) objs.release(cmd.obj_id);
+        if (cmd.cmd_type == CMD_GROUP) {
+            for (auto& sub : cmd.group->commands) dropCommand(sub);
+        }
+        cmd_dropped++;
+    }
 
-    static void drawAxis(int axis, const common::Matrix3<float>& basis) {
-        if (!axis_line) return;
-        shader->setVec3("gColor", axis_color[axis]);
+    static bool submit(ObjCommand&& cmd) {
+        if (tx_depth > 0) {
+            tx_commands.push_back(std::move(cmd));
+            return true;
+        }
+        if (commands.push(std::move(cmd))) return true;
+        // the queue is full: drain it here, unless the render thread is drawing
+        std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+        if (lock.owns_lock()) {
+            drainCommands(commands.capacity());
+            if (commands.push(std::move(cmd))) return true;
+        }
+        dropCommand(cmd);
+        return false;
+    }
 
-        // show the axis strip
-        axis_line->setWidth(2);
-        common::Matrix3<float> rot;
-        rot << (axis != 0), (axis == 0), 0, -(float)(axis == 0),
-            (axis == 1), -(float)(axis == 2), 0, (axis == 2), (axis != 2);
-        shader->setMat3("gWorldBasis", basis * rot);
-        shader->setVec3("gWorldOrigin", common::Vector3<float>(0, 0, -8));
-        shader->setFloat("gAmbientIntensity", 1.0f);
-        shader->setFloat("gDiffuseIntensity", 0);
-        SV_RENDER_OBJ(axis_line);
+    static void setPass(RenderPass pass) {
+        if (pass == RenderPass::P_WIREFRAME) {
+            shader->setPolygonMode(GL_LINE);
+            shader->setLineWidth((float)line_width);
+        } else {
+            shader->setPolygonMode(GL_FILL);
+        }
+    }
 
-        // show the top arrow
-        common::Vector3<float> offset(axis == 0, axis == 1, axis == 2);
-        shader->setVec3("gWorldOrigin", common::Vector3<float>(0, 0, -8) + basis * offset * 0.5);
-        shader->setFloat("gAmbientIntensity", 0.5f);
-        shader->setFloat("gDiffuseIntensity", 0.8f);
-        SV_RENDER_OBJ(axis_arrow);
+    static void setPickEntry(int id, const Renderer* obj) {
+        auto& entry = pick_entries.grow(SlotMap<Renderer*>::indexOf(id));
+        entry.id = id;
+        entry.transform = obj->getTransform();
+        entry.scale = obj->getScale();
+        entry.triangles = obj->triangles();
     }
 
-    static void drawMesh(MeshRenderer* mesh) {
-        shader->setFloat("gAmbientIntensity", 0.5f);
-        shader->setFloat("gDiffuseIntensity",  0.8f);
-        SV_RENDER_OBJ(mesh);
-        SV_RENDER_OBJ_WITH_LINE(mesh);
+    static void clearPickEntry(int id) {
+        auto entry = pick_entries.at(SlotMap<Renderer*>::indexOf(id));
+        if (entry == nullptr || entry->id != id) return;
+        entry->id = -1;
+        entry->triangles.reset();
     }
 
-    static void drawCube(CubeRenderer* cube) {
-        shader->setFloat("gAmbientIntensity", 0.5f);
-        shader->setFloat("gDiffuseIntensity", 0.8f);
-        SV_RENDER_OBJ(cube);
-        SV_RENDER_OBJ_WITH_LINE(cube);
+    // release deleted objects, and drop them from the scene tree
+    static void freeGraveyard() {
+        if (graveyard.empty()) return;
+        std::unique_lock<std::shared_timed_mutex> tree_lock(tree_mtx);
+        for (auto obj : graveyard) {
+            int leaf = obj->getTreeLeaf();
+            if (leaf >= 0) {
+                clearPickEntry(scene_tree.id(leaf));
+                scene_tree.remove(leaf);
+            }
+            obj->deinit();
+            delete obj;
+        }
+        graveyard.clear();
     }
 
-    static void drawCylinder(CylinderRenderer* cyl) {
-        shader->setFloat("gAmbientIntensity", 0.5f);
-        shader->setFloat("gDiffuseIntensity", 0.8f);
-        SV_RENDER_OBJ(cyl);
-        SV_RENDER_OBJ_WITH_LINE(cyl);
+    // bring the scene tree in step with the shown objects and their bounds
+    static void updateSceneTree() {
+        std::unique_lock<std::shared_timed_mutex> lock(tree_mtx);
+
+        // take a finished rebuild, and replay what changed since its snapshot
+        if (tree_rebuild.valid() &&
+            tree_rebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            scene_tree = tree_rebuild.get();
+            for (size_t i = 0; i < objs.size(); i++) objs.valueAt(i)->setTreeLeaf(-1);
+            std::vector<int> stale;
+            scene_tree.forEachLeaf([&](int leaf, int id) {
+                auto obj = objs.find(id);
+                if (obj == nullptr || !(*obj)->isVisible()) {
+                    stale.push_back(leaf);
+                    return;
+                }
+                (*obj)->setTreeLeaf(leaf);
+                // moved since the snapshot: the picking transform is as stale as the bounds
+                if ((*obj)->isBoundsChanged()) setPickEntry(id, *obj);
+                (*obj)->setBoundsChanged(false);
+                scene_tree.assign(leaf, (*obj)->getBounds());
+            });
+            scene_tree.refitAll();
+            for (auto leaf : stale) scene_tree.remove(leaf);
+            tree_built_cost = scene_tree.cost();
+            tree_rebuilds++;
+        }
+
+        for (size_t i = 0; i < objs.size(); i++) {
+            auto obj = objs.valueAt(i);
+            int leaf = obj->getTreeLeaf();
+            if (obj->isVisible()) {
+                if (leaf < 0) {
+                    obj->setTreeLeaf(scene_tree.insert(objs.handleAt(i), obj->getBounds()));
+                    setPickEntry(objs.handleAt(i), obj);
+                } else if (obj->isBoundsChanged()) {
+                    scene_tree.update(leaf, obj->getBounds());
+                    setPickEntry(objs.handleAt(i), obj);
+                }
+                obj->setBoundsChanged(false);
+            } else if (leaf >= 0) {
+                scene_tree.remove(leaf);
+                clearPickEntry(objs.handleAt(i));
+                obj->setTreeLeaf(-1);
+            }
+        }
+
+        // refitting slowly degrades the tree, rebuild it in the background when too costly
+        tree_cost.store(scene_tree.cost());
+        if (!tree_rebuild.valid() && scene_tree.leafCount() >= 64 &&
+            scene_tree.cost() > std::max(tree_built_cost, 1.f) * 1.5f) {
+            tree_rebuild = std::async(std::launch::async, [](std::vector<BoundsTree::Leaf> leaves) {
+                BoundsTree tree;
+                tree.build(std::move(leaves));
+                return tree;
+            }, scene_tree.leaves());
+        }
     }
 
-    static void drawCone(ConeRenderer* cone) {
-        shader->setFloat("gAmbientIntensity", 0.5f);
-        shader->setFloat("gDiffuseIntensity", 0.8f);
-        SV_RENDER_OBJ(cone);
-        SV_RENDER_OBJ_WITH_LINE(cone);
+    // the coarsest level of every candidate within the error, doubling the error until the budget is met
+    static void selectLods(const LodOptions& options, bool camera_moved, unsigned long long triangles) {
+        float error = options.target_error;
+        unsigned long long total;
+        for (int attempt = 0;; attempt++) {
+            total = triangles;
+            for (auto& candidate : lod_candidates) {
+                auto& lods = candidate.mesh->chunks()[candidate.chunk].lods;
+                int level = 0;
+                if (options.enabled) {
+                    while (level + 1 < (int)lods.size() && lods[level + 1].error * candidate.pixels <= error) level++;
+                    if (camera_moved && options.coarser_when_moving) level++;
+                }
+                candidate.mesh->setChunkLod(candidate.chunk, level);
+                total += lods[candidate.mesh->chunks()[candidate.chunk].lod].triangle_count;
+            }
+            if (!options.enabled || options.triangle_budget == 0 || total <= options.triangle_budget || attempt == 8) {
+                break;
+            }
+            error *= 2;
+        }
+        triangles_drawn.store(total);
+        lod_error.store(error);
+
+        // one entry per mesh, whose candidates are consecutive
+        std::unique_lock<std::mutex> lock(lod_mtx);
+        lod_stats.clear();
+        for (auto& candidate : lod_candidates) {
+            auto& chunk = candidate.mesh->chunks()[candidate.chunk];
+            if (lod_stats.empty() || lod_stats.back().obj_id != candidate.id) {
+                lod_stats.emplace_back();
+                lod_stats.back().obj_id = candidate.id;
+                lod_stats.back().level = chunk.lod;
+            }
+            auto& stat = lod_stats.back();
+            stat.level = std::min(stat.level, chunk.lod);
+            stat.levels = std::max(stat.levels, (int)chunk.lods.size());
+            stat.chunks++;
+            stat.triangles += chunk.lods[chunk.lod].triangle_count;
+        }
     }
 
-    static void drawLine(LineRenderer* line) {
-        shader->setFloat("gAmbientIntensity", 1.0f);
-        shader->setFloat("gDiffuseIntensity", 0);
-        SV_RENDER_OBJ(line);
+    // cull the chunks of a mesh, and take the visible ones with levels as candidates, false if none is visible
+    static bool cullChunks(MeshRenderer* mesh, int id, const Frustum& frustum,
+                           const common::Vector3<float>& camera_position, float pixels_per_unit,
+                           unsigned long long& triangles) {
+        auto& chunks = mesh->chunks();
+        bool any = false;
+        unsigned long long culled = 0;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            // a single chunk is the whole mesh, which the scene tree already tested
+            Bounds bounds = chunks.size() == 1 ? mesh->getBounds() :
+                            chunks[c].bounds.transformed(mesh->getTransform(), mesh->getScale());
+            bool visible = chunks.size() == 1 || frustum.intersects(bounds);
+            mesh->setChunkVisible(c, visible);
+            if (!visible) {
+                culled++;
+                continue;
+            }
+            any = true;
+            if (chunks[c].lods.size() > 1) {
+                // the error is in the space of the mesh, so scaled, then projected at the nearest point
+                float distance = (bounds.center - camera_position).norm() - bounds.radius;
+                float pixels = distance > 0 ? pixels_per_unit * mesh->getScale().maxCoeff() / distance :
+                               std::numeric_limits<float>::max();
+                lod_candidates.push_back({ mesh, id, c, pixels });
+            } else {
+                triangles += chunks[c].triangle_count;
+            }
+        }
+        chunks_culled += culled;
+        return any;
     }
 
-    static void drawSphere(SphereRenderer* sphere) {
-        shader->setFloat("gAmbientIntensity", 0.5f);
-        shader->setFloat("gDiffuseIntensity", 0.8f);
-        SV_RENDER_OBJ(sphere);
-        SV_RENDER_OBJ_WITH_LINE(sphere);
+    static void buildRenderQueue(const common::Transform<float>& camera_transform, const Frustum& frustum,
+                                 float pixels_per_unit) {
+        render_queue.clear();
+        bool wireframe = show_line.load();
+        auto forward = -camera_transform.getAxis(2);
+        LodOptions options = getLodOptions();
+        auto min_triangles = options.enabled ? options.min_triangles : std::numeric_limits<unsigned long long>::max();
+
+        // geometry uploads stay on the render thread, and so do the levels of detail built meanwhile
+        unsigned long long vertex_bytes = 0, index_bytes = 0, float_bytes = 0, cpu_bytes = 0, mesh_triangles = 0;
+        double misses_before = 0, misses_after = 0;
+        for (size_t i = 0; i < objs.size(); i++) {
+            auto obj = objs.valueAt(i);
+            if (!obj->isVisible()) continue;
+            if (obj->hasPendingUpdate()) geom_applied++;
+            if (!obj->isInited()) obj->init(1, 2);
+            if (obj->type() != RenderType::R_MESH) continue;
+            auto mesh = static_cast<MeshRenderer*>(obj);
+            mesh->updateLods(min_triangles);
+            mesh->updatePickTree();
+            vertex_bytes += mesh->vertexBytes();
+            index_bytes += mesh->indexBytes();
+            cpu_bytes += mesh->cpuBytes();
+            // as 6 floats per vertex and 32 bit indices
+            float_bytes += sizeof(float) * 6 * mesh->vertexCount() + sizeof(unsigned int) * 3 * mesh->triangleCount();
+            misses_before += mesh->acmrBefore() * (double)mesh->triangleCount();
+            misses_after += mesh->acmrAfter() * (double)mesh->triangleCount();
+            mesh_triangles += mesh->triangleCount();
+        }
+        mesh_acmr_before.store(mesh_triangles > 0 ? (float)(misses_before / (double)mesh_triangles) : 0);
+        mesh_acmr_after.store(mesh_triangles > 0 ? (float)(misses_after / (double)mesh_triangles) : 0);
+        mesh_vertex_bytes.store(vertex_bytes);
+        mesh_cpu_bytes.store(cpu_bytes);
+        mesh_index_bytes.store(index_bytes);
+        mesh_float_bytes.store(float_bytes);
+        updateSceneTree();
+
+        // frustum query of the scene tree, split into subtrees for the workers in large scenes
+        auto& workers = WorkerPool::shared();
+        size_t shown = scene_tree.leafCount();
+        auto subtrees = scene_tree.subtrees(shown >= 4096 ? (workers.size() + 1) * 4 : 1);
+        if (in_frustum.size() < subtrees.size()) in_frustum.resize(subtrees.size());
+        workers.parallelFor(subtrees.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                in_frustum[i].clear();
+                scene_tree.queryFrustum(subtrees[i], frustum, in_frustum[i]);
+            }
+        });
+
+        unsigned long long visible = 0, triangles = 0;
+        lod_candidates.clear();
+        chunks_culled.store(0);
+        for (size_t i = 0; i < subtrees.size(); i++) {
+            for (auto id : in_frustum[i]) {
+                auto obj = *objs.find(id);
+                if (obj->type() == RenderType::R_MESH) {
+                    if (!cullChunks(static_cast<MeshRenderer*>(obj), id, frustum, camera_transform.getOrigin(),
+                                    pixels_per_unit, triangles)) continue;
+                } else {
+                    triangles += obj->triangleCount();
+                }
+                visible++;
+                float depth = forward.dot(obj->getTransform().getOrigin() - camera_transform.getOrigin());
+                if (obj->type() == RenderType::R_LINE) {
+                    render_queue.push(obj, id, RenderPass::P_LINE, Shading::S_UNLIT, depth);
+                    continue;
+                }
+                render_queue.push(obj, id, RenderPass::P_OPAQUE, Shading::S_LIT, depth);
+                if (wireframe) render_queue.push(obj, id, RenderPass::P_WIREFRAME, Shading::S_UNLIT, depth);
+            }
+        }
+        render_queue.sort();
+        objs_visible.store(visible);
+        objs_culled.store(shown - visible);
+
+        bool camera_moved = camera_transform.getOrigin() != last_camera_transform.getOrigin() ||
+                            camera_transform.getBasis() != last_camera_transform.getBasis();
+        last_camera_transform = camera_transform;
+        selectLods(options, camera_moved, triangles);
     }
 
-    static void drawObjects() {
+    static void drawObjects(const common::Transform<float>& camera_transform,
+                            const common::Matrix4<float>& view_proj, float pixels_per_unit) {
         std::unique_lock<std::mutex> lock(mtx);
-        for (int i = (int)objs.size() - 1; i >= 0; i--) {
-            // check if object is deleted
-            if (objs[i].first == -1) {
-                objs[i].second->deinit();
-                delete objs[i].second;
-                objs.erase(objs.begin() + i);
-                continue;
+        drainCommands(commands.depth());
+
+        freeGraveyard();
+
+        // snapshot the object states changed since the last frame
+        RenderState state;
+        for (size_t i = 0; i < objs.size(); i++) {
+            if (!states.read(objs.handleAt(i), state)) continue;
+            auto obj = objs.valueAt(i);
+            obj->setTransform(state.transform);
+            obj->setColor(state.color);
+            obj->setVisible(state.visible);
+        }
+
+        // one record per draw in queue order, followed by the axis records
+        buildRenderQueue(camera_transform, Frustum(view_proj), pixels_per_unit);
+        auto& items = render_queue.items();
+        auto records = object_buffer.map(items.size() + 6);
+        if (records == nullptr) return;
+        for (size_t i = 0; i < items.size(); i++) {
+            auto obj = items[i].renderer;
+            auto pass = RenderQueue::passOf(items[i].key);
+            auto shading = RenderQueue::shadingOf(items[i].key);
+            common::Vector3<float> color = pass == RenderPass::P_WIREFRAME ?
+                                           common::Vector3<float>::Ones() : obj->getColor();
+            ObjectBuffer::writeRecord(records + i * ObjectBuffer::RecordSize * 4, obj->getTransform(), color,
+                                      shading_light[shading][0], shading_light[shading][1], obj->getScale(),
+                                      obj->getPositionOffset(), obj->getPositionScale());
+        }
+        axis_first_record = (unsigned int)items.size();
+        writeAxisRecords(records + items.size() * ObjectBuffer::RecordSize * 4,
+                         camera_transform.getBasis().transpose());
+        object_buffer.unmap();
+
+        // issue the sorted draws, changing gl state only between groups
+        shader->resetState();
+        // and draw each run of the same shared geometry as instances of one call,
+        // whose records are consecutive in the queue order
+        int pass = -1;
+        unsigned long long draw_count = 0;
+        bool instance = instancing.load();
+        for (size_t i = 0; i < items.size();) {
+            auto obj = items[i].renderer;
+            if (RenderQueue::passOf(items[i].key) != pass) {
+                pass = RenderQueue::passOf(items[i].key);
+                setPass((RenderPass)pass);
             }
+            size_t run = 1;
+            while (instance && i + run < items.size() && RenderQueue::passOf(items[i + run].key) == pass &&
+                   items[i + run].renderer->vertexArray() == obj->vertexArray()) run++;
+            if (pass == RenderPass::P_LINE) shader->setLineWidth(static_cast<LineRenderer*>(obj)->getWidth());
+            glVertexAttribI1ui(VAP_DrawId, (GLuint)i);
+            shader->bindVertexArray(obj->vertexArray());
+            draw_count += obj->draw((int)run);
+            i += run;
+        }
+        draw_calls.store(draw_count);
+        draw_instances.store(items.size());
+        shader->bindVertexArray(0);
+        shader->setPolygonMode(GL_FILL);
+    }
+
+    // a point of normalized device coordinates back in world space
+    static common::Vector3<float> unproject(const common::Matrix4<float>& inv_view_proj, float x, float y, float z) {
+        common::Vector4<float> p = inv_view_proj * common::Vector4<float>(x, y, z, 1);
+        return p.head<3>() / p.w();
+    }
+
+    // answer the picks of an earlier frame once its pixels are read back, true if none is left waiting
+    static bool answerPicks() {
+        std::vector<IdBuffer::Pixel> pixels;
+        if (pick_reading.empty()) return true;
+        if (!id_buffer.readDone(pixels)) return false;
+
+        common::Matrix4<float> inv_view_proj = pick_view_proj.inverse();
+        for (size_t i = 0; i < pick_reading.size(); i++) {
+            auto& request = pick_reading[i];
+            auto& pixel = pixels[i];
+            PickResult result;
+            // the objects removed since are missed
+            auto obj = pixel.record < pick_record_ids.size() ? objs.find(pick_record_ids[pixel.record]) : nullptr;
+            if (obj != nullptr) {
+                result.obj_id = pick_record_ids[pixel.record];
+                result.triangle = (*obj)->type() == RenderType::R_MESH && pixel.triangle < (*obj)->triangleCount() ?
+                                  (int)static_cast<MeshRenderer*>(*obj)->originalTriangle(pixel.triangle) :
+                                  (int)pixel.triangle;
+                result.point = unproject(inv_view_proj, (request.x + 0.5f) * 2 / (float)pick_width - 1,
+                                         1 - (request.y + 0.5f) * 2 / (float)pick_height, pixel.depth * 2 - 1);
+            }
+            request.result.set_value(result);
+        }
+        pick_reading.clear();
+        return true;
+    }
+
+    // render the record and triangle of the opaque draws into the id buffer and start reading the picked pixels,
+    // answered by a later frame. One read at a time, the picks requested meanwhile waiting for the next
+    static void drawPickBuffer(const common::Matrix4<float>& view_proj, int width, int height) {
+        if (!answerPicks()) return;
+        std::vector<PickRequest> requests;
+        {
+            std::unique_lock<std::mutex> lock(pick_mtx);
+            requests.swap(pick_requests);
+        }
+        if (requests.empty() || id_shader == nullptr) return;
 
-            // render object
-            auto& transform = objs[i].second->getTransform();
-            shader->setMat3("gWorldBasis", transform.getBasis());
-            shader->setVec3("gWorldOrigin", transform.getOrigin());
-            shader->setVec3("gColor", objs[i].second->getColor());
-            if (objs[i].second->type() == RenderType::R_MESH) {
-                drawMesh(dynamic_cast<MeshRenderer*>(objs[i].second));
-            } else if (objs[i].second->type() == RenderType::R_CUBE) {
-                drawCube(dynamic_cast<CubeRenderer*>(objs[i].second));
-            } else if (objs[i].second->type() == RenderType::R_CYLINDER) {
-                drawCylinder(dynamic_cast<CylinderRenderer*>(objs[i].second));
-            } else if (objs[i].second->type() == RenderType::R_CONE) {
-                drawCone(dynamic_cast<ConeRenderer*>(objs[i].second));
-            } else if (objs[i].second->type() == RenderType::R_LINE) {
-                drawLine(dynamic_cast<LineRenderer*>(objs[i].second));
-            } else if (objs[i].second->type() == RenderType::R_SPHERE) {
-                drawSphere(dynamic_cast<SphereRenderer*>(objs[i].second));
+        id_buffer.init(width, height);
+        id_buffer.bind();
+        id_shader->use();
+        auto& items = render_queue.items();
+        for (size_t i = 0; i < items.size() && RenderQueue::passOf(items[i].key) == RenderPass::P_OPAQUE;) {
+            auto obj = items[i].renderer;
+            size_t run = 1;
+            while (i + run < items.size() && RenderQueue::passOf(items[i + run].key) == RenderPass::P_OPAQUE &&
+                   items[i + run].renderer->vertexArray() == obj->vertexArray()) run++;
+            glVertexAttribI1ui(VAP_DrawId, (GLuint)i);
+            glBindVertexArray(obj->vertexArray());
+            // the full chunks, numbering their primitives in chunk order
+            if (obj->type() == RenderType::R_MESH) {
+                auto mesh = static_cast<MeshRenderer*>(obj);
+                auto& chunks = mesh->chunks();
+                for (size_t c = 0; c < chunks.size(); c++) {
+                    if (!chunks[c].visible) continue;
+                    id_shader->setInt("gTriangleOffset", (int)chunks[c].first_triangle);
+                    mesh->drawChunk(c, 0, (int)run);
+                }
+                id_shader->setInt("gTriangleOffset", 0);
+            } else {
+                obj->draw((int)run);
             }
+            i += run;
+        }
+        glBindVertexArray(0);
+
+        std::vector<std::pair<int, int>> pixels;
+        for (auto& request : requests) pixels.emplace_back(request.x, height - 1 - request.y);
+        id_buffer.readAsync(pixels);
+        pick_record_ids.clear();
+        for (size_t i = 0; i < items.size() && RenderQueue::passOf(items[i].key) == RenderPass::P_OPAQUE; i++) {
+            pick_record_ids.push_back(items[i].id);
         }
+        pick_reading = std::move(requests);
+        pick_view_proj = view_proj;
+        pick_width = width;
+        pick_height = height;
+        id_buffer.unbind();
+        shader->use();
+        shader->resetState();
     }
 
     static void display() {
         if (camera.load() == nullptr || shader == nullptr) return;
+        auto start = std::chrono::steady_clock::now();
+        // bound the frames in flight, so no ring partition written by this frame is still drawn
+        if (frame_fences.begin()) frame_waits++;
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader->resetCounters();
 
-        // render objects
+        // camera data of the scene and of the axis overlay, uploaded once per frame
         auto& camera_transform = camera.load()->getTransform(glutGet(GLUT_ELAPSED_TIME));
-        shader->setMat3("gCameraBasis", camera_transform.getBasis());
-        shader->setVec3("gCameraOrigin", camera_transform.getOrigin());
-        shader->setFloat("gProj[0]", (float)camera.load()->getProj(0));
-        shader->setFloat("gProj[1]", (float)camera.load()->getProj(1));
-        shader->setFloat("gProj[2]", (float)camera.load()->getProj(2));
-        shader->setFloat("gProj[3]", (float)camera.load()->getProj(3));
-        shader->setVec3("gScreenOffset", common::Vector3<float>::Zero());
-        drawObjects();
+        auto width = glutGet(GLUT_WINDOW_WIDTH);
+        auto height = glutGet(GLUT_WINDOW_HEIGHT);
+        float aspect = (float)width / (float)height;
+        common::Matrix4<float> view_proj[2] = {
+                camera.load()->getViewProj(camera_transform, common::Vector3<float>::Zero()),
+                camera.load()->getViewProj(common::Transform<float>::identity(),
+                                           common::Vector3<float>(-1.0f + 0.2f / aspect, -0.8f, 0.f))
+        };
+        camera_buffer.update(view_proj, 2);
+        camera_buffer.bind(0, 0);
+        object_buffer.bind(0);
+        {
+            std::unique_lock<std::mutex> lock(pick_mtx);
+            frame_view_proj = view_proj[0];
+            frame_width = width;
+            frame_height = height;
+        }
+
+        // render objects
+        // a unit of length at unit distance covers proj[1] half heights of the window
+        drawObjects(camera_transform, view_proj[0], camera.load()->getProj(1) * (float)height / 2);
+        drawPickBuffer(view_proj[0], width, height);
 
         // render axes
         if (show_axis.load()) {
-            shader->setMat3("gCameraBasis", common::Matrix3<float>::Identity());
-            shader->setVec3("gCameraOrigin", common::Vector3<float>::Zero());
-            auto width = glutGet(GLUT_WINDOW_WIDTH);
-            auto height = glutGet(GLUT_WINDOW_HEIGHT);
-            float aspect = (float)width / (float)height;
-            shader->setVec3("gScreenOffset",
-                            common::Vector3<float>(-1.0f + 0.2f / aspect, -0.8f, 0.f));
-            auto cam_inv_basis = camera_transform.getBasis().transpose();
             glClear(GL_DEPTH_BUFFER_BIT);
-            drawAxis(0, cam_inv_basis);
-            drawAxis(1, cam_inv_basis);
-            drawAxis(2, cam_inv_basis);
+            camera_buffer.bind(1, 0);
+            drawAxes(axis_first_record);
         }
 
+        gl_issued.store(shader->issuedCount());
+        gl_elided.store(shader->elidedCount());
+        frame_fences.end();
+        frame_time.store(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
         glutSwapBuffers();
     }
 
@@ -202,21 +862,21 @@ namespace simple_viewer {
     static void keyboard(unsigned char key, int, int) {
         if (camera.load() == nullptr) return;
         if (camera_movable.load()) camera.load()->keyboard(key, 0);
-        std::unique_lock<std::mutex> lock(mtx);
+        std::unique_lock<std::mutex> lock(state_mtx);
         key_state[key] = 2;
     }
 
     static void keyboardUp(unsigned char key, int, int) {
         if (camera.load() == nullptr) return;
         if (camera_movable.load()) camera.load()->keyboard(key, 1);
-        std::unique_lock<std::mutex> lock(mtx);
+        std::unique_lock<std::mutex> lock(state_mtx);
         key_state[key] = 3;
     }
 
     static void mouse(int button, int state, int x, int y) {
         if (camera.load() == nullptr) return;
         if (camera_movable.load()) camera.load()->mouse(button, state, x, y);
-        std::unique_lock<std::mutex> lock(mtx);
+        std::unique_lock<std::mutex> lock(state_mtx);
         mouse_state[button] = state + 2;
     }
 
@@ -234,18 +894,36 @@ namespace simple_viewer {
     static void close_() {
         if (shader == nullptr) return;
         delete shader; shader = nullptr;
+        delete id_shader; id_shader = nullptr;
+        camera_buffer.deinit();
+        object_buffer.deinit();
+        id_buffer.deinit();
+        frame_fences.deinit();
+        {
+            // no frame will answer the waiting picks
+            std::unique_lock<std::mutex> lock(pick_mtx);
+            for (auto& request : pick_requests) request.result.set_value(PickResult());
+            pick_requests.clear();
+            for (auto& request : pick_reading) request.result.set_value(PickResult());
+            pick_reading.clear();
+            frame_width = frame_height = 0;
+        }
         // reset camera state
         if (camera.load() != nullptr) {
             camera.load()->reset();
         }
         std::unique_lock<std::mutex> lock(mtx);
-        // deinit objects
-        for (auto& obj: objs) {
-            obj.second->deinit();
+        // deinit objects, reading back the geometry they no longer have a copy of
+        for (size_t i = 0; i < objs.size(); i++) {
+            objs.valueAt(i)->cacheGeometry();
+            objs.valueAt(i)->deinit();
         }
+        freeGraveyard();
         // deinit axes
         if (axis_line) axis_line->deinit();
         if (axis_arrow) axis_arrow->deinit();
+        // the cache writes of the meshes loaded meanwhile, the level builds being cancelled by deinit()
+        WorkerPool::shared().wait();
     }
 
     void open(const std::string &name, int width, int height) {
@@ -275,6 +953,15 @@ namespace simple_viewer {
         shader = new ShaderProgram(shader_vert, shader_frag);
         shader->use();
         shader->setVec3("gLightDirection", common::Vector3<float>(1, -2, -3).normalized());
+        shader->setInt("gObjects", 0);
+        shader->bindUniformBlock("Camera", 0);
+        id_shader = new ShaderProgram(shader_vert, shader_id_frag);
+        id_shader->use();
+        id_shader->setInt("gObjects", 0);
+        id_shader->bindUniformBlock("Camera", 0);
+        shader->use();
+        camera_buffer.init();
+        object_buffer.init();
 
         // init axes
         if (!axis_line) axis_line = new LineRenderer({ 0.f, 0.f, 0.f, 0.f, 0.5f, 0.f });
@@ -324,94 +1011,214 @@ namespace simple_viewer {
         camera_movable.store(move);
     }
 
-    static int findObj(int id, int type) {
+    // reserve the id of a new object, and queue the command adding its renderer
+    static int submitAdd(ObjCommand&& cmd) {
+        int id = objs.reserve();
         if (id < 0) return -1;
-        int size = (int)objs.size();
-        for (int idx = 0; idx < size; idx++) {
-            if (objs[idx].first == id &&
-                objs[idx].second->type() == type)
-                return idx;
-        }
-        return -1;
+        cmd.obj_id = id;
+        RenderState state;
+        state.color = cmd.renderer->getColor();
+        states.reset(id, cmd.obj_type, state);
+        return submit(std::move(cmd)) ? id : -1;
     }
 
     int addObj(const ObjInitParam &param) {
-        std::unique_lock<std::mutex> lock(mtx);
+        ObjCommand cmd;
+        cmd.cmd_type = CMD_ADD;
+        cmd.obj_type = param.type;
         switch (param.type) {
-            case ObjType::OBJ_MESH:
-                objs.emplace_back(++max_id, new MeshRenderer(param.mesh, param.dynamic));
-                break;
+            case ObjType::OBJ_MESH: {
+                int format = param.vertex_format == VERTEX_DEFAULT ? vertex_format.load() : param.vertex_format;
+                if (!param.polygon_mesh.empty()) {
+                    cmd.renderer.reset(new MeshRenderer(param.polygon_mesh, param.dynamic, format,
+                                                        mesh_optimization.load()));
+                } else {
+                    cmd.renderer.reset(new MeshRenderer(param.mesh, param.dynamic, format, mesh_optimization.load()));
+                }
+                if (!param.dynamic) break;
+                int id = submitAdd(std::move(cmd));
+                if (id >= 0) {
+                    setMeshVertexCount(id, param.polygon_mesh.empty() ? param.mesh.vertices.size() :
+                                           param.polygon_mesh.vertices.size());
+                }
+                return id;
+            }
             case ObjType::OBJ_CUBE:
-                objs.emplace_back(++max_id, new CubeRenderer(param.size, param.dynamic));
+                cmd.renderer.reset(new CubeRenderer(param.size, param.dynamic));
                 break;
             case ObjType::OBJ_CYLINDER:
-                objs.emplace_back(++max_id, new CylinderRenderer(param.size.x(), param.size.y(), param.dynamic));
+                cmd.renderer.reset(new CylinderRenderer(param.size.x(), param.size.y(), param.dynamic));
                 break;
             case ObjType::OBJ_CONE:
-                objs.emplace_back(++max_id, new ConeRenderer(param.size.x(), param.size.y(), param.dynamic));
+                cmd.renderer.reset(new ConeRenderer(param.size.x(), param.size.y(), param.dynamic));
                 break;
             case ObjType::OBJ_SPHERE:
-                objs.emplace_back(++max_id, new SphereRenderer(param.size.x(), param.dynamic));
+                cmd.renderer.reset(new SphereRenderer(param.size.x(), param.dynamic));
                 break;
             case ObjType::OBJ_LINE:
-                objs.emplace_back(++max_id, new LineRenderer(param.line, param.dynamic));
+                cmd.renderer.reset(new LineRenderer(param.line, param.dynamic));
                 break;
             default:
                 throw std::runtime_error("Unknown object type");
         }
-        return max_id;
+        if (param.type == ObjType::OBJ_MESH || param.type == ObjType::OBJ_LINE) {
+            cmd.renderer->setMemoryPolicy(param.memory_policy == MEMORY_DEFAULT ?
+                                          memory_policy.load() : param.memory_policy);
+        }
+        return submitAdd(std::move(cmd));
     }
 
     bool updateObj(const ObjUpdateParam &param) {
-        std::unique_lock<std::mutex> lock(mtx);
-        int obj_idx;
-        if (param.act_type != OBJ_CLEAR_ALL_TYPE && param.act_type != OBJ_CLEAR_ALL) {
-            obj_idx = findObj(param.obj_id, param.obj_type);
-            if (obj_idx < 0) return false;
+        if (param.act_type != OBJ_CLEAR_ALL_TYPE && param.act_type != OBJ_CLEAR_ALL &&
+            !objs.alive(param.obj_id)) {
+            return false;
         }
 
+        ObjCommand cmd;
+        cmd.cmd_type = CMD_UPDATE;
+        cmd.act_type = param.act_type;
+        cmd.obj_id = param.obj_id;
+        cmd.obj_type = param.obj_type;
+        cmd.ticket = states.ticket();
         switch (param.act_type) {
             case OBJ_UPDATE_TRANSFORM:
-                objs[obj_idx].second->setTransform(param.transform);
-                return true;
+                cmd.transform = param.transform;
+                if (tx_depth == 0) return applyState(cmd);
+                break;
             case OBJ_UPDATE_COLOR:
-                objs[obj_idx].second->setColor(param.vec);
-                return true;
-            case OBJ_UPDATE_MESH:
-                return dynamic_cast<MeshRenderer*>(objs[obj_idx].second)->updateMesh(param.mesh);
+            case OBJ_UPDATE_VISIBLE:
+                cmd.vec = param.vec;
+                if (tx_depth == 0) return applyState(cmd);
+                break;
             case OBJ_UPDATE_CUBE:
-                return dynamic_cast<CubeRenderer*>(objs[obj_idx].second)->updateCube(param.vec);
             case OBJ_UPDATE_CYLINDER:
-                return dynamic_cast<CylinderRenderer*>(objs[obj_idx].second)
-                    ->updateCylinder(param.vec.x(), param.vec.y());
             case OBJ_UPDATE_CONE:
-                return dynamic_cast<ConeRenderer*>(objs[obj_idx].second)
-                    ->updateCone(param.vec.x(), param.vec.y());
             case OBJ_UPDATE_SPHERE:
-                return dynamic_cast<SphereRenderer*>(objs[obj_idx].second)->updateSphere(param.vec.x());
-            case OBJ_UPDATE_LINE:
-                return dynamic_cast<LineRenderer*>(objs[obj_idx].second)->updateLine(param.line);
             case OBJ_UPDATE_LINE_WIDTH:
-                dynamic_cast<LineRenderer*>(objs[obj_idx].second)->setWidth(param.vec[0]);
-                return true;
+                cmd.vec = param.vec;
+                break;
+            case OBJ_UPDATE_MESH:
+                if (!param.polygon_mesh.empty()) {
+                    cmd.polygon_mesh.reset(new common::PolygonMesh<float>(param.polygon_mesh));
+                } else {
+                    cmd.mesh.reset(new common::Mesh<float>(param.mesh));
+                }
+                // only dynamic meshes take updates, and have a count to keep
+                if (meshVertexCount(param.obj_id) > 0) {
+                    setMeshVertexCount(param.obj_id, param.polygon_mesh.empty() ? param.mesh.vertices.size() :
+                                                     param.polygon_mesh.vertices.size());
+                }
+                break;
+            case OBJ_UPDATE_LINE:
+                cmd.line.reset(new std::vector<float>(param.line));
+                break;
             case OBJ_DEL:
-                objs[obj_idx].first = -1;
-                return true;
             case OBJ_CLEAR_ALL_TYPE:
-                for (auto& obj: objs) {
-                    if (obj.second->type() == param.obj_type) {
-                        obj.first = -1;
-                    }
-                }
-                return true;
             case OBJ_CLEAR_ALL:
-                for (auto& obj: objs) {
-                    obj.first = -1;
-                }
-                return true;
+                break;
             default:
                 throw std::runtime_error("Unknown update command type");
         }
+        if (!submit(std::move(cmd))) return false;
+        // stale the id right away (or once its transaction commits), the render thread frees the slot later
+        if (param.act_type == OBJ_DEL) {
+            if (tx_depth > 0) {
+                tx_deleted.push_back(param.obj_id);
+            } else {
+                objs.retire(param.obj_id);
+            }
+        }
+        return true;
+    }
+
+    bool setTransforms(const ObjTransform* transforms, int count, int stride) {
+        if (count <= 0) return true;
+        if (stride == 0) stride = sizeof(ObjTransform);
+        ObjCommand cmd;
+        cmd.cmd_type = CMD_TRANSFORMS;
+        cmd.batch.reset(new TransformBatch);
+        cmd.batch->ticket = states.ticket();
+        cmd.batch->ids.resize(count);
+        cmd.batch->transforms.resize(count);
+        auto ptr = reinterpret_cast<const char*>(transforms);
+        for (int i = 0; i < count; i++, ptr += stride) {
+            auto& t = *reinterpret_cast<const ObjTransform*>(ptr);
+            cmd.batch->ids[i] = t.obj_id;
+            cmd.batch->transforms[i] = t.transform;
+        }
+        return submit(std::move(cmd));
+    }
+
+    bool setTransforms(const int* ids, const float* positions, const float* rotations, int count,
+                       PoseFormat format, int id_stride, int position_stride, int rotation_stride) {
+        if (count <= 0) return true;
+        if (id_stride == 0) id_stride = sizeof(int);
+        if (position_stride == 0) position_stride = sizeof(float) * 3;
+        if (rotation_stride == 0) rotation_stride = sizeof(float) * (format == POSE_QUATERNION ? 4 : 9);
+        ObjCommand cmd;
+        cmd.cmd_type = CMD_TRANSFORMS;
+        cmd.batch.reset(new TransformBatch);
+        cmd.batch->ticket = states.ticket();
+        cmd.batch->ids.resize(count);
+        cmd.batch->transforms.resize(count);
+        auto id_ptr = reinterpret_cast<const char*>(ids);
+        auto pos_ptr = reinterpret_cast<const char*>(positions);
+        auto rot_ptr = reinterpret_cast<const char*>(rotations);
+        for (int i = 0; i < count; i++) {
+            cmd.batch->ids[i] = *reinterpret_cast<const int*>(id_ptr + (size_t)i * id_stride);
+            auto& trans = cmd.batch->transforms[i];
+            auto p = reinterpret_cast<const float*>(pos_ptr + (size_t)i * position_stride);
+            trans.setOrigin({ p[0], p[1], p[2] });
+            if (rotations == nullptr) continue;
+            auto r = reinterpret_cast<const float*>(rot_ptr + (size_t)i * rotation_stride);
+            if (format == POSE_QUATERNION) {
+                trans.setBasis(common::Quaternion<float>(r[3], r[0], r[1], r[2]).toRotationMatrix());
+            } else {
+                trans.setBasis(Eigen::Map<const common::Matrix3<float>>(r));
+            }
+        }
+        return submit(std::move(cmd));
+    }
+
+    bool updateMeshVertices(int id, int first, int count, const float* positions, const float* normals) {
+        if (first < 0 || count <= 0 || (positions == nullptr && normals == nullptr) || !objs.alive(id)) return false;
+        if ((unsigned long long)first + (unsigned long long)count > meshVertexCount(id)) return false;
+        ObjCommand cmd;
+        cmd.cmd_type = CMD_VERTICES;
+        cmd.obj_id = id;
+        cmd.vertices.reset(new MeshRenderer::VertexEdit);
+        cmd.vertices->first = (unsigned long long)first;
+        cmd.vertices->count = (unsigned long long)count;
+        if (positions) cmd.vertices->positions.assign(positions, positions + (size_t)count * 3);
+        if (normals) cmd.vertices->normals.assign(normals, normals + (size_t)count * 3);
+        return submit(std::move(cmd));
+    }
+
+    void beginUpdate() {
+        tx_depth++;
+    }
+
+    bool commitUpdate() {
+        if (tx_depth == 0) return false;
+        if (--tx_depth > 0) return true;
+        std::vector<int> deleted;
+        deleted.swap(tx_deleted);
+        if (tx_commands.empty()) return true;
+
+        // the whole transaction takes effect at commit time
+        auto ticket = states.ticket();
+        ObjCommand cmd;
+        cmd.cmd_type = CMD_GROUP;
+        cmd.group.reset(new CommandGroup);
+        cmd.group->commands.swap(tx_commands);
+        for (auto& sub : cmd.group->commands) {
+            sub.ticket = ticket;
+            if (sub.batch) sub.batch->ticket = ticket;
+        }
+        if (!submit(std::move(cmd))) return false;
+        for (auto id : deleted) objs.retire(id);
+        tx_committed++;
+        return true;
     }
 
     void showAxis(bool show) {
@@ -423,9 +1230,66 @@ namespace simple_viewer {
         line_width.store(width);
     }
 
+    void setVertexFormat(VertexFormat format) {
+        vertex_format.store(format == VERTEX_DEFAULT ? VERTEX_FLOAT : format);
+    }
+
+    void setMeshOptimization(bool optimize) {
+        mesh_optimization.store(optimize);
+    }
+
+    void setMemoryPolicy(MemoryPolicy policy) {
+        memory_policy.store(policy == MEMORY_DEFAULT ? MEMORY_KEEP : policy);
+    }
+
+    void setLodOptions(const LodOptions& options) {
+        std::unique_lock<std::mutex> lock(lod_mtx);
+        lod_options = options;
+    }
+
+    LodOptions getLodOptions() {
+        std::unique_lock<std::mutex> lock(lod_mtx);
+        return lod_options;
+    }
+
+    bool loadMeshFile(const std::string& path, common::PolygonMesh<float>& mesh, int threads) {
+        return MeshLoader::load(path.c_str(), mesh, threads);
+    }
+
+    bool loadMeshFile(const std::string& path, common::Mesh<float>& mesh, int threads) {
+        common::PolygonMesh<float> polygons;
+        bool loaded = MeshLoader::load(path.c_str(), polygons, threads);
+        mesh = polygons.toMesh();
+        return loaded;
+    }
+
+    int addMeshFile(const std::string& path, VertexFormat format) {
+        int layout = format == VERTEX_DEFAULT ? vertex_format.load() : format;
+        bool optimize = mesh_optimization.load();
+        ObjCommand cmd;
+        cmd.cmd_type = CMD_ADD;
+        cmd.obj_type = ObjType::OBJ_MESH;
+        MeshCache::Geometry geometry;
+        MeshCache::Source source;
+        if (MeshCache::read(path, layout, optimize, geometry, source)) {
+            mesh_cache_hits++;
+            cmd.renderer.reset(new MeshRenderer(geometry));
+        } else {
+            common::PolygonMesh<float> mesh;
+            if (!MeshLoader::load(path.c_str(), mesh)) return -1;
+            mesh_cache_misses++;
+            auto renderer = new MeshRenderer(mesh, false, layout, optimize);
+            // written by the worker building its levels, once the render thread has uploaded it
+            renderer->writeCache(path, source);
+            cmd.renderer.reset(renderer);
+        }
+        cmd.renderer->setMemoryPolicy(memory_policy.load());
+        return submitAdd(std::move(cmd));
+    }
+
     int getMouseState(int button) {
         if (button < 0 || button >= 50) return -1;
-        std::unique_lock<std::mutex> lock(mtx);
+        std::unique_lock<std::mutex> lock(state_mtx);
         int state = mouse_state[button];
         if (state > 1) mouse_state[button] -= 2;
         return state;
@@ -433,10 +1297,145 @@ namespace simple_viewer {
 
     int getKeyState(char key) {
         if (key < 0) return -1;
-        std::unique_lock<std::mutex> lock(mtx);
+        std::unique_lock<std::mutex> lock(state_mtx);
         int state = key_state[key];
         if (state > 1) key_state[key] -= 2;
         return state;
     }
 
+    ViewerStats getStats() {
+        ViewerStats stats;
+        stats.cmd_queue_depth = commands.depth();
+        stats.cmd_queue_capacity = commands.capacity();
+        stats.cmd_queue_overflow = commands.overflowCount();
+        stats.cmd_dropped = cmd_dropped.load();
+        stats.cmd_rejected = cmd_rejected.load();
+        stats.tx_committed = tx_committed.load();
+        stats.cmd_applied = states.appliedCount() + geom_applied.load();
+        stats.cmd_coalesced = states.coalescedCount() + geom_coalesced.load();
+        stats.gl_calls = gl_issued.load();
+        stats.gl_calls_elided = gl_elided.load();
+        stats.draw_calls = draw_calls.load();
+        stats.draw_instances = draw_instances.load();
+        stats.frame_time_ms = frame_time.load();
+        stats.objects_visible = objs_visible.load();
+        stats.objects_culled = objs_culled.load();
+        stats.tree_rebuilds = tree_rebuilds.load();
+        stats.tree_cost = tree_cost.load();
+        stats.triangles_drawn = triangles_drawn.load();
+        stats.lod_error = lod_error.load();
+        stats.chunks_culled = chunks_culled.load();
+        stats.mesh_vertex_bytes = mesh_vertex_bytes.load();
+        stats.mesh_index_bytes = mesh_index_bytes.load();
+        stats.mesh_float_bytes = mesh_float_bytes.load();
+        stats.mesh_acmr_before = mesh_acmr_before.load();
+        stats.mesh_acmr_after = mesh_acmr_after.load();
+        stats.mesh_cpu_bytes = mesh_cpu_bytes.load();
+        stats.mesh_cache_hits = mesh_cache_hits.load();
+        stats.mesh_cache_misses = mesh_cache_misses.load();
+        stats.ring_uploads = Renderer::ringUploads();
+        stats.ring_reallocations = Renderer::ringReallocations();
+        stats.frame_waits = frame_waits.load();
+        std::unique_lock<std::mutex> lock(lod_mtx);
+        stats.lods = lod_stats;
+        return stats;
+    }
+
+    void setInstancing(bool instance) {
+        instancing.store(instance);
+    }
+
+    std::vector<int> raycast(const common::Vector3<float>& origin, const common::Vector3<float>& direction,
+                             float max_distance) {
+        std::vector<int> ids;
+        float length = direction.norm();
+        if (length <= 0) return ids;
+        std::vector<std::pair<float, int>> hits;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(tree_mtx);
+            scene_tree.queryRay(origin, direction / length, max_distance, hits);
+        }
+        ids.reserve(hits.size());
+        for (auto& hit : hits) ids.push_back(hit.second);
+        return ids;
+    }
+
+    std::vector<int> overlap(const common::Vector3<float>& min, const common::Vector3<float>& max) {
+        std::vector<int> ids;
+        std::shared_lock<std::shared_timed_mutex> lock(tree_mtx);
+        scene_tree.queryBox(min, max, ids);
+        return ids;
+    }
+
+    int nearest(const common::Vector3<float>& point, float max_distance, float* distance) {
+        std::shared_lock<std::shared_timed_mutex> lock(tree_mtx);
+        return scene_tree.queryNearest(point, max_distance, distance);
+    }
+
+    PickResult pick(int x, int y) {
+        PickResult result;
+        common::Matrix4<float> view_proj;
+        int width, height;
+        {
+            std::unique_lock<std::mutex> lock(pick_mtx);
+            view_proj = frame_view_proj;
+            width = frame_width;
+            height = frame_height;
+        }
+        if (width <= 0 || height <= 0) return result;
+
+        // ray through the pixel from the near to the far plane, t in [0, 1]
+        common::Matrix4<float> inv_view_proj = view_proj.inverse();
+        float nx = (x + 0.5f) * 2 / (float)width - 1, ny = 1 - (y + 0.5f) * 2 / (float)height;
+        common::Vector3<float> origin = unproject(inv_view_proj, nx, ny, -1);
+        common::Vector3<float> direction = unproject(inv_view_proj, nx, ny, 1) - origin;
+
+        // objects whose box is hit, copied so that the triangle tests run without the lock
+        std::vector<std::pair<float, PickEntry>> candidates;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(tree_mtx);
+            std::vector<std::pair<float, int>> hits;
+            scene_tree.queryRay(origin, direction, 1.f, hits);
+            candidates.reserve(hits.size());
+            for (auto& hit : hits) {
+                auto entry = pick_entries.at(SlotMap<Renderer*>::indexOf(hit.second));
+                if (entry != nullptr && entry->id == hit.second && entry->triangles) {
+                    candidates.emplace_back(hit.first, *entry);
+                }
+            }
+        }
+
+        // nearest triangle hit, in object space (the ray parameter is kept by the affine map)
+        float nearest = 1.f;
+        for (auto& candidate : candidates) {
+            if (candidate.first > nearest) break;
+            auto& entry = candidate.second;
+            if ((entry.scale.array() == 0).any()) continue;
+            auto inv_basis = entry.transform.getBasis().transpose();
+            common::Vector3<float> local_origin =
+                    (inv_basis * (origin - entry.transform.getOrigin())).cwiseQuotient(entry.scale);
+            common::Vector3<float> local_direction = (inv_basis * direction).cwiseQuotient(entry.scale);
+            TriangleTree::Hit hit;
+            if (entry.triangles->raycast(local_origin, local_direction, nearest, hit)) {
+                nearest = hit.t;
+                result.obj_id = entry.id;
+                result.triangle = hit.triangle;
+                result.point = origin + direction * hit.t;
+            }
+        }
+        return result;
+    }
+
+    PickResult pickBuffer(int x, int y) {
+        std::future<PickResult> future;
+        {
+            std::unique_lock<std::mutex> lock(pick_mtx);
+            if (frame_width <= 0 || frame_height <= 0) return PickResult();
+            pick_requests.push_back({ x, y, std::promise<PickResult>() });
+            future = pick_requests.back().result.get_future();
+        }
+        if (future.wait_for(std::chrono::seconds(1)) != std::future_status::ready) return PickResult();
+        return future.get();
+    }
+
 } // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+namespace simple_viewer {
+
+    /**
+     * @brief A fixed-capacity array allocated page by page
+     *
+     * Elements never move once their page exists, so they can be read by any
+     * thread without a lock while other threads grow the array.
+     */
+    template <typename T, int PageBits, uint32_t MaxSize>
+    class PagedArray {
+    public:
+        static const uint32_t PageSize = 1u << PageBits;
+        static const uint32_t PageCount = (MaxSize + PageSize - 1) >> PageBits;
+
+        PagedArray() {
+            for (auto& page : _pages) page.store(nullptr, std::memory_order_relaxed);
+        }
+        PagedArray(const PagedArray& other) = delete;
+        ~PagedArray() {
+            for (auto& page : _pages) delete[] page.load();
+        }
+
+        // nullptr if the page of i is not allocated yet
+        T* at(uint32_t i) const {
+            if (i >= MaxSize) return nullptr;
+            auto page = _pages[i >> PageBits].load(std::memory_order_acquire);
+            return page ? &page[i & (PageSize - 1)] : nullptr;
+        }
+
+        // allocate the page of i if needed
+        T& grow(uint32_t i) {
+            auto& page = _pages[i >> PageBits];
+            if (page.load(std::memory_order_acquire) == nullptr) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (page.load(std::memory_order_relaxed) == nullptr) {
+                    page.store(new T[PageSize](), std::memory_order_release);
+                }
+            }
+            return page.load(std::memory_order_acquire)[i & (PageSize - 1)];
+        }
+
+    private:
+        std::atomic<T*> _pages[PageCount];
+        std::mutex _mutex;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace simple_viewer {
+
+    void RenderQueue::push(Renderer* renderer, int id, RenderPass pass, Shading shading, float depth) {
+        // positive floats keep their order when compared as integers
+        unsigned int depth_bits = 0;
+        if (depth > 0) std::memcpy(&depth_bits, &depth, sizeof(float));
+        unsigned long long key =
+                ((unsigned long long)pass << 62) |
+                ((unsigned long long)shading << 60) |
+                ((unsigned long long)(renderer->vertexArray() & 0xfffffff) << 32) |
+                depth_bits;
+        _items.push_back({ key, renderer, id });
+    }
+
+    void RenderQueue::sort() {
+        std::sort(_items.begin(), _items.end(), [](const DrawItem& a, const DrawItem& b) {
+            return a.key < b.key;
+        });
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
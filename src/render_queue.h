@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include "renderer.h"
+
+namespace simple_viewer {
+
+    // draw pass, in drawing order
+    enum RenderPass {
+        P_OPAQUE = 0,       // filled triangles
+        P_LINE = 1,         // line (strips) objects
+        P_WIREFRAME = 2     // wireframe overlay of triangle objects
+    };
+
+    // lighting setup of a draw
+    enum Shading {
+        S_LIT = 0,          // ambient 0.5, diffuse 0.8
+        S_UNLIT = 1         // ambient 1.0, no diffuse
+    };
+
+    // one draw of the frame
+    struct DrawItem {
+        unsigned long long key;
+        Renderer* renderer;
+        int id;
+    };
+
+    /**
+     * @brief Per-frame list of draws, sorted so that consecutive draws share
+     * as much gl state as possible
+     *
+     * Sort key, from the highest bits: pass (2) | shading (2) | geometry (28) |
+     * view depth (32), so draws are grouped by pass, then by shader state, then
+     * by vertex array, and issued front-to-back inside a group for early-z.
+     */
+    class RenderQueue {
+    public:
+        void clear() { _items.clear(); }
+        void push(Renderer* renderer, int id, RenderPass pass, Shading shading, float depth);
+        void sort();
+
+        const std::vector<DrawItem>& items() const { return _items; }
+
+        static RenderPass passOf(unsigned long long key) { return (RenderPass)(key >> 62); }
+        static Shading shadingOf(unsigned long long key) { return (Shading)((key >> 60) & 3); }
+
+    private:
+        std::vector<DrawItem> _items;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
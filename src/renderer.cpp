@@ -1,27 +1,83 @@
 #include "renderer.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <GL/glew.h>
 #include "default_mesh.h"
+#include "mesh_simplifier.h"
+#include "vertex_cache.h"
+#include "worker_pool.h"
 
 namespace simple_viewer {
 
+    // unit geometry shared by the primitives of one type, render thread only
+    struct SharedGeometry {
+        unsigned int VAO, VBO, EBO;
+        unsigned long long vertex_count, triangle_count;
+        int users;
+    };
+    static SharedGeometry shared_geometries[RenderType::R_SPHERE + 1] = {};
+    static std::atomic<unsigned long long> ring_uploads(0), ring_reallocations(0);
+
+    static Bounds meshBounds(const common::Mesh<float>& mesh) {
+        if (mesh.vertices.empty()) return Bounds();
+        return Bounds::fromVertices(mesh.vertices[0].position.data(), mesh.vertices.size(),
+                                    sizeof(common::Mesh<float>::Vertex) / sizeof(float));
+    }
+
     Renderer::Renderer():
             VAO(0), VBO(0), EBO(0),
             _vertex_count(0), _vertices(nullptr),
             _triangle_count(0), _indices(nullptr),
-            _inited(false), _dynamic(false),
+            _ring_vertex_partition(0), _ring_index_partition(0), _ring_vertex_capacity(0), _ring_index_capacity(0),
+            _ring_base_vertex(0), _ring_index_offset(0), _geometry_released(false),
+            _readback_buffers{0, 0}, _readback_fence(nullptr),
+            _inited(false), _dynamic(false), _visible(true),
             _transform(common::Transform<float>::identity()),
-            _color({1, 1, 1}) {}
+            _color({1, 1, 1}), _scale(common::Vector3<float>::Ones()),
+            _position_offset(common::Vector3<float>::Zero()), _position_scale(common::Vector3<float>::Ones()),
+            _bounds_changed(true), _tree_leaf(-1), _memory_policy(C_KEEP) {}
+
+    void Renderer::setTransform(const common::Transform<float>& transform) {
+        _transform = transform;
+        updateBounds();
+    }
+
+    void Renderer::updateBounds() {
+        _bounds = _local_bounds.transformed(_transform, _scale);
+        _bounds_changed = true;
+    }
 
     Renderer::~Renderer() {
         deinit(); // NOLINT
-        delete[] _vertices;
-        delete[] _indices;
+        clearGeometry();
+    }
+
+    void Renderer::clearGeometry() {
+        delete[] _vertices; _vertices = nullptr;
+        delete[] _indices; _indices = nullptr;
     }
 
     void Renderer::init(int VAP_position, int VAP_normal) {
         if (_inited) return;
-        auto draw_mode = _dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+        if (_pending) {
+            _pending();
+            _pending = nullptr;
+        }
+        if (_geometry_released) {
+            // back from the cache, or nothing left to draw if it was lost
+            std::vector<unsigned char> vertices, indices;
+            if (!_geometry_cache || !_geometry_cache->load(vertices, indices)) {
+                vertices.clear();
+                indices.clear();
+                _vertex_count = _triangle_count = 0;
+            }
+            restoreGeometry(vertices, indices);
+            _geometry_cache = nullptr;
+            _geometry_released = false;
+        }
         if (VAO == 0) {
             glGenVertexArrays(1, &VAO);
             glGenBuffers(1, &VBO);
@@ -30,33 +86,211 @@ namespace simple_viewer {
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizei)(sizeof(float) * 6 * _vertex_count), _vertices, draw_mode);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (ringBuffered()) {
+            uploadRing();
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertexStride() * _vertex_count), vertexData(), GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indexSize() * indexCount()), indexData(),
+                         GL_STATIC_DRAW);
+            if (_memory_policy != C_KEEP) {
+                releaseGeometry();
+                _geometry_released = true;
+            }
+        }
+        setAttributes(VAP_position, VAP_normal);
+        glBindVertexArray(0);
+        _inited = true;
+    }
+
+    void Renderer::releaseGeometry() {
+        clearGeometry();
+    }
+
+    void Renderer::restoreGeometry(const std::vector<unsigned char>& vertices,
+                                   const std::vector<unsigned char>& indices) {
+        clearGeometry();
+        _vertices = new float[vertices.size() / sizeof(float)];
+        std::memcpy(_vertices, vertices.data(), vertices.size());
+        _indices = new unsigned int[indices.size() / sizeof(unsigned int)];
+        std::memcpy(_indices, indices.data(), indices.size());
+    }
+
+    void Renderer::readGeometry(std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices) const {
+        vertices.resize(vertexStride() * _vertex_count);
+        indices.resize(indexSize() * (_triangle_count * 3));
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)vertices.size(), vertices.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)indices.size(), indices.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    bool Renderer::readGeometryAsync(std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices) {
+        GLsizeiptr sizes[2] = { (GLsizeiptr)(vertexStride() * _vertex_count),
+                                (GLsizeiptr)(indexSize() * (_triangle_count * 3)) };
+        if (_readback_fence == nullptr) {
+            if (VAO == 0) return false;
+            unsigned int sources[2] = { VBO, EBO };
+            glGenBuffers(2, _readback_buffers);
+            for (int i = 0; i < 2; i++) {
+                glBindBuffer(GL_COPY_READ_BUFFER, sources[i]);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, _readback_buffers[i]);
+                glBufferData(GL_COPY_WRITE_BUFFER, sizes[i], nullptr, GL_STREAM_READ);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizes[i]);
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            _readback_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            return false;
+        }
+        auto status = glClientWaitSync((GLsync)_readback_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+        std::vector<unsigned char>* outs[2] = { &vertices, &indices };
+        for (int i = 0; i < 2; i++) {
+            outs[i]->resize((size_t)sizes[i]);
+            if (sizes[i] == 0) continue;
+            glBindBuffer(GL_COPY_READ_BUFFER, _readback_buffers[i]);
+            auto* data = glMapBufferRange(GL_COPY_READ_BUFFER, 0, sizes[i], GL_MAP_READ_BIT);
+            if (data != nullptr) std::memcpy(outs[i]->data(), data, (size_t)sizes[i]);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        cancelReadback();
+        return true;
+    }
+
+    void Renderer::cancelReadback() {
+        if (_readback_fence == nullptr) return;
+        glDeleteSync((GLsync)_readback_fence);
+        glDeleteBuffers(2, _readback_buffers);
+        _readback_fence = nullptr;
+        _readback_buffers[0] = _readback_buffers[1] = 0;
+    }
+
+    void Renderer::cacheGeometry() {
+        if (!_geometry_released || VAO == 0 || _geometry_cache) return;
+        std::vector<unsigned char> vertices, indices;
+        readGeometry(vertices, indices);
+        _geometry_cache.reset(new GeometryCache(_memory_policy, std::move(vertices), vertexStride(),
+                                                vertexElementSize(), std::move(indices), indexSize()));
+    }
+
+    void Renderer::setAttributes(int VAP_position, int VAP_normal) {
         glEnableVertexAttribArray(VAP_position);
         glEnableVertexAttribArray(VAP_normal);
         glVertexAttribPointer(VAP_position, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void*)0); // NOLINT
         glVertexAttribPointer(VAP_normal, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void *)(sizeof(float) * 3));
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizei)(sizeof(unsigned int) * 3 * _triangle_count), _indices, draw_mode);
-        glBindVertexArray(0);
-        _inited = true;
+    }
+
+    // copy into a range of the bound buffer the gpu is known not to read, without waiting for it
+    static void writeRange(GLenum target, unsigned long long offset, unsigned long long bytes, const void* data) {
+        if (bytes == 0) return;
+        void* dst = glMapBufferRange(target, (GLintptr)offset, (GLsizeiptr)bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst == nullptr) {
+            glBufferSubData(target, (GLintptr)offset, (GLsizeiptr)bytes, data);
+            return;
+        }
+        std::memcpy(dst, data, bytes);
+        glUnmapBuffer(target);
+    }
+
+    // a partition size holding bytes with room to grow, in whole elements
+    static unsigned long long ringCapacity(unsigned long long bytes, size_t element) {
+        unsigned long long elements = (bytes + element - 1) / element;
+        return (elements + elements / 2 + 1) * element;
+    }
+
+    // move to the next partition of a ring, reallocating it first if bytes do not fit, and return its offset
+    static unsigned long long nextPartition(GLenum target, unsigned long long bytes, size_t element,
+                                            unsigned long long& capacity, int& partition) {
+        if (bytes > capacity) {
+            capacity = std::max(capacity, ringCapacity(bytes, element));
+            glBufferData(target, (GLsizeiptr)(capacity * Renderer::RingPartitions), nullptr, GL_DYNAMIC_DRAW);
+            partition = 0;
+            ring_reallocations++;
+        } else {
+            partition = (partition + 1) % Renderer::RingPartitions;
+        }
+        return partition * capacity;
+    }
+
+    // the rings of vertices and indices move on their own, each at most once per frame
+    void Renderer::uploadRing(bool indices) {
+        unsigned long long vertex_bytes = vertexStride() * _vertex_count;
+        auto offset = nextPartition(GL_ARRAY_BUFFER, vertex_bytes, vertexStride(),
+                                    _ring_vertex_capacity, _ring_vertex_partition);
+        writeRange(GL_ARRAY_BUFFER, offset, vertex_bytes, vertexData());
+        _ring_base_vertex = offset / vertexStride();
+        if (indices) {
+            unsigned long long index_bytes = indexSize() * indexCount();
+            _ring_index_offset = nextPartition(GL_ELEMENT_ARRAY_BUFFER, index_bytes, indexSize(),
+                                               _ring_index_capacity, _ring_index_partition);
+            writeRange(GL_ELEMENT_ARRAY_BUFFER, _ring_index_offset, index_bytes, indexData());
+        }
+        ring_uploads++;
+    }
+
+    void Renderer::uploadRingVertices(unsigned long long first, unsigned long long count) {
+        size_t stride = vertexStride();
+        unsigned long long vertex_bytes = stride * _vertex_count;
+        if (count * 2 > _vertex_count || vertex_bytes > _ring_vertex_capacity) {
+            uploadRing(false);
+            return;
+        }
+        // copy the current partition over on the gpu, then patch the changed range, both ordered in the stream
+        unsigned long long from = _ring_vertex_partition * _ring_vertex_capacity;
+        _ring_vertex_partition = (_ring_vertex_partition + 1) % RingPartitions;
+        unsigned long long to = _ring_vertex_partition * _ring_vertex_capacity;
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)from, (GLintptr)to,
+                            (GLsizeiptr)vertex_bytes);
+        if (count > 0) {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(to + first * stride), (GLsizeiptr)(count * stride),
+                            static_cast<const char*>(vertexData()) + first * stride);
+        }
+        _ring_base_vertex = to / stride;
+        ring_uploads++;
+    }
+
+    unsigned long long Renderer::ringUploads() {
+        return ring_uploads.load();
+    }
+
+    unsigned long long Renderer::ringReallocations() {
+        return ring_reallocations.load();
+    }
+
+    int Renderer::draw(int instance_count) const {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)(_triangle_count * 3), GL_UNSIGNED_INT,
+                                          (void*)_ring_index_offset, // NOLINT
+                                          instance_count, (GLint)_ring_base_vertex);
+        return 1;
     }
 
     void Renderer::deinit() {
+        cancelReadback();
         if (VAO == 0) return;
         glDeleteVertexArrays(1, &VAO); VAO = 0;
         glDeleteBuffers(1, &VBO); VBO = 0;
         glDeleteBuffers(1, &EBO); EBO = 0;
+        _ring_vertex_partition = _ring_index_partition = 0;
+        _ring_vertex_capacity = _ring_index_capacity = 0;
+        _ring_base_vertex = _ring_index_offset = 0;
         _inited = false;
     }
 
-    void MeshRenderer::loadMesh(const common::Mesh<float>& mesh) {
-        // load vertex data
-        _vertex_count = mesh.vertices.size();
+    void Renderer::loadVertices(const std::vector<common::Mesh<float>::Vertex>& vertices) {
+        clearGeometry();
+        _vertex_count = vertices.size();
         _vertices = new float[_vertex_count * 6];
-        int i = 0;
-        for (unsigned int j = 0; j < _vertex_count; j++) {
-            auto& v = mesh.vertices[j].position;
-            auto& n = mesh.vertices[j].normal;
+        size_t i = 0;
+        for (size_t j = 0; j < _vertex_count; j++) {
+            auto& v = vertices[j].position;
+            auto& n = vertices[j].normal;
             _vertices[i++] = v.x();
             _vertices[i++] = v.y();
             _vertices[i++] = v.z();
@@ -64,6 +298,11 @@ namespace simple_viewer {
             _vertices[i++] = n.y();
             _vertices[i++] = n.z();
         }
+    }
+
+    void Renderer::loadMesh(const common::Mesh<float>& mesh) {
+        // load vertex data
+        loadVertices(mesh.vertices);
 
         // load face data, and transform into triangles
         _triangle_count = 0;
@@ -71,7 +310,7 @@ namespace simple_viewer {
             _triangle_count += f.indices.size() - 2;
         }
         _indices = new unsigned int[_triangle_count * 3];
-        unsigned long long n; i = 0;
+        unsigned long long n; size_t i = 0;
         for (auto& f : mesh.faces) {
             n = f.indices.size();
             for (unsigned int j = 1; j < n - 1; j++) {
@@ -80,280 +319,1022 @@ namespace simple_viewer {
                 _indices[i++] = f.indices[j + 1];
             }
         }
+        _local_bounds = Bounds::fromVertices(_vertices, _vertex_count, 6);
+        updateBounds();
     }
 
-    MeshRenderer::MeshRenderer(const common::Mesh<float>& mesh, bool dynamic):
-        Renderer() {
-        loadMesh(mesh);
-        _dynamic = dynamic;
-        _color = {0.3f, 0.25f, 0.8f};
+    void Renderer::loadMesh(const common::PolygonMesh<float>& mesh) {
+        loadVertices(mesh.vertices);
+        _triangle_count = mesh.triangleCount();
+        _indices = new unsigned int[_triangle_count * 3];
+        if (mesh.isTriangles()) {
+            std::copy(mesh.indices.begin(), mesh.indices.begin() + _triangle_count * 3, _indices);
+        } else {
+            // the same fans as the faces of a mesh
+            size_t i = 0;
+            for (size_t f = 0; f < mesh.faceCount(); f++) {
+                const uint32_t* corners = mesh.face(f);
+                size_t n = mesh.faceSize(f);
+                for (size_t j = 1; j + 1 < n; j++) {
+                    _indices[i++] = corners[0];
+                    _indices[i++] = corners[j];
+                    _indices[i++] = corners[j + 1];
+                }
+            }
+        }
+        _local_bounds = Bounds::fromVertices(_vertices, _vertex_count, 6);
+        updateBounds();
     }
 
-    void MeshRenderer::render(bool line) {
-        if (!_inited) return;
-        glBindVertexArray(VAO);
-        if (line) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    void MeshRenderer::loadTriangles() {
+        _pick_tree = std::make_shared<TriangleTree>(_vertices, _vertex_count, 6, _indices, _triangle_count);
+        _triangles = _pick_tree;
+    }
+
+    void MeshRenderer::loadChunks() {
+        // triangle centers, times 3
+        std::vector<float> centers(_triangle_count * 3);
+        _chunk_triangles.resize(_triangle_count);
+        for (unsigned long long t = 0; t < _triangle_count; t++) {
+            for (int k = 0; k < 3; k++) {
+                const float* p = &_vertices[(size_t)_indices[t * 3 + k] * 6];
+                for (int axis = 0; axis < 3; axis++) centers[t * 3 + axis] += p[axis];
+            }
+            _chunk_triangles[t] = (unsigned int)t;
+        }
+
+        // split the triangles at the median center along the longest axis, until the vertices of
+        // every part fit in 16 bit indices. The first half is split first, so the parts stay in order
+        std::vector<unsigned int> stamps(_vertex_count, 0);
+        unsigned int stamp = 0;
+        std::vector<std::pair<size_t, size_t>> ranges, stack;
+        if (_triangle_count > 0) stack.emplace_back(0, _triangle_count);
+        while (!stack.empty()) {
+            auto range = stack.back();
+            stack.pop_back();
+            stamp++;
+            size_t unique = 0;
+            common::Vector3<float> min = common::Vector3<float>::Constant(std::numeric_limits<float>::max());
+            common::Vector3<float> max = -min;
+            for (size_t i = range.first; i < range.second; i++) {
+                size_t t = _chunk_triangles[i];
+                for (int k = 0; k < 3; k++) {
+                    auto v = _indices[t * 3 + k];
+                    if (stamps[v] != stamp) {
+                        stamps[v] = stamp;
+                        unique++;
+                    }
+                }
+                Eigen::Map<const common::Vector3<float>> center(&centers[t * 3]);
+                min = min.cwiseMin(center);
+                max = max.cwiseMax(center);
+            }
+            if (unique <= MaxChunkVertices) {
+                ranges.push_back(range);
+                continue;
+            }
+            int axis;
+            (max - min).maxCoeff(&axis);
+            size_t middle = (range.first + range.second) / 2;
+            std::nth_element(_chunk_triangles.begin() + range.first, _chunk_triangles.begin() + middle,
+                             _chunk_triangles.begin() + range.second, [&](unsigned int a, unsigned int b) {
+                return centers[a * 3 + axis] < centers[b * 3 + axis];
+            });
+            stack.emplace_back(middle, range.second);
+            stack.emplace_back(range.first, middle);
+        }
+
+        // vertices of every chunk in the order they are first used, shared ones being copied. The
+        // triangles are first reordered for the vertex cache, so the vertices are fetched in order too
+        _acmr_before = VertexCache::acmr(_indices, _triangle_count, _vertex_count);
+        float misses = 0;
+        std::vector<float> vertices;
+        vertices.reserve(_vertex_count * 6);
+        std::vector<unsigned int> local(_vertex_count), chunk_vertices, local_indices;
+        _vertex_sources.clear();
+        _chunks.clear();
+        _chunk_indices.clear();
+        _chunk_indices.reserve(_triangle_count * 3);
+        for (auto& range : ranges) {
+            stamp++;
+            Chunk chunk;
+            chunk.base_vertex = vertices.size() / 6;
+            chunk.first_triangle = range.first;
+            chunk.triangle_count = range.second - range.first;
+            chunk_vertices.clear();
+            local_indices.clear();
+            for (size_t i = range.first; i < range.second; i++) {
+                for (int k = 0; k < 3; k++) {
+                    size_t v = _indices[(size_t)_chunk_triangles[i] * 3 + k];
+                    if (stamps[v] != stamp) {
+                        stamps[v] = stamp;
+                        local[v] = (unsigned int)chunk_vertices.size();
+                        chunk_vertices.push_back((unsigned int)v);
+                    }
+                    local_indices.push_back(local[v]);
+                }
+            }
+            if (_optimize_vertex_cache) {
+                auto order = VertexCache::optimize(local_indices.data(), chunk.triangle_count, chunk_vertices.size());
+                std::vector<unsigned int> triangles(chunk.triangle_count), indices(local_indices.size());
+                for (size_t i = 0; i < order.size(); i++) {
+                    triangles[i] = _chunk_triangles[range.first + order[i]];
+                    std::copy(&local_indices[order[i] * 3], &local_indices[order[i] * 3] + 3, &indices[i * 3]);
+                }
+                std::copy(triangles.begin(), triangles.end(), _chunk_triangles.begin() + range.first);
+                // renumber the vertices in the order the triangles now use them
+                std::vector<unsigned int> fetched(chunk_vertices.size(), (unsigned int)-1), fetch_order;
+                fetch_order.reserve(chunk_vertices.size());
+                for (auto& index : indices) {
+                    if (fetched[index] == (unsigned int)-1) {
+                        fetched[index] = (unsigned int)fetch_order.size();
+                        fetch_order.push_back(chunk_vertices[index]);
+                    }
+                    index = fetched[index];
+                }
+                chunk_vertices.swap(fetch_order);
+                local_indices.swap(indices);
+            }
+            misses += VertexCache::acmr(local_indices.data(), chunk.triangle_count, chunk_vertices.size()) *
+                      (float)chunk.triangle_count;
+            for (auto v : chunk_vertices) {
+                vertices.insert(vertices.end(), &_vertices[(size_t)v * 6], &_vertices[(size_t)v * 6] + 6);
+            }
+            if (_dynamic) _vertex_sources.insert(_vertex_sources.end(), chunk_vertices.begin(), chunk_vertices.end());
+            _chunk_indices.insert(_chunk_indices.end(), local_indices.begin(), local_indices.end());
+            chunk.vertex_count = chunk_vertices.size();
+            chunk.bounds = Bounds::fromVertices(&vertices[chunk.base_vertex * 6], chunk.vertex_count, 6);
+            _chunks.push_back(std::move(chunk));
+        }
+        _acmr_after = _triangle_count > 0 ? misses / (float)_triangle_count : 0;
+
+        // the copies of every vertex, for updating them in place
+        _vertex_copy_offsets.assign(_dynamic ? _vertex_count + 1 : 0, 0);
+        _vertex_copies.resize(_vertex_sources.size());
+        for (auto v : _vertex_sources) _vertex_copy_offsets[v + 1]++;
+        for (size_t v = 1; v < _vertex_copy_offsets.size(); v++) {
+            _vertex_copy_offsets[v] += _vertex_copy_offsets[v - 1];
+        }
+        std::vector<unsigned int> cursors(_vertex_copy_offsets.begin(),
+                                          _vertex_copy_offsets.end() - (_dynamic ? 1 : 0));
+        for (size_t u = 0; u < _vertex_sources.size(); u++) {
+            _vertex_copies[cursors[_vertex_sources[u]]++] = (unsigned int)u;
+        }
+
+        clearGeometry();
+        _vertex_count = vertices.size() / 6;
+        if (_vertex_format == V_FLOAT) {
+            _vertices = new float[vertices.size()];
+            std::copy(vertices.begin(), vertices.end(), _vertices);
         } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            packVertices(vertices);
         }
-        glDrawElements(GL_TRIANGLES, (GLsizei)(_triangle_count * 3),
-                       GL_UNSIGNED_INT, (void*)0); // NOLINT
-        glBindVertexArray(0);
     }
 
-    bool MeshRenderer::updateMesh(const common::Mesh<float>& mesh) {
-        if (!_dynamic) return false;
-        loadMesh(mesh);
-        _inited = false;
-        return true;
+    // a unit normal in octahedral coordinates, both in [-1, 1]
+    static void encodeOctahedral(const common::Vector3<float>& n, float& x, float& y) {
+        float l1 = std::abs(n.x()) + std::abs(n.y()) + std::abs(n.z());
+        x = l1 > 0 ? n.x() / l1 : 0;
+        y = l1 > 0 ? n.y() / l1 : 0;
+        if (n.z() < 0) {
+            float folded_x = (1 - std::abs(y)) * (x >= 0 ? 1.f : -1.f);
+            y = (1 - std::abs(x)) * (y >= 0 ? 1.f : -1.f);
+            x = folded_x;
+        }
     }
 
-    void CubeRenderer::loadCube(const common::Vector3<float> &size) {
-        // load vertex data
-        _vertex_count = _cube_mesh.vertices.size();
-        _vertices = new float[_vertex_count * 6];
-        int i = 0;
-        for (unsigned int j = 0; j < _vertex_count; j++) {
-            auto& v = _cube_mesh.vertices[j].position;
-            auto& n = _cube_mesh.vertices[j].normal;
-            _vertices[i++] = (v.x() * size.x());
-            _vertices[i++] = (v.y() * size.y());
-            _vertices[i++] = (v.z() * size.z());
-            _vertices[i++] = (n.x());
-            _vertices[i++] = (n.y());
-            _vertices[i++] = (n.z());
+    static size_t layoutStride(int vertex_format) {
+        switch (vertex_format) {
+            case V_COMPACT: return 12;
+            case V_COMPACT_SMALL: return 8;
+            default: return sizeof(float) * 6;
         }
+    }
 
-        // load face data, and transform into triangles
-        _triangle_count = 0;
-        for (auto& f : _cube_mesh.faces) {
-            _triangle_count += f.indices.size() - 2;
+    // the position of a vertex in one of the VertexLayout, in the geometry space
+    static common::Vector3<float> decodePosition(const unsigned char* vertex, int vertex_format,
+                                                 const common::Vector3<float>& offset,
+                                                 const common::Vector3<float>& scale) {
+        if (vertex_format == V_FLOAT) return Eigen::Map<const common::Vector3<float>>((const float*)vertex);
+        auto* position = reinterpret_cast<const unsigned short*>(vertex);
+        common::Vector3<float> q(position[0], position[1], position[2]);
+        return offset + scale.cwiseProduct(q / 65535.f);
+    }
+
+    void MeshRenderer::packVertices(const std::vector<float>& vertices) {
+        // quantize within the bounds of the mesh, whose largest side the shader gets as a scale. The
+        // same on every axis, as the normals are divided by the scale and would lose precision otherwise
+        float extent = (_local_bounds.max - _local_bounds.min).maxCoeff();
+        if (extent <= 0) extent = 1;
+        _position_offset = _local_bounds.min;
+        _position_scale = common::Vector3<float>::Constant(extent);
+
+        _packed_vertices.assign(vertexStride() * _vertex_count, 0);
+        for (unsigned long long v = 0; v < _vertex_count; v++) {
+            packPosition(v, &vertices[v * 6]);
+            packNormal(v, &vertices[v * 6 + 3]);
         }
-        _indices = new unsigned int[_triangle_count * 3];
-        unsigned long long n; i = 0;
-        for (auto& f : _cube_mesh.faces) {
-            n = f.indices.size();
-            for (unsigned int j = 1; j < n - 1; j++) {
-                _indices[i++] = f.indices[0];
-                _indices[i++] = f.indices[j];
-                _indices[i++] = f.indices[j + 1];
-            }
+    }
+
+    void MeshRenderer::packPosition(unsigned long long vertex, const float* position) {
+        if (_vertex_format == V_FLOAT) {
+            std::copy(position, position + 3, &_vertices[vertex * 6]);
+            return;
+        }
+        auto* packed = reinterpret_cast<unsigned short*>(&_packed_vertices[vertex * vertexStride()]);
+        common::Vector3<float> q = (Eigen::Map<const common::Vector3<float>>(position) - _position_offset)
+                .cwiseQuotient(_position_scale) * 65535.f;
+        for (int i = 0; i < 3; i++) {
+            packed[i] = (unsigned short)std::lround(std::max(0.f, std::min(q[i], 65535.f)));
         }
     }
 
-    CubeRenderer::CubeRenderer(const common::Vector3<float> &size, bool dynamic) {
-        loadCube(size);
-        _dynamic = dynamic;
-        _color = {0.3f, 0.25f, 0.8f};
+    void MeshRenderer::packNormal(unsigned long long vertex, const float* normal) {
+        if (_vertex_format == V_FLOAT) {
+            std::copy(normal, normal + 3, &_vertices[vertex * 6 + 3]);
+            return;
+        }
+        float x, y;
+        encodeOctahedral(Eigen::Map<const common::Vector3<float>>(normal), x, y);
+        if (_vertex_format == V_COMPACT) {
+            auto* packed = reinterpret_cast<short*>(&_packed_vertices[vertex * vertexStride() + 8]);
+            packed[0] = (short)std::lround(x * 32767);
+            packed[1] = (short)std::lround(y * 32767);
+        } else {
+            // 2..254 per axis, so the packed value is neither 0 nor 65535
+            auto* packed = reinterpret_cast<unsigned short*>(&_packed_vertices[vertex * vertexStride()]);
+            packed[3] = (unsigned short)((std::lround(x * 126) + 128) | ((std::lround(y * 126) + 128) << 8));
+        }
     }
 
-    void CubeRenderer::render(bool line) {
-        if (!_inited) return;
-        glBindVertexArray(VAO);
-        if (line) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    size_t MeshRenderer::vertexStride() const {
+        return layoutStride(_vertex_format);
+    }
+
+    common::Vector3<float> MeshRenderer::vertexPosition(unsigned long long vertex) const {
+        auto* data = static_cast<const unsigned char*>(vertexData());
+        return decodePosition(data + vertex * vertexStride(), _vertex_format, _position_offset, _position_scale);
+    }
+
+    const void* MeshRenderer::vertexData() const {
+        if (_mapped.owner) return _mapped.vertices;
+        return _vertex_format == V_FLOAT ? (const void*)_vertices : _packed_vertices.data();
+    }
+
+    unsigned long long MeshRenderer::indexCount() const {
+        return _mapped.owner ? _mapped.index_count : _chunk_indices.size();
+    }
+
+    const void* MeshRenderer::indexData() const {
+        return _mapped.owner ? (const void*)_mapped.indices : _chunk_indices.data();
+    }
+
+    void MeshRenderer::releaseGeometry() {
+        Renderer::releaseGeometry();
+        std::vector<unsigned char>().swap(_packed_vertices);
+        std::vector<unsigned short>().swap(_chunk_indices);
+        _mapped = MeshCache::Geometry();
+    }
+
+    void MeshRenderer::restoreGeometry(const std::vector<unsigned char>& vertices,
+                                       const std::vector<unsigned char>& indices) {
+        clearGeometry();
+        _mapped = MeshCache::Geometry();
+        if (_vertex_format == V_FLOAT) {
+            _vertices = new float[vertices.size() / sizeof(float)];
+            std::memcpy(_vertices, vertices.data(), vertices.size());
         } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            _packed_vertices = vertices;
         }
-        glDrawElements(GL_TRIANGLES, (GLsizei)(_triangle_count * 3),
-                       GL_UNSIGNED_INT, (void*)0); // NOLINT
-        glBindVertexArray(0);
+        _chunk_indices.resize(indices.size() / sizeof(unsigned short));
+        std::memcpy(_chunk_indices.data(), indices.data(), indices.size());
+        if (indices.empty()) _chunks.clear();
     }
 
-    bool CubeRenderer::updateCube(const common::Vector3<float> &size) {
-        if (!_dynamic) return false;
-        loadCube(size);
-        _inited = false;
-        return true;
+    unsigned long long MeshRenderer::cpuBytes() const {
+        unsigned long long bytes = _packed_vertices.size() + sizeof(unsigned short) * _chunk_indices.size();
+        // mapped pages may be dropped by the system, but count as held
+        if (_mapped.owner) bytes += vertexBytes() + sizeof(unsigned short) * _mapped.index_count;
+        if (_vertices != nullptr) bytes += sizeof(float) * 6 * _vertex_count;
+        if (_geometry_cache) bytes += _geometry_cache->residentBytes();
+        if (_pick_tree) bytes += _pick_tree->residentBytes();
+        return bytes;
     }
 
-    void CylinderRenderer::loadCylinder(float radius, float height) {
-        // load vertex data
-        radius *= 2;
-        _vertex_count = _cylinder_mesh.vertices.size();
-        _vertices = new float[_vertex_count * 6];
-        int i = 0;
-        for (unsigned int j = 0; j < _vertex_count; j++) {
-            auto& v = _cylinder_mesh.vertices[j].position;
-            auto& n = _cylinder_mesh.vertices[j].normal;
-            _vertices[i++] = (v.x() * radius);
-            _vertices[i++] = (v.y() * height);
-            _vertices[i++] = (v.z() * radius);
-            _vertices[i++] = (n.x());
-            _vertices[i++] = (n.y());
-            _vertices[i++] = (n.z());
+    void MeshRenderer::setAttributes(int VAP_position, int VAP_normal) {
+        if (_vertex_format == V_FLOAT) {
+            Renderer::setAttributes(VAP_position, VAP_normal);
+            return;
+        }
+        auto stride = (GLsizei)vertexStride();
+        glEnableVertexAttribArray(VAP_position);
+        glVertexAttribPointer(VAP_position, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0); // NOLINT
+        if (_vertex_format == V_COMPACT) {
+            glEnableVertexAttribArray(VAP_normal);
+            glVertexAttribPointer(VAP_normal, 2, GL_SHORT, GL_TRUE, stride, (void*)8); // NOLINT
+        } else {
+            glDisableVertexAttribArray(VAP_normal);
         }
+    }
 
-        // load face data, and transform into triangles
-        _triangle_count = 0;
-        for (auto& f : _cylinder_mesh.faces) {
-            _triangle_count += f.indices.size() - 2;
+    struct SimplifiedLevel {
+        std::vector<unsigned short> indices;
+        float error;
+    };
+
+    // levels of every chunk, built by a worker, which owns it until done is set
+    struct MeshRenderer::LodBuild {
+        std::atomic<bool> done{false};
+        std::atomic<bool> cancelled{false};
+        std::vector<std::vector<SimplifiedLevel>> levels;
+    };
+
+    // positions of the vertices of every chunk, and its local indices, for simplifying it
+    template<typename ChunkType>
+    static void chunkGeometry(const ChunkType* chunks, size_t chunk_count, const unsigned char* vertices,
+                              int vertex_format, const common::Vector3<float>& offset,
+                              const common::Vector3<float>& scale, const unsigned short* indices,
+                              std::vector<std::vector<float>>& positions,
+                              std::vector<std::vector<unsigned int>>& chunk_indices) {
+        size_t stride = layoutStride(vertex_format);
+        positions.resize(chunk_count);
+        chunk_indices.resize(chunk_count);
+        for (size_t c = 0; c < chunk_count; c++) {
+            auto& chunk = chunks[c];
+            positions[c].resize(chunk.vertex_count * 3);
+            for (unsigned long long v = 0; v < chunk.vertex_count; v++) {
+                auto p = decodePosition(vertices + (chunk.base_vertex + v) * stride, vertex_format, offset, scale);
+                std::copy(p.data(), p.data() + 3, &positions[c][v * 3]);
+            }
+            chunk_indices[c].assign(indices + chunk.first_triangle * 3,
+                                    indices + (chunk.first_triangle + chunk.triangle_count) * 3);
         }
-        _indices = new unsigned int[_triangle_count * 3];
-        unsigned long long n; i = 0;
-        for (auto& f : _cylinder_mesh.faces) {
-            n = f.indices.size();
-            for (unsigned int j = 1; j < n - 1; j++) {
-                _indices[i++] = f.indices[0];
-                _indices[i++] = f.indices[j];
-                _indices[i++] = f.indices[j + 1];
+    }
+
+    // the chain of levels of every chunk, each half the triangles of the one before, until cancelled
+    static void simplifyChunks(const std::vector<std::vector<float>>& positions,
+                               const std::vector<std::vector<unsigned int>>& indices, bool optimize,
+                               const std::atomic<bool>& cancelled, std::vector<std::vector<SimplifiedLevel>>& levels) {
+        levels.resize(positions.size());
+        for (size_t c = 0; c < positions.size() && !cancelled; c++) {
+            MeshSimplifier simplifier(positions[c].data(), positions[c].size() / 3, 3,
+                                      indices[c].data(), indices[c].size() / 3);
+            size_t count = indices[c].size() / 3;
+            while (levels[c].size() + 1 < (size_t)MeshRenderer::MaxLodLevels && !cancelled) {
+                auto level = simplifier.simplify(count / 2, std::numeric_limits<float>::max());
+                // stop once the borders, which are kept, are most of what is left
+                if (level.indices.size() / 3 > count * 3 / 4) break;
+                count = level.indices.size() / 3;
+                std::vector<unsigned short> level_indices(level.indices.begin(), level.indices.end());
+                if (optimize) {
+                    auto order = VertexCache::optimize(level.indices.data(), count, positions[c].size() / 3);
+                    for (size_t t = 0; t < order.size(); t++) {
+                        auto first = level.indices.begin() + order[t] * 3;
+                        std::copy(first, first + 3, level_indices.begin() + t * 3);
+                    }
+                }
+                levels[c].push_back({ std::move(level_indices), level.error });
             }
         }
     }
 
-    CylinderRenderer::CylinderRenderer(float radius, float height, bool dynamic) {
-        loadCylinder(radius, height);
+    // the levels of every chunk appended to a geometry without any, in the layout updateLods() uploads: the chunks,
+    // then the levels of each in turn
+    static void appendLevels(MeshCache::Geometry& geometry, const std::vector<std::vector<SimplifiedLevel>>& levels) {
+        auto& g = geometry;
+        if (g.lod_count > 0 || g.chunk_count == 0 || levels.size() != g.chunk_count) return;
+        struct Arrays {
+            std::vector<MeshCache::ChunkRecord> chunks;
+            std::vector<MeshCache::LodRecord> lods;
+            std::vector<uint16_t> indices;
+            std::shared_ptr<const void> base;
+        };
+        auto arrays = std::make_shared<Arrays>();
+        arrays->base = g.owner;
+        arrays->chunks.assign(g.chunks, g.chunks + g.chunk_count);
+        arrays->indices.assign(g.indices, g.indices + g.triangle_count * 3);
+        for (size_t c = 0; c < arrays->chunks.size(); c++) {
+            auto& chunk = arrays->chunks[c];
+            chunk.first_lod = (uint32_t)arrays->lods.size();
+            chunk.lod_count = (uint32_t)levels[c].size() + 1;
+            arrays->lods.push_back({ chunk.first_triangle * 3, chunk.triangle_count, 0, 0 });
+            for (auto& level : levels[c]) {
+                arrays->lods.push_back({ arrays->indices.size(), level.indices.size() / 3, level.error, 0 });
+                arrays->indices.insert(arrays->indices.end(), level.indices.begin(), level.indices.end());
+            }
+        }
+        g.index_count = arrays->indices.size();
+        g.lod_count = arrays->lods.size();
+        g.chunks = arrays->chunks.data();
+        g.lods = arrays->lods.data();
+        g.indices = arrays->indices.data();
+        g.owner = arrays;
+    }
+
+    // triangles for picking, back in the order given, between the vertices of the chunks
+    static void pickGeometry(const std::vector<MeshRenderer::Chunk>& chunks,
+                             const std::vector<unsigned int>& chunk_triangles, unsigned long long vertex_count,
+                             const unsigned char* vertices, int vertex_format, const common::Vector3<float>& offset,
+                             const common::Vector3<float>& scale, const unsigned short* indices,
+                             std::vector<float>& positions, std::vector<unsigned int>& triangles) {
+        size_t stride = layoutStride(vertex_format);
+        positions.resize(vertex_count * 3);
+        for (unsigned long long v = 0; v < vertex_count; v++) {
+            auto p = decodePosition(vertices + v * stride, vertex_format, offset, scale);
+            std::copy(p.data(), p.data() + 3, &positions[v * 3]);
+        }
+        triangles.assign(chunk_triangles.size() * 3, 0);
+        for (auto& chunk : chunks) {
+            for (auto i = chunk.first_triangle; i < chunk.first_triangle + chunk.triangle_count; i++) {
+                for (int k = 0; k < 3; k++) {
+                    auto corner = (size_t)chunk_triangles[i] * 3 + k;
+                    triangles[corner] = (unsigned int)(chunk.base_vertex + indices[i * 3 + k]);
+                }
+            }
+        }
+    }
+
+    MeshRenderer::MeshRenderer(const common::Mesh<float>& mesh, bool dynamic, int vertex_format,
+                               bool optimize_vertex_cache):
+        Renderer(), _lods_built(false), _vertex_format(vertex_format),
+        _optimize_vertex_cache(optimize_vertex_cache), _acmr_before(0), _acmr_after(0) {
+        _dynamic = dynamic;
+        loadMesh(mesh);
+        loadTriangles();
+        loadChunks();
+        _color = {0.3f, 0.25f, 0.8f};
+    }
+
+    MeshRenderer::MeshRenderer(const common::PolygonMesh<float>& mesh, bool dynamic, int vertex_format,
+                               bool optimize_vertex_cache):
+        Renderer(), _lods_built(false), _vertex_format(vertex_format),
+        _optimize_vertex_cache(optimize_vertex_cache), _acmr_before(0), _acmr_after(0) {
         _dynamic = dynamic;
+        loadMesh(mesh);
+        loadTriangles();
+        loadChunks();
         _color = {0.3f, 0.25f, 0.8f};
     }
 
-    void CylinderRenderer::render(bool line) {
-        if (!_inited) return;
+    MeshRenderer::MeshRenderer(const MeshCache::Geometry& geometry):
+        Renderer(), _lods_built(false), _vertex_format(geometry.vertex_format),
+        _optimize_vertex_cache(geometry.optimize), _acmr_before(geometry.acmr_before),
+        _acmr_after(geometry.acmr_after), _mapped(geometry) {
+        auto& g = geometry;
+        _vertex_count = g.vertex_count;
+        _triangle_count = g.triangle_count;
+        _position_offset = g.position_offset;
+        _position_scale = g.position_scale;
+        _local_bounds = g.local_bounds;
+        updateBounds();
+        _chunk_triangles.assign(g.chunk_triangles, g.chunk_triangles + g.triangle_count);
+        _chunks.resize(g.chunk_count);
+        for (size_t c = 0; c < _chunks.size(); c++) {
+            auto& record = g.chunks[c];
+            auto& chunk = _chunks[c];
+            chunk.base_vertex = record.base_vertex;
+            chunk.vertex_count = record.vertex_count;
+            chunk.first_triangle = record.first_triangle;
+            chunk.triangle_count = record.triangle_count;
+            chunk.bounds = MeshCache::loadBounds(record.bounds);
+        }
+
+        std::vector<float> positions;
+        std::vector<unsigned int> indices;
+        pickGeometry(_chunks, _chunk_triangles, _vertex_count, g.vertices, _vertex_format, _position_offset,
+                     _position_scale, g.indices, positions, indices);
+        _pick_tree = std::make_shared<TriangleTree>(std::move(positions), std::move(indices));
+        _triangles = _pick_tree;
+        _color = {0.3f, 0.25f, 0.8f};
+    }
+
+    MeshRenderer::~MeshRenderer() {
+        cancelLods();
+    }
+
+    void MeshRenderer::cancelLods() {
+        if (_lod_build) _lod_build->cancelled = true;
+        _lod_build = nullptr;
+        _lods_built = false;
+        for (auto& chunk : _chunks) {
+            chunk.lods.clear();
+            chunk.lod = 0;
+        }
+    }
+
+    void MeshRenderer::loadMappedLods() {
+        if (_lods_built || _mapped.lod_count == 0) return;
+        for (size_t c = 0; c < _chunks.size(); c++) {
+            auto& record = _mapped.chunks[c];
+            auto& chunk = _chunks[c];
+            chunk.lods.clear();
+            for (auto l = record.first_lod; l < record.first_lod + record.lod_count; l++) {
+                auto& lod = _mapped.lods[l];
+                chunk.lods.push_back({ lod.first, lod.triangle_count, lod.error });
+            }
+        }
+        _lods_built = true;
+    }
+
+    void MeshRenderer::init(int VAP_position, int VAP_normal) {
+        if (_inited) return;
+        bool reloaded = (bool)_pending;
+        if (_pending) {
+            _pending();
+            _pending = nullptr;
+        }
+        unsigned long long first, last;
+        applyVertexEdits(first, last);
+        // uploaded with the chunks, before the mapping may be released
+        if (_mapped.owner) loadMappedLods();
+        if (VAO == 0 || !ringBuffered() || reloaded) {
+            Renderer::init(VAP_position, VAP_normal);
+            // picking follows the policy of the geometry it copies
+            if (_geometry_released && _pick_tree) _pick_tree->release(_memory_policy);
+            return;
+        }
+        // the faces are unchanged since the last upload
+        if (first < last) {
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            uploadRingVertices(first, last - first);
+            glBindVertexArray(0);
+        }
+        _inited = true;
+    }
+
+    void MeshRenderer::deinit() {
+        cancelLods();
+        Renderer::deinit();
+    }
+
+    int MeshRenderer::draw(int instance_count) const {
+        int calls = 0;
+        for (size_t i = 0; i < _chunks.size(); i++) {
+            if (!_chunks[i].visible) continue;
+            drawChunk(i, _chunks[i].lod, instance_count);
+            calls++;
+        }
+        return calls;
+    }
+
+    void MeshRenderer::drawChunk(size_t chunk, int lod, int instance_count) const {
+        auto& c = _chunks[chunk];
+        unsigned long long first = c.first_triangle * 3, count = c.triangle_count;
+        if (lod > 0 && lod < (int)c.lods.size()) {
+            first = c.lods[lod].first;
+            count = c.lods[lod].triangle_count;
+        }
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)(count * 3), GL_UNSIGNED_SHORT,
+                                          (void*)(_ring_index_offset + sizeof(unsigned short) * first), // NOLINT
+                                          instance_count, (GLint)(_ring_base_vertex + c.base_vertex));
+    }
+
+    void MeshRenderer::setChunkVisible(size_t chunk, bool visible) {
+        _chunks[chunk].visible = visible;
+    }
+
+    void MeshRenderer::setChunkLod(size_t chunk, int lod) {
+        auto& c = _chunks[chunk];
+        c.lod = c.lods.empty() ? 0 : std::max(0, std::min(lod, (int)c.lods.size() - 1));
+    }
+
+    void MeshRenderer::updateLods(unsigned long long min_triangles) {
+        if (_dynamic || !_inited || _lods_built) return;
+        if (!_lod_build) {
+            bool simplify = _triangle_count >= min_triangles && !_chunks.empty();
+            if (!simplify && _cache_path.empty()) return;
+            // released geometry is read back over the next frames, without waiting for the gpu
+            bool released = _geometry_released;
+            std::vector<unsigned char> vertex_bytes, index_bytes;
+            if (released) {
+                if (!readGeometryAsync(vertex_bytes, index_bytes)) return;
+                reloadPickTree(vertex_bytes, index_bytes);
+            }
+            auto vertices = released ? vertex_bytes.data() : static_cast<const unsigned char*>(vertexData());
+            auto chunk_indices = released ? reinterpret_cast<const unsigned short*>(index_bytes.data()) :
+                                            static_cast<const unsigned short*>(indexData());
+            // the worker gets its own copy of the chunks, so the renderer can go away meanwhile
+            auto build = std::make_shared<LodBuild>();
+            std::vector<std::vector<float>> positions;
+            std::vector<std::vector<unsigned int>> indices;
+            if (simplify) {
+                chunkGeometry(_chunks.data(), _chunks.size(), vertices, _vertex_format, _position_offset,
+                              _position_scale, chunk_indices, positions, indices);
+            }
+            // and the cache its uploaded geometry, written with the levels of the same build
+            MeshCache::Geometry cache;
+            if (!_cache_path.empty()) cache = copyGeometry(vertices, chunk_indices);
+            bool optimize = _optimize_vertex_cache;
+            // done is the handoff: the render thread polls it here, and takes the levels once it is set
+            WorkerPool::shared().submit([build, positions = std::move(positions), indices = std::move(indices),
+                                         optimize, path = _cache_path, source = _cache_source, cache]() mutable {
+                simplifyChunks(positions, indices, optimize, build->cancelled, build->levels);
+                build->done = true;
+                if (path.empty() || build->cancelled) return;
+                appendLevels(cache, build->levels);
+                MeshCache::write(path, source, cache);
+            });
+            _cache_path.clear();
+            if (simplify) _lod_build = build;
+            return;
+        }
+        if (!_lod_build->done) return;
+
+        // a larger index buffer, with the chunks copied over and their levels appended
+        unsigned long long size = _triangle_count * 3;
+        for (size_t c = 0; c < _chunks.size(); c++) {
+            auto& chunk = _chunks[c];
+            chunk.lods.push_back({ chunk.first_triangle * 3, chunk.triangle_count, 0 });
+            for (auto& level : _lod_build->levels[c]) {
+                chunk.lods.push_back({ size, level.indices.size() / 3, level.error });
+                size += level.indices.size();
+            }
+        }
+        unsigned int lod_EBO;
+        glGenBuffers(1, &lod_EBO);
         glBindVertexArray(VAO);
-        if (line) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, lod_EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(sizeof(unsigned short) * size), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                            (GLsizeiptr)(sizeof(unsigned short) * _triangle_count * 3));
+        for (size_t c = 0; c < _chunks.size(); c++) {
+            for (size_t i = 1; i < _chunks[c].lods.size(); i++) {
+                auto& indices = _lod_build->levels[c][i - 1].indices;
+                glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(sizeof(unsigned short) * _chunks[c].lods[i].first),
+                                (GLsizeiptr)(sizeof(unsigned short) * indices.size()), indices.data());
+            }
         }
-        glDrawElements(GL_TRIANGLES, (GLsizei)(_triangle_count * 3),
-                       GL_UNSIGNED_INT, (void*)0); // NOLINT
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod_EBO);
         glBindVertexArray(0);
+        glDeleteBuffers(1, &EBO);
+        EBO = lod_EBO;
+        _lod_build = nullptr;
+        _lods_built = true;
     }
 
-    bool CylinderRenderer::updateCylinder(float radius, float height) {
-        if (!_dynamic) return false;
-        loadCylinder(radius, height);
-        _inited = false;
-        return true;
+    void MeshRenderer::updatePickTree() {
+        if (!_inited || !_pick_tree || !_pick_tree->wanted()) return;
+        std::vector<unsigned char> vertices, indices;
+        if (readGeometryAsync(vertices, indices)) reloadPickTree(vertices, indices);
     }
 
-    void ConeRenderer::loadCone(float radius, float height) {
-        // load vertex data
-        float r = std::sqrt(radius * radius + height * height);
-        float sin_a_r = radius / r / 0.4472136f;
-        float cos_a_r = height / r / 0.8944272f;
-        radius *= 2;
-        _vertex_count = _cone_mesh.vertices.size();
-        _vertices = new float[_vertex_count * 6];
-        int i = 0;
-        for (unsigned int j = 0; j < _vertex_count; j++) {
-            auto& v = _cone_mesh.vertices[j].position;
-            auto& n = _cone_mesh.vertices[j].normal;
-            _vertices[i++] = (v.x() * radius);
-            _vertices[i++] = (v.y() * height);
-            _vertices[i++] = (v.z() * radius);
-            _vertices[i++] = (n.x() * cos_a_r);
-            _vertices[i++] = (n.y() * sin_a_r);
-            _vertices[i++] = (n.z() * cos_a_r);
+    void MeshRenderer::reloadPickTree(const std::vector<unsigned char>& vertices,
+                                      const std::vector<unsigned char>& indices) {
+        if (!_pick_tree || !_pick_tree->wanted()) return;
+        std::vector<float> positions;
+        std::vector<unsigned int> triangles;
+        pickGeometry(_chunks, _chunk_triangles, _vertex_count, vertices.data(), _vertex_format, _position_offset,
+                     _position_scale, reinterpret_cast<const unsigned short*>(indices.data()), positions, triangles);
+        _pick_tree->reload(std::move(positions), std::move(triangles));
+    }
+
+    MeshCache::Geometry MeshRenderer::copyGeometry(const unsigned char* vertices,
+                                                   const unsigned short* indices) const {
+        MeshCache::Geometry g;
+        struct Arrays {
+            std::vector<MeshCache::ChunkRecord> chunks;
+            std::vector<uint32_t> chunk_triangles;
+            std::vector<unsigned char> vertices;
+            std::vector<uint16_t> indices;
+        };
+        auto arrays = std::make_shared<Arrays>();
+        for (auto& chunk : _chunks) {
+            MeshCache::ChunkRecord record = {};
+            record.base_vertex = chunk.base_vertex;
+            record.vertex_count = chunk.vertex_count;
+            record.first_triangle = chunk.first_triangle;
+            record.triangle_count = chunk.triangle_count;
+            MeshCache::storeBounds(chunk.bounds, record.bounds);
+            arrays->chunks.push_back(record);
         }
+        arrays->chunk_triangles.assign(_chunk_triangles.begin(), _chunk_triangles.end());
+        arrays->vertices.assign(vertices, vertices + vertexBytes());
+        arrays->indices.assign(indices, indices + _triangle_count * 3);
 
-        // load face data, and transform into triangles
-        _triangle_count = 0;
-        for (auto& f : _cone_mesh.faces) {
-            _triangle_count += f.indices.size() - 2;
+        g.vertex_format = _vertex_format;
+        g.optimize = _optimize_vertex_cache;
+        g.vertex_count = _vertex_count;
+        g.triangle_count = _triangle_count;
+        g.index_count = arrays->indices.size();
+        g.chunk_count = arrays->chunks.size();
+        g.local_bounds = _local_bounds;
+        g.position_offset = _position_offset;
+        g.position_scale = _position_scale;
+        g.acmr_before = _acmr_before;
+        g.acmr_after = _acmr_after;
+        g.chunks = arrays->chunks.data();
+        g.chunk_triangles = arrays->chunk_triangles.data();
+        g.vertices = arrays->vertices.data();
+        g.indices = arrays->indices.data();
+        g.owner = arrays;
+        return g;
+    }
+
+    void MeshRenderer::writeCache(const std::string& source_path, const MeshCache::Source& source) {
+        _cache_path = source_path;
+        _cache_source = source;
+    }
+
+    // the triangles loadMesh() makes of the faces, in its order
+    static std::vector<unsigned int> fanTriangles(const common::Mesh<float>& mesh) {
+        std::vector<unsigned int> triangles;
+        for (auto& f : mesh.faces) {
+            for (size_t j = 1; j + 1 < f.indices.size(); j++) {
+                triangles.insert(triangles.end(), { f.indices[0], f.indices[j], f.indices[j + 1] });
+            }
         }
-        _indices = new unsigned int[_triangle_count * 3];
-        unsigned long long n; i = 0;
-        for (auto& f : _cone_mesh.faces) {
-            n = f.indices.size();
-            for (unsigned int j = 1; j < n - 1; j++) {
-                _indices[i++] = f.indices[0];
-                _indices[i++] = f.indices[j];
-                _indices[i++] = f.indices[j + 1];
+        return triangles;
+    }
+
+    static std::vector<unsigned int> fanTriangles(const common::PolygonMesh<float>& mesh) {
+        if (mesh.isTriangles()) return { mesh.indices.begin(), mesh.indices.begin() + mesh.triangleCount() * 3 };
+        std::vector<unsigned int> triangles;
+        triangles.reserve(mesh.triangleCount() * 3);
+        for (size_t f = 0; f < mesh.faceCount(); f++) {
+            const uint32_t* corners = mesh.face(f);
+            for (size_t j = 1; j + 1 < mesh.faceSize(f); j++) {
+                triangles.insert(triangles.end(), { corners[0], corners[j], corners[j + 1] });
             }
         }
+        return triangles;
     }
 
-    ConeRenderer::ConeRenderer(float radius, float height, bool dynamic):
-            Renderer() {
-        loadCone(radius, height);
-        _dynamic = dynamic;
-        _color = {0.3f, 0.25f, 0.8f};
+    bool MeshRenderer::sameFaces(size_t vertex_count, const std::vector<unsigned int>& triangles) const {
+        // against the loaded faces only, not those of a pending update
+        if (_pending || !_pick_tree || _pick_tree->vertexCount() != vertex_count) return false;
+        return _pick_tree->sameTriangles(triangles.data(), triangles.size() / 3);
     }
 
-    void ConeRenderer::render(bool line) {
-        if (!_inited) return;
-        glBindVertexArray(VAO);
-        if (line) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    void MeshRenderer::replaceVertices(const std::vector<common::Mesh<float>::Vertex>& vertices) {
+        VertexEdit edit;
+        edit.first = 0;
+        edit.count = vertices.size();
+        edit.positions.reserve(vertices.size() * 3);
+        edit.normals.reserve(vertices.size() * 3);
+        for (auto& v : vertices) {
+            edit.positions.insert(edit.positions.end(), v.position.data(), v.position.data() + 3);
+            edit.normals.insert(edit.normals.end(), v.normal.data(), v.normal.data() + 3);
         }
-        glDrawElements(GL_TRIANGLES, (GLsizei)(_triangle_count * 3),
-                       GL_UNSIGNED_INT, (void*)0); // NOLINT
-        glBindVertexArray(0);
+        _vertex_edits.clear();
+        _vertex_edits.push_back(std::move(edit));
+        _inited = false;
     }
 
-    bool ConeRenderer::updateCone(float radius, float height) {
+    bool MeshRenderer::updateMesh(common::Mesh<float> mesh) {
         if (!_dynamic) return false;
-        loadCone(radius, height);
+        if (sameFaces(mesh.vertices.size(), fanTriangles(mesh))) {
+            replaceVertices(mesh.vertices);
+            return true;
+        }
+        _vertex_edits.clear();
+        _pending = [this, mesh = std::move(mesh)]() {
+            loadMesh(mesh);
+            loadTriangles();
+            loadChunks();
+        };
         _inited = false;
         return true;
     }
 
-    void SphereRenderer::loadSphere(float radius) {
-        // load vertex data
-        radius *= 2;
-        _vertex_count = _sphere_mesh.vertices.size();
-        _vertices = new float[_vertex_count * 6];
-        int i = 0;
-        for (unsigned int j = 0; j < _vertex_count; j++) {
-            auto& v = _sphere_mesh.vertices[j].position;
-            auto& n = _sphere_mesh.vertices[j].normal;
-            _vertices[i++] = (v.x() * radius);
-            _vertices[i++] = (v.y() * radius);
-            _vertices[i++] = (v.z() * radius);
-            _vertices[i++] = (n.x());
-            _vertices[i++] = (n.y());
-            _vertices[i++] = (n.z());
+    bool MeshRenderer::updateMesh(common::PolygonMesh<float> mesh) {
+        if (!_dynamic) return false;
+        if (sameFaces(mesh.vertices.size(), fanTriangles(mesh))) {
+            replaceVertices(mesh.vertices);
+            return true;
         }
+        _vertex_edits.clear();
+        _pending = [this, mesh = std::move(mesh)]() {
+            loadMesh(mesh);
+            loadTriangles();
+            loadChunks();
+        };
+        _inited = false;
+        return true;
+    }
 
-        // load face data, and transform into triangles
-        _triangle_count = 0;
-        for (auto& f : _sphere_mesh.faces) {
-            _triangle_count += f.indices.size() - 2;
+    bool MeshRenderer::updateVertices(VertexEdit edit) {
+        if (!_dynamic) return false;
+        _vertex_edits.push_back(std::move(edit));
+        _inited = false;
+        return true;
+    }
+
+    void MeshRenderer::applyVertexEdits(unsigned long long& first, unsigned long long& last) {
+        first = _vertex_count;
+        last = 0;
+        if (_vertex_edits.empty()) return;
+        auto source_count = (unsigned long long)_pick_tree->vertexCount();
+
+        // positions outside of the quantized range requantize all of them, against the new bounds
+        bool requantize = false;
+        for (auto& edit : _vertex_edits) {
+            if (edit.first + edit.count > source_count) continue;
+            for (size_t i = 0; i < edit.positions.size() && _vertex_format != V_FLOAT && !requantize; i += 3) {
+                Eigen::Map<const common::Vector3<float>> p(&edit.positions[i]);
+                common::Vector3<float> q = (p - _position_offset).cwiseQuotient(_position_scale);
+                requantize = q.minCoeff() < 0 || q.maxCoeff() > 1;
+            }
         }
-        _indices = new unsigned int[_triangle_count * 3];
-        unsigned long long n; i = 0;
-        for (auto& f : _sphere_mesh.faces) {
-            n = f.indices.size();
-            for (unsigned int j = 1; j < n - 1; j++) {
-                _indices[i++] = f.indices[0];
-                _indices[i++] = f.indices[j];
-                _indices[i++] = f.indices[j + 1];
+
+        // only the copies of the edited vertices, and the boxes of the picking tree on its next query
+        std::vector<char> chunk_changed(_chunks.size(), 0);
+        for (auto& edit : _vertex_edits) {
+            if (edit.first + edit.count > source_count) continue;
+            bool has_positions = edit.positions.size() >= edit.count * 3;
+            bool has_normals = edit.normals.size() >= edit.count * 3;
+            if (has_positions) _pick_tree->updatePositions(edit.first, edit.count, edit.positions.data());
+            for (unsigned long long i = 0; i < edit.count; i++) {
+                auto v = edit.first + i;
+                for (auto c = _vertex_copy_offsets[v]; c < _vertex_copy_offsets[v + 1]; c++) {
+                    auto u = _vertex_copies[c];
+                    if (has_positions && !requantize) packPosition(u, &edit.positions[i * 3]);
+                    if (has_normals) packNormal(u, &edit.normals[i * 3]);
+                    first = std::min(first, (unsigned long long)u);
+                    last = std::max(last, (unsigned long long)u + 1);
+                    if (!has_positions) continue;
+                    auto chunk = std::upper_bound(_chunks.begin(), _chunks.end(), u,
+                                                  [](unsigned int u, const Chunk& c) { return u < c.base_vertex; });
+                    chunk_changed[chunk - _chunks.begin() - 1] = 1;
+                }
+            }
+        }
+        _vertex_edits.clear();
+        if (std::find(chunk_changed.begin(), chunk_changed.end(), 1) == chunk_changed.end()) return;
+
+        if (requantize) {
+            std::vector<float> positions;
+            _pick_tree->copyPositions(positions);
+            auto bounds = Bounds::fromVertices(positions.data(), source_count, 3);
+            float extent = (bounds.max - bounds.min).maxCoeff();
+            _position_offset = bounds.min;
+            _position_scale = common::Vector3<float>::Constant(extent > 0 ? extent : 1);
+            for (unsigned long long u = 0; u < _vertex_count; u++) packPosition(u, &positions[_vertex_sources[u] * 3]);
+            std::fill(chunk_changed.begin(), chunk_changed.end(), 1);
+            first = 0;
+            last = _vertex_count;
+        }
+
+        // the bounds of the changed chunks from their vertices as drawn, and the mesh around the chunks
+        std::vector<float> chunk_positions;
+        for (size_t c = 0; c < _chunks.size(); c++) {
+            if (!chunk_changed[c]) continue;
+            auto& chunk = _chunks[c];
+            chunk_positions.resize(chunk.vertex_count * 3);
+            for (unsigned long long u = 0; u < chunk.vertex_count; u++) {
+                auto p = vertexPosition(chunk.base_vertex + u);
+                std::copy(p.data(), p.data() + 3, &chunk_positions[u * 3]);
             }
+            chunk.bounds = Bounds::fromVertices(chunk_positions.data(), chunk.vertex_count, 3);
+            if (_vertex_format == V_FLOAT) continue;
+            // the positions given, which picking tests, are within half a step of those drawn
+            common::Vector3<float> slack = _position_scale / 65535.f * 0.5f;
+            chunk.bounds.min -= slack;
+            chunk.bounds.max += slack;
+            chunk.bounds.radius += slack.norm();
         }
+        _local_bounds.min = _chunks[0].bounds.min;
+        _local_bounds.max = _chunks[0].bounds.max;
+        for (auto& chunk : _chunks) {
+            _local_bounds.min = _local_bounds.min.cwiseMin(chunk.bounds.min);
+            _local_bounds.max = _local_bounds.max.cwiseMax(chunk.bounds.max);
+        }
+        _local_bounds.center = (_local_bounds.min + _local_bounds.max) * 0.5f;
+        _local_bounds.radius = 0;
+        for (auto& chunk : _chunks) {
+            _local_bounds.radius = std::max(_local_bounds.radius,
+                                            (chunk.bounds.center - _local_bounds.center).norm() + chunk.bounds.radius);
+        }
+        updateBounds();
     }
 
-    SphereRenderer::SphereRenderer(float radius, bool dynamic):
-            Renderer() {
-        loadSphere(radius);
+    PrimitiveRenderer::~PrimitiveRenderer() {
+        deinit(); // NOLINT
+    }
+
+    void PrimitiveRenderer::setScale(const common::Vector3<float>& scale) {
+        _scale = scale;
+        updateBounds();
+    }
+
+    void PrimitiveRenderer::init(int VAP_position, int VAP_normal) {
+        if (_inited) return;
+        auto& geometry = shared_geometries[type()];
+        if (geometry.users == 0) {
+            // first primitive of this type, upload the unit mesh and hand it over to the cache
+            loadMesh(unitMesh());
+            Renderer::init(VAP_position, VAP_normal);
+            geometry = { VAO, VBO, EBO, _vertex_count, _triangle_count, 0 };
+            clearGeometry();
+        }
+        geometry.users++;
+        VAO = geometry.VAO;
+        VBO = geometry.VBO;
+        EBO = geometry.EBO;
+        _vertex_count = geometry.vertex_count;
+        _triangle_count = geometry.triangle_count;
+        _inited = true;
+    }
+
+    void PrimitiveRenderer::deinit() {
+        if (VAO == 0) return;
+        auto& geometry = shared_geometries[type()];
+        if (--geometry.users == 0) {
+            Renderer::deinit();
+            geometry = {};
+        }
+        VAO = 0; VBO = 0; EBO = 0;
+        _inited = false;
+    }
+
+    const common::Mesh<float>& CubeRenderer::unitMesh() const {
+        return _cube_mesh;
+    }
+
+    CubeRenderer::CubeRenderer(const common::Vector3<float> &size, bool dynamic) {
+        static const Bounds unit_bounds = meshBounds(_cube_mesh);
+        static const std::shared_ptr<const TriangleTree> unit_triangles = TriangleTree::fromMesh(_cube_mesh);
+        _local_bounds = unit_bounds;
+        _triangles = unit_triangles;
+        setScale(size);
         _dynamic = dynamic;
         _color = {0.3f, 0.25f, 0.8f};
     }
 
-    void SphereRenderer::render(bool line) {
-        if (!_inited) return;
-        glBindVertexArray(VAO);
-        if (line) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
-        glDrawElements(GL_TRIANGLES, (GLsizei)(_triangle_count * 3),
-                       GL_UNSIGNED_INT, (void*)0); // NOLINT
-        glBindVertexArray(0);
+    bool CubeRenderer::updateCube(const common::Vector3<float> &size) {
+        if (!_dynamic) return false;
+        setScale(size);
+        return true;
+    }
+
+    // the unit cylinder, cone and sphere have a diameter of 1
+    const common::Mesh<float>& CylinderRenderer::unitMesh() const {
+        return _cylinder_mesh;
+    }
+
+    CylinderRenderer::CylinderRenderer(float radius, float height, bool dynamic) {
+        static const Bounds unit_bounds = meshBounds(_cylinder_mesh);
+        static const std::shared_ptr<const TriangleTree> unit_triangles = TriangleTree::fromMesh(_cylinder_mesh);
+        _local_bounds = unit_bounds;
+        _triangles = unit_triangles;
+        setScale({ radius * 2, height, radius * 2 });
+        _dynamic = dynamic;
+        _color = {0.3f, 0.25f, 0.8f};
+    }
+
+    bool CylinderRenderer::updateCylinder(float radius, float height) {
+        if (!_dynamic) return false;
+        setScale({ radius * 2, height, radius * 2 });
+        return true;
+    }
+
+    // normals of the unit cone are scaled by the inverse scale in the shader,
+    // which keeps them perpendicular to the side of any cone
+    const common::Mesh<float>& ConeRenderer::unitMesh() const {
+        return _cone_mesh;
+    }
+
+    ConeRenderer::ConeRenderer(float radius, float height, bool dynamic):
+            PrimitiveRenderer() {
+        static const Bounds unit_bounds = meshBounds(_cone_mesh);
+        static const std::shared_ptr<const TriangleTree> unit_triangles = TriangleTree::fromMesh(_cone_mesh);
+        _local_bounds = unit_bounds;
+        _triangles = unit_triangles;
+        setScale({ radius * 2, height, radius * 2 });
+        _dynamic = dynamic;
+        _color = {0.3f, 0.25f, 0.8f};
+    }
+
+    bool ConeRenderer::updateCone(float radius, float height) {
+        if (!_dynamic) return false;
+        setScale({ radius * 2, height, radius * 2 });
+        return true;
+    }
+
+    const common::Mesh<float>& SphereRenderer::unitMesh() const {
+        return _sphere_mesh;
+    }
+
+    SphereRenderer::SphereRenderer(float radius, bool dynamic):
+            PrimitiveRenderer() {
+        static const Bounds unit_bounds = meshBounds(_sphere_mesh);
+        static const std::shared_ptr<const TriangleTree> unit_triangles = TriangleTree::fromMesh(_sphere_mesh);
+        _local_bounds = unit_bounds;
+        _triangles = unit_triangles;
+        setScale(common::Vector3<float>::Constant(radius * 2));
+        _dynamic = dynamic;
+        _color = {0.3f, 0.25f, 0.8f};
     }
 
     bool SphereRenderer::updateSphere(float radius) {
         if (!_dynamic) return false;
-        loadSphere(radius);
-        _inited = false;
+        setScale(common::Vector3<float>::Constant(radius * 2));
         return true;
     }
 
     void LineRenderer::loadLine(const std::vector<float>& points) {
+        clearGeometry();
         _vertex_count = (points.size() - 3) * 2 / 3;
         _vertices = new float[_vertex_count * 6]{};
         int i = 6;
@@ -375,6 +1356,8 @@ namespace simple_viewer {
         _vertices[i++] = points[j];
         _vertices[i++] = points[j + 1];
         _vertices[i] = points[j + 2];
+        _local_bounds = Bounds::fromVertices(_vertices, _vertex_count, 6);
+        updateBounds();
     }
 
     LineRenderer::LineRenderer(const std::vector<float>& points, bool dynamic):
@@ -384,17 +1367,14 @@ namespace simple_viewer {
         _color = {1.0f, 0.95f, 0.0f};
     }
 
-    void LineRenderer::render(bool line) {
-        if (!_inited) return;
-        glBindVertexArray(VAO);
-        glLineWidth((float)_width);
-        glDrawArrays(GL_LINES, 0, (GLsizei)(_vertex_count * 3));
-        glBindVertexArray(0);
+    int LineRenderer::draw(int instance_count) const {
+        glDrawArraysInstanced(GL_LINES, (GLint)_ring_base_vertex, (GLsizei)_vertex_count, instance_count);
+        return 1;
     }
 
-    bool LineRenderer::updateLine(const std::vector<float>& points) {
+    bool LineRenderer::updateLine(std::vector<float> points) {
         if (!_dynamic) return false;
-        loadLine(points);
+        _pending = [this, points = std::move(points)]() { loadLine(points); };
         _inited = false;
         return true;
     }
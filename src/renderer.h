@@ -1,8 +1,16 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+#include <functional>
 #include "common/general.h"
 #include "common/mesh.h"
+#include "common/polygon_mesh.h"
 #include "common/transform.h"
+#include "bounds.h"
+#include "triangle_tree.h"
+#include "geometry_cache.h"
+#include "mesh_cache.h"
 
 namespace simple_viewer {
 
@@ -19,8 +27,25 @@ namespace simple_viewer {
         R_SPHERE = 6
     };
 
+    // must be consistent with the VertexFormat in opengl_viewer.h
+    enum VertexLayout {
+        V_FLOAT = 1,            // 3 float position, 3 float normal: 24 bytes
+        V_COMPACT = 2,          // 16 bit position and padding, 2x16 bit octahedral normal: 12 bytes
+        V_COMPACT_SMALL = 3     // 16 bit position, and the 2x8 bit octahedral normal in its 4th component: 8 bytes
+    };
+
     /**
      * @brief Basic render
+     *
+     * The buffers of a dynamic renderer are split into RingPartitions, and
+     * each update is written into the next one, unsynchronized, while the gpu
+     * may still draw from the others. A renderer is uploaded at most once per
+     * frame, so this is safe as long as the frames in flight are no more than
+     * the partitions (see FrameFences). The buffers grow when an update no
+     * longer fits, which is the only time they are reallocated.
+     *
+     * Static geometry can drop its cpu copy once uploaded (see CachePolicy),
+     * the gpu one being read back into a GeometryCache when the buffers go.
      */
     class Renderer {
     protected:
@@ -29,64 +54,313 @@ namespace simple_viewer {
         float *_vertices;
         unsigned long long _triangle_count;
         unsigned int *_indices;
+        // geometry update waiting for the next init(), a newer update replaces it
+        std::function<void()> _pending;
+        // partitions of the rings written last, their sizes in bytes, and where their geometry starts
+        int _ring_vertex_partition, _ring_index_partition;
+        unsigned long long _ring_vertex_capacity, _ring_index_capacity;
+        unsigned long long _ring_base_vertex, _ring_index_offset;
+        // the cpu copy of static geometry was dropped once uploaded, see CachePolicy
+        bool _geometry_released;
+        // the geometry read back from the gpu, while it has no buffers
+        std::unique_ptr<GeometryCache> _geometry_cache;
+        // copies of the buffers being read back, and the fence (a GLsync) passed once they are written
+        unsigned int _readback_buffers[2];
+        void* _readback_fence;
+
+        // bounds of the geometry in its own space
+        Bounds _local_bounds;
+        // triangles for picking, nullptr for geometry without triangles
+        std::shared_ptr<const TriangleTree> _triangles;
+
+        void clearGeometry();
+        // fill the vertex and index arrays from a mesh, triangulating its faces
+        void loadMesh(const common::Mesh<float>& mesh);
+        // the same from flat faces, the indices of triangles copied as they are
+        void loadMesh(const common::PolygonMesh<float>& mesh);
+        void loadVertices(const std::vector<common::Mesh<float>::Vertex>& vertices);
+        // recompute the world bounds, after the transform, scale or geometry changed
+        void updateBounds();
+        // geometry as uploaded
+        virtual const void* vertexData() const { return _vertices; }
+        // bytes of the components of a vertex
+        virtual size_t vertexElementSize() const { return sizeof(float); }
+        virtual size_t indexSize() const { return sizeof(unsigned int); }
+        virtual unsigned long long indexCount() const { return _triangle_count * 3; }
+        virtual const void* indexData() const { return _indices; }
+        // point the attributes at the bound vertex buffer
+        virtual void setAttributes(int VAP_position, int VAP_normal);
+        // drop the cpu copy of the geometry, or set it back from its uploaded bytes
+        virtual void releaseGeometry();
+        virtual void restoreGeometry(const std::vector<unsigned char>& vertices,
+                                     const std::vector<unsigned char>& indices);
+        // the uploaded bytes of static geometry, from the gpu
+        void readGeometry(std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices) const;
+        // the same without waiting for the gpu: the first call copies the buffers, and the calls of
+        // the next frames return true with the bytes once the copies are done
+        bool readGeometryAsync(std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices);
+        void cancelReadback();
+        // whether the geometry is written into a ring of buffer partitions, see RingPartitions
+        virtual bool ringBuffered() const { return _dynamic; }
+        // write the geometry into the next partitions, the indices being kept if unchanged
+        void uploadRing(bool indices = true);
+        // write the vertices into the next partition, only [first, first + count) having changed
+        void uploadRingVertices(unsigned long long first, unsigned long long count);
 
         COMMON_BOOL_GET(inited, Inited)
         COMMON_BOOL_GET(dynamic, Dynamic)
-        COMMON_MEMBER_SET_GET(common::Transform<float>, transform, Transform)
+        COMMON_BOOL_SET_GET(visible, Visible)
+        COMMON_MEMBER_GET(common::Transform<float>, transform, Transform)
         COMMON_MEMBER_SET_GET(common::Vector3<float>, color, Color)
+        // applied to the geometry in the shader
+        COMMON_MEMBER_GET(common::Vector3<float>, scale, Scale)
+        // decodes the uploaded positions into the geometry space, as offset + scale * position
+        COMMON_MEMBER_GET(common::Vector3<float>, position_offset, PositionOffset)
+        COMMON_MEMBER_GET(common::Vector3<float>, position_scale, PositionScale)
+        // world space bounds, kept up to date with the transform, scale and geometry
+        COMMON_MEMBER_GET(Bounds, bounds, Bounds)
+        // set when the world bounds change, cleared once the scene tree has them
+        COMMON_BOOL_SET_GET(bounds_changed, BoundsChanged)
+        // leaf of the object in the scene tree, -1 if not in it
+        COMMON_MEMBER_SET_GET(int, tree_leaf, TreeLeaf)
+        // what becomes of the cpu copy of static geometry once uploaded, one of CachePolicy
+        COMMON_MEMBER_SET_GET(int, memory_policy, MemoryPolicy)
 
     public:
+        static const int RingPartitions = 3;
+
         Renderer();
         Renderer(const Renderer& other) = delete;
         virtual ~Renderer();
 
         virtual int type() const = 0;
+        void setTransform(const common::Transform<float>& transform);
+        virtual bool hasPendingUpdate() const { return (bool)_pending; }
+        unsigned long long vertexCount() const { return _vertex_count; }
+        unsigned long long triangleCount() const { return _triangle_count; }
+        const std::shared_ptr<const TriangleTree>& triangles() const { return _triangles; }
+        unsigned int vertexArray() const { return VAO; }
+        virtual size_t vertexStride() const { return sizeof(float) * 6; }
+        // updates written into a ring partition so far, and reallocations of the rings
+        static unsigned long long ringUploads();
+        static unsigned long long ringReallocations();
         virtual void init(int VAP_position, int VAP_normal);
+        // keep released geometry in its cache before deinit() drops the buffers, so init() can upload it again
+        void cacheGeometry();
         virtual void deinit();
-        virtual void render(bool line) = 0;
+        // issue the draw calls, with the vertex array already bound, and return how many
+        virtual int draw(int instance_count) const;
     };
 
     /**
      * @brief Mesh renderer
+     *
+     * The triangles are split along their median into spatially coherent chunks
+     * of up to 64k vertices, indexed with 16 bits from a base vertex, so a mesh
+     * of any size fits and every chunk is culled on its own.
+     *
+     * A static mesh with enough triangles also gets a chain of levels of detail
+     * per chunk, simplified by the shared WorkerPool once it is uploaded. The
+     * levels share the vertex buffer and are appended to the index buffer, so
+     * choosing one only changes the range of indices drawn. The borders of the
+     * chunks are kept by the simplification, so neighbouring levels never crack.
+     *
+     * The vertices are uploaded in one of the VertexLayout, the compact ones
+     * quantizing the positions to 16 bits within the bounds of the mesh, and
+     * encoding the normals in octahedral coordinates. The shader tells them
+     * apart by the 4th position component: 1 for floats, 0 for V_COMPACT, and
+     * the packed normal for V_COMPACT_SMALL, which is never 0 nor 1.
+     *
+     * Optionally, the triangles of every chunk (and of its levels) are
+     * reordered for the post-transform vertex cache, and its vertices then
+     * follow the order they are fetched in.
+     *
+     * The vertices of a dynamic mesh can be updated without its faces: the
+     * edits are written into the copies of each vertex, and only the changed
+     * vertices are uploaded, the chunks and indices staying as they are.
+     *
+     * A static mesh can also be made of a MeshCache, whose chunks and levels
+     * are uploaded straight from the mapped file, which is the cpu copy of the
+     * geometry until it is released.
      */
     class MeshRenderer : public Renderer {
+    public:
+        struct LodLevel {
+            unsigned long long first;           // first index in the index buffer
+            unsigned long long triangle_count;
+            float error;                        // largest distance to the full chunk, in the mesh space
+        };
+        struct Chunk {
+            unsigned long long base_vertex;     // first vertex in the vertex buffer
+            unsigned long long vertex_count;
+            unsigned long long first_triangle;  // of the chunk order, see originalTriangle()
+            unsigned long long triangle_count;
+            Bounds bounds;                      // in the mesh space
+            std::vector<LodLevel> lods;         // level 0 being the chunk, empty until built
+            int lod = 0;
+            bool visible = true;
+        };
+        struct VertexEdit {
+            unsigned long long first, count;    // of the vertices of the mesh as given
+            std::vector<float> positions;       // 3 floats per vertex, empty to keep them
+            std::vector<float> normals;
+        };
+        static const int MaxLodLevels = 8;
+        static const size_t MaxChunkVertices = 1 << 16;
+
     protected:
-        void loadMesh(const common::Mesh<float>& mesh);
+        struct LodBuild;
+
+        std::vector<Chunk> _chunks;
+        std::vector<unsigned short> _chunk_indices;
+        // triangles in chunk order, mapping back to the triangulated faces
+        std::vector<unsigned int> _chunk_triangles;
+        std::shared_ptr<LodBuild> _lod_build;
+        bool _lods_built;
+        int _vertex_format;
+        // vertices of the compact formats, _vertices being released
+        std::vector<unsigned char> _packed_vertices;
+        // reorder the triangles of every chunk for the vertex cache
+        bool _optimize_vertex_cache;
+        // average cache misses per triangle of the faces as given, and as drawn
+        float _acmr_before, _acmr_after;
+        // of dynamic meshes: the vertex as given each uploaded one is a copy of, and the copies of each
+        std::vector<unsigned int> _vertex_sources;
+        std::vector<unsigned int> _vertex_copy_offsets, _vertex_copies;
+        // vertex updates waiting for the next init(), applied in order after any new geometry
+        std::vector<VertexEdit> _vertex_edits;
+        // the triangles for picking, whose vertices the edits move in place
+        std::shared_ptr<TriangleTree> _pick_tree;
+        // geometry in a mesh cache, uploaded as it is instead of the arrays
+        MeshCache::Geometry _mapped;
+        // the cache of the source file, written by the next level build (see writeCache())
+        std::string _cache_path;
+        MeshCache::Source _cache_source;
+
+        void loadTriangles();
+        // whether these are the faces loaded, so only the vertices of the mesh changed
+        bool sameFaces(size_t vertex_count, const std::vector<unsigned int>& triangles) const;
+        // the vertices of the mesh as a vertex edit, replacing the pending ones
+        void replaceVertices(const std::vector<common::Mesh<float>::Vertex>& vertices);
+        // split the loaded geometry into chunks, replacing the vertices and indices
+        void loadChunks();
+        void packVertices(const std::vector<float>& vertices);
+        void packPosition(unsigned long long vertex, const float* position);
+        // a copy of the chunks as uploaded, without their levels
+        MeshCache::Geometry copyGeometry(const unsigned char* vertices, const unsigned short* indices) const;
+        void packNormal(unsigned long long vertex, const float* normal);
+        // apply the vertex edits to the geometry, and return the range of uploaded vertices changed
+        void applyVertexEdits(unsigned long long& first, unsigned long long& last);
+        const void* vertexData() const override;
+        size_t vertexElementSize() const override { return _vertex_format == V_FLOAT ? sizeof(float) : 2; }
+        size_t indexSize() const override { return sizeof(unsigned short); }
+        unsigned long long indexCount() const override;
+        const void* indexData() const override;
+        void setAttributes(int VAP_position, int VAP_normal) override;
+        void releaseGeometry() override;
+        void restoreGeometry(const std::vector<unsigned char>& vertices,
+                             const std::vector<unsigned char>& indices) override;
+        void cancelLods();
+        // the levels of the mapped geometry, whose indices are uploaded with the chunks
+        void loadMappedLods();
+        // give the picking tree its arrays from the uploaded bytes, if a query missed them
+        void reloadPickTree(const std::vector<unsigned char>& vertices, const std::vector<unsigned char>& indices);
 
     public:
-        explicit MeshRenderer(const common::Mesh<float>& mesh, bool dynamic = false);
+        explicit MeshRenderer(const common::Mesh<float>& mesh, bool dynamic = false, int vertex_format = V_FLOAT,
+                              bool optimize_vertex_cache = true);
+        explicit MeshRenderer(const common::PolygonMesh<float>& mesh, bool dynamic = false,
+                              int vertex_format = V_FLOAT, bool optimize_vertex_cache = true);
+        // static, the triangles for picking being decoded from the chunks
+        explicit MeshRenderer(const MeshCache::Geometry& geometry);
+        ~MeshRenderer() override;
 
         int type() const override { return RenderType::R_MESH; }
-        void render(bool line) override;
+        bool hasPendingUpdate() const override { return _pending || !_vertex_edits.empty(); }
+        // with only vertex edits pending, uploads the vertices they changed and keeps the indices,
+        // new geometry being uploaded in full
+        void init(int VAP_position, int VAP_normal) override;
+        void deinit() override;
+        // draw the visible chunks at their level
+        int draw(int instance_count) const override;
+        void drawChunk(size_t chunk, int lod, int instance_count) const;
+
+        // with the faces unchanged, only the vertices are updated as by updateVertices()
+        bool updateMesh(common::Mesh<float> mesh);
+        bool updateMesh(common::PolygonMesh<float> mesh);
+        // update positions and/or normals of a dynamic mesh, keeping its faces
+        bool updateVertices(VertexEdit edit);
+        // start building the chain of a large static mesh, or upload the finished one, render thread only.
+        // The same build writes the cache asked for, with the levels if any
+        void updateLods(unsigned long long min_triangles);
+        // read back the picking tree dropped by the C_MEMORY policy once a query wants it, render thread only
+        void updatePickTree();
+
+        const std::vector<Chunk>& chunks() const { return _chunks; }
+        void setChunkVisible(size_t chunk, bool visible);
+        void setChunkLod(size_t chunk, int lod);
+        unsigned int originalTriangle(unsigned long long triangle) const { return _chunk_triangles[triangle]; }
+        // write the chunks and their levels to the cache of a source file, by the next updateLods()
+        void writeCache(const std::string& source_path, const MeshCache::Source& source);
+
+        int vertexFormat() const { return _vertex_format; }
+        float acmrBefore() const { return _acmr_before; }
+        float acmrAfter() const { return _acmr_after; }
+        size_t vertexStride() const override;
+        // position of a vertex in the geometry space, decoded
+        common::Vector3<float> vertexPosition(unsigned long long vertex) const;
+        // gpu memory of the chunks, without their levels of detail
+        unsigned long long vertexBytes() const { return vertexStride() * _vertex_count; }
+        unsigned long long indexBytes() const { return sizeof(unsigned short) * _triangle_count * 3; }
+        // cpu memory of the geometry, copied, mapped or cached, and of its picking tree
+        unsigned long long cpuBytes() const;
+    };
+
+    /**
+     * @brief Base of the primitive renderers
+     *
+     * Every primitive of one type draws the same unit mesh, uploaded once on
+     * the render thread when the type is first used, and its size is only a
+     * scale applied in the shader. So resizing a primitive changes a few floats,
+     * and all the primitives of a type can be drawn by one instanced call.
+     */
+    class PrimitiveRenderer : public Renderer {
+    protected:
+        void setScale(const common::Vector3<float>& scale);
+        virtual const common::Mesh<float>& unitMesh() const = 0;
+        // the unit mesh never changes, only the scale does
+        bool ringBuffered() const override { return false; }
+
+    public:
+        ~PrimitiveRenderer() override;
 
-        bool updateMesh(const common::Mesh<float>& mesh);
+        void init(int VAP_position, int VAP_normal) override;
+        void deinit() override;
     };
 
     /**
      * @brief Cube renderer
      */
-    class CubeRenderer : public Renderer {
+    class CubeRenderer : public PrimitiveRenderer {
     protected:
-        void loadCube(const common::Vector3<float>& size);
+        const common::Mesh<float>& unitMesh() const override;
 
     public:
         explicit CubeRenderer(const common::Vector3<float>& size, bool dynamic = false);
 
         int type() const override { return RenderType::R_CUBE; }
-        void render(bool line) override;
 
         bool updateCube(const common::Vector3<float>& size);
     };
 
-    class CylinderRenderer : public Renderer {
+    class CylinderRenderer : public PrimitiveRenderer {
     protected:
-        void loadCylinder(float radius, float height);
+        const common::Mesh<float>& unitMesh() const override;
 
     public:
         explicit CylinderRenderer(float radius, float height, bool dynamic = false);
 
         int type() const override { return RenderType::R_CYLINDER; }
-        void render(bool line) override;
 
         bool updateCylinder(float radius, float height);
     };
@@ -94,15 +368,14 @@ namespace simple_viewer {
     /**
      * @brief Cone renderer
      */
-    class ConeRenderer : public Renderer {
+    class ConeRenderer : public PrimitiveRenderer {
     protected:
-        void loadCone(float radius, float height);
+        const common::Mesh<float>& unitMesh() const override;
 
     public:
         explicit ConeRenderer(float radius, float height, bool dynamic = false);
 
         int type() const override { return RenderType::R_CONE; }
-        void render(bool line) override;
 
         bool updateCone(float radius, float height);
     };
@@ -110,15 +383,14 @@ namespace simple_viewer {
     /**
      * @brief Sphere renderer
      */
-    class SphereRenderer : public Renderer {
+    class SphereRenderer : public PrimitiveRenderer {
     protected:
-        void loadSphere(float radius);
+        const common::Mesh<float>& unitMesh() const override;
 
     public:
         explicit SphereRenderer(float radius, bool dynamic = false);
 
         int type() const override { return RenderType::R_SPHERE; }
-        void render(bool line) override;
 
         bool updateSphere(float radius);
     };
@@ -136,9 +408,9 @@ namespace simple_viewer {
         explicit LineRenderer(const std::vector<float>& points, bool dynamic = false);
 
         int type() const override { return RenderType::R_LINE; }
-        void render(bool line) override;
+        int draw(int instance_count) const override;
 
-        bool updateLine(const std::vector<float>& points);
+        bool updateLine(std::vector<float> points);
     };
 
     // TODO
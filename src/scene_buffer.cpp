@@ -0,0 +1,261 @@
+#include "scene_buffer.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+
+namespace simple_viewer {
+
+    CameraBuffer::CameraBuffer(): _ubo(0), _stride(0) {}
+
+    CameraBuffer::~CameraBuffer() {
+        deinit();
+    }
+
+    void CameraBuffer::init() {
+        if (_ubo != 0) return;
+        int alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        _stride = (int)sizeof(float) * 16;
+        _stride = (_stride + alignment - 1) / alignment * alignment;
+        glGenBuffers(1, &_ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+        glBufferData(GL_UNIFORM_BUFFER, _stride * MaxViews, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void CameraBuffer::deinit() {
+        if (_ubo == 0) return;
+        glDeleteBuffers(1, &_ubo); _ubo = 0;
+    }
+
+    void CameraBuffer::update(const common::Matrix4<float>* view_proj, int count) {
+        glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+        auto buf = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, _stride * count,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (buf != nullptr) {
+            // Eigen stores column-major, as std140 expects for a mat4
+            for (int i = 0; i < count; i++) {
+                std::copy(view_proj[i].data(), view_proj[i].data() + 16, (float*)(buf + _stride * i));
+            }
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void CameraBuffer::bind(int view, int binding) const {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, _ubo, _stride * view, sizeof(float) * 16);
+    }
+
+    ObjectBuffer::ObjectBuffer(): _tbo(0), _texture(0), _capacity(0) {}
+
+    ObjectBuffer::~ObjectBuffer() {
+        deinit();
+    }
+
+    void ObjectBuffer::init() {
+        if (_tbo != 0) return;
+        glGenBuffers(1, &_tbo);
+        glGenTextures(1, &_texture);
+        _capacity = 0;
+    }
+
+    void ObjectBuffer::deinit() {
+        if (_tbo == 0) return;
+        glDeleteTextures(1, &_texture); _texture = 0;
+        glDeleteBuffers(1, &_tbo); _tbo = 0;
+        _capacity = 0;
+    }
+
+    float* ObjectBuffer::map(size_t count) {
+        if (count == 0) count = 1;
+        auto size = (GLsizeiptr)(sizeof(float) * 4 * RecordSize * count);
+        glBindBuffer(GL_TEXTURE_BUFFER, _tbo);
+        if (count > _capacity) {
+            // grow geometrically, and (re)attach the storage to the texture. Respecified each frame, as the
+            // GLEW headers have no persistent mapping (GL 4.4)
+            _capacity = count * 3 / 2 + 64;
+            glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)(sizeof(float) * 4 * RecordSize * _capacity),
+                         nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, _texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _tbo);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+        return (float*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+
+    void ObjectBuffer::unmap() {
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void ObjectBuffer::bind(int texture_unit) const {
+        glActiveTexture(GL_TEXTURE0 + texture_unit);
+        glBindTexture(GL_TEXTURE_BUFFER, _texture);
+    }
+
+    void ObjectBuffer::writeRecord(float* record, const common::Transform<float>& transform,
+                                   const common::Vector3<float>& color, float ambient, float diffuse,
+                                   const common::Vector3<float>& scale,
+                                   const common::Vector3<float>& position_offset,
+                                   const common::Vector3<float>& position_scale) {
+        // the decoding folds into the origin and the scale
+        auto& basis = transform.getBasis();
+        common::Vector3<float> origin = transform.getOrigin() + basis * scale.cwiseProduct(position_offset);
+        common::Vector3<float> record_scale = scale.cwiseProduct(position_scale);
+        for (int i = 0; i < 3; i++) {
+            record[i * 4 + 0] = basis(0, i);
+            record[i * 4 + 1] = basis(1, i);
+            record[i * 4 + 2] = basis(2, i);
+            record[i * 4 + 3] = origin[i];
+        }
+        record[12] = color.x(); record[13] = color.y(); record[14] = color.z(); record[15] = ambient;
+        record[16] = record_scale.x(); record[17] = record_scale.y(); record[18] = record_scale.z();
+        record[19] = diffuse;
+    }
+
+    IdBuffer::IdBuffer(): _fbo(0), _color(0), _depth(0), _width(0), _height(0), _pbo(0), _read_fence(nullptr) {}
+
+    IdBuffer::~IdBuffer() {
+        deinit();
+    }
+
+    void IdBuffer::init(int width, int height) {
+        if (_fbo != 0 && width == _width && height == _height) return;
+        releaseTarget();
+        _width = width;
+        _height = height;
+        glGenFramebuffers(1, &_fbo);
+        glGenRenderbuffers(1, &_color);
+        glGenRenderbuffers(1, &_depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, _color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RG32UI, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, _depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depth);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void IdBuffer::deinit() {
+        releaseTarget();
+        cancelRead();
+    }
+
+    void IdBuffer::releaseTarget() {
+        if (_fbo == 0) return;
+        glDeleteFramebuffers(1, &_fbo); _fbo = 0;
+        glDeleteRenderbuffers(1, &_color); _color = 0;
+        glDeleteRenderbuffers(1, &_depth); _depth = 0;
+    }
+
+    void IdBuffer::bind() const {
+        static const GLuint empty[4] = { 0xffffffffu, 0xffffffffu, 0, 0 };
+        glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+        glClearBufferuiv(GL_COLOR, 0, empty);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    void IdBuffer::unbind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void IdBuffer::readAsync(const std::vector<std::pair<int, int>>& pixels) {
+        cancelRead();
+        _read_pixels = pixels;
+        // the ids of all the pixels, then their depths. With a pack buffer bound, glReadPixels only queues the copy
+        GLsizeiptr depth_offset = (GLsizeiptr)(sizeof(GLuint) * 2 * pixels.size());
+        glGenBuffers(1, &_pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, depth_offset + (GLsizeiptr)(sizeof(float) * pixels.size()), nullptr,
+                     GL_STREAM_READ);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, _fbo);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        for (size_t i = 0; i < pixels.size(); i++) {
+            int x = pixels[i].first, y = pixels[i].second;
+            if (x < 0 || y < 0 || x >= _width || y >= _height) {
+                // empty, whatever the size by the time it is mapped
+                _read_pixels[i].first = -1;
+                continue;
+            }
+            glReadPixels(x, y, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * 2 * i));
+            glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)(depth_offset + sizeof(float) * i));
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        _read_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool IdBuffer::readDone(std::vector<Pixel>& pixels) {
+        if (_read_fence == nullptr) return false;
+        auto status = glClientWaitSync((GLsync)_read_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+        size_t count = _read_pixels.size();
+        pixels.assign(count, { NoRecord, 0, 1 });
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbo);
+        auto data = (const char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                                  (GLsizeiptr)((sizeof(GLuint) * 2 + sizeof(float)) * count),
+                                                  GL_MAP_READ_BIT);
+        if (data != nullptr) {
+            auto ids = (const GLuint*)data;
+            auto depths = (const float*)(data + sizeof(GLuint) * 2 * count);
+            for (size_t i = 0; i < count; i++) {
+                if (_read_pixels[i].first < 0) continue;
+                pixels[i] = { ids[i * 2], ids[i * 2 + 1], depths[i] };
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        cancelRead();
+        return true;
+    }
+
+    void IdBuffer::cancelRead() {
+        if (_read_fence == nullptr) return;
+        glDeleteSync((GLsync)_read_fence);
+        glDeleteBuffers(1, &_pbo);
+        _read_fence = nullptr;
+        _pbo = 0;
+        _read_pixels.clear();
+    }
+
+
+    FrameFences::FrameFences(): _fences(), _frame(0) {}
+
+    FrameFences::~FrameFences() {
+        deinit();
+    }
+
+    void FrameFences::deinit() {
+        for (auto& fence : _fences) {
+            if (fence == nullptr) continue;
+            glDeleteSync((GLsync)fence);
+            fence = nullptr;
+        }
+        _frame = 0;
+    }
+
+    bool FrameFences::begin() {
+        auto& fence = _fences[_frame % Count];
+        if (fence == nullptr) return false;
+        auto sync = (GLsync)fence;
+        bool waited = glClientWaitSync(sync, 0, 0) == GL_TIMEOUT_EXPIRED;
+        if (waited) {
+            // flush once, so the fence is sure to be reached
+            GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            while (glClientWaitSync(sync, flags, 1000000000ull) == GL_TIMEOUT_EXPIRED) flags = 0;
+        }
+        glDeleteSync(sync);
+        fence = nullptr;
+        return waited;
+    }
+
+    void FrameFences::end() {
+        _fences[_frame % Count] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        _frame++;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include "common/transform.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief Uniform buffer holding the view-projection matrices of a frame
+     *
+     * Every view (e.g. the scene and the axis overlay) gets its own aligned
+     * range, all of them uploaded once per frame.
+     */
+    class CameraBuffer {
+    public:
+        static const int MaxViews = 2;
+
+        CameraBuffer();
+        CameraBuffer(const CameraBuffer& other) = delete;
+        ~CameraBuffer();
+
+        void init();
+        void deinit();
+        void update(const common::Matrix4<float>* view_proj, int count);
+        void bind(int view, int binding) const;
+
+    private:
+        unsigned int _ubo;
+        int _stride;
+    };
+
+    /**
+     * @brief Texture buffer holding one record per draw
+     *
+     * A record is RecordSize vec4s:
+     * (basis col0, origin.x) (basis col1, origin.y) (basis col2, origin.z)
+     * (color, ambient) (scale, diffuse)
+     * The vertex shader fetches the record of its draw id, so a draw only sets
+     * that id instead of uploading loose uniforms.
+     *
+     * A texture buffer rather than a shader storage buffer, which the shaders
+     * (#version 450) could use, because the bundled GLEW 1.8 headers stop at
+     * GL 4.2 and declare neither GL_SHADER_STORAGE_BUFFER nor buffer storage.
+     */
+    class ObjectBuffer {
+    public:
+        static const int RecordSize = 5;
+
+        ObjectBuffer();
+        ObjectBuffer(const ObjectBuffer& other) = delete;
+        ~ObjectBuffer();
+
+        void init();
+        void deinit();
+        // map storage for count records (previous content is discarded)
+        float* map(size_t count);
+        void unmap();
+        void bind(int texture_unit) const;
+
+        // positions are decoded as position_offset + position_scale * position before the scale
+        static void writeRecord(float* record, const common::Transform<float>& transform,
+                                const common::Vector3<float>& color, float ambient, float diffuse,
+                                const common::Vector3<float>& scale = common::Vector3<float>::Ones(),
+                                const common::Vector3<float>& position_offset = common::Vector3<float>::Zero(),
+                                const common::Vector3<float>& position_scale = common::Vector3<float>::Ones());
+
+    private:
+        unsigned int _tbo, _texture;
+        size_t _capacity;
+    };
+
+    /**
+     * @brief Offscreen target holding the (draw record, triangle) of every pixel
+     *
+     * Only rendered on demand. Its pixels are read into a pixel buffer behind a
+     * fence and mapped by a later frame, so reading them never stalls the
+     * pipeline.
+     */
+    class IdBuffer {
+    public:
+        // record is NoRecord where nothing was drawn, depth in [0, 1]
+        struct Pixel {
+            unsigned int record, triangle;
+            float depth;
+        };
+        static const unsigned int NoRecord = 0xffffffffu;
+
+        IdBuffer();
+        IdBuffer(const IdBuffer& other) = delete;
+        ~IdBuffer();
+
+        // (re)allocate for a window size, keeping a read in flight
+        void init(int width, int height);
+        void deinit();
+        // bind as the draw target, cleared to no record
+        void bind() const;
+        void unbind() const;
+        // start reading pixels (x, y) from the bottom-left, those outside being empty
+        void readAsync(const std::vector<std::pair<int, int>>& pixels);
+        // true once the read is done, with its pixels in order. Never waits for the gpu
+        bool readDone(std::vector<Pixel>& pixels);
+        bool reading() const { return _read_fence != nullptr; }
+
+    private:
+        void releaseTarget();
+        void cancelRead();
+
+        unsigned int _fbo, _color, _depth;
+        int _width, _height;
+        unsigned int _pbo;
+        void* _read_fence;
+        std::vector<std::pair<int, int>> _read_pixels;
+    };
+
+
+    /**
+     * @brief A fence after each of the last Count frames
+     *
+     * Waiting for the fence of the frame Count frames ago at the start of a
+     * frame bounds the frames in flight, so a buffer partition written that
+     * long ago is known to be no longer read by the gpu.
+     */
+    class FrameFences {
+    public:
+        static const int Count = 3;
+
+        FrameFences();
+        FrameFences(const FrameFences& other) = delete;
+        ~FrameFences();
+
+        void deinit();
+        // wait for the frame whose fence is reused, return true if the gpu was still on it
+        bool begin();
+        // fence the commands of the frame
+        void end();
+
+    private:
+        void* _fences[Count];
+        unsigned long long _frame;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
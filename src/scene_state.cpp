@@ -0,0 +1,89 @@
+#include "scene_state.h"
+
+#include <thread>
+
+namespace simple_viewer {
+
+    SceneState::SceneState(): _ticket(0), _applied(0), _coalesced(0) {} // NOLINT
+
+    unsigned int SceneState::lock(Slot& slot) {
+        unsigned int seq = slot.sequence.load(std::memory_order_relaxed);
+        while (true) {
+            if ((seq & 1) == 0 &&
+                slot.sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+                return seq;
+            }
+            std::this_thread::yield();
+            seq = slot.sequence.load(std::memory_order_relaxed);
+        }
+    }
+
+    void SceneState::reset(int handle, int type, const RenderState& state) {
+        auto& slot = _slots.grow(SlotMap<int>::indexOf(handle));
+        unsigned int seq = lock(slot);
+        slot.handle = handle;
+        slot.type = type;
+        slot.state = state;
+        auto t = ticket();
+        slot.tickets[0] = slot.tickets[1] = slot.tickets[2] = t;
+        slot.pending.store(1, std::memory_order_relaxed);
+        slot.sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    bool SceneState::write(int handle, int type, int fields, const RenderState& state,
+                           unsigned long long ticket) {
+        if (handle < 0) return false;
+        auto slot = _slots.at(SlotMap<int>::indexOf(handle));
+        if (slot == nullptr) return false;
+        unsigned int seq = lock(*slot);
+        if (slot->handle != handle || (type >= 0 && slot->type != type)) {
+            slot->sequence.store(seq, std::memory_order_release);
+            return false;
+        }
+        bool changed = false;
+        if ((fields & S_TRANSFORM) && ticket >= slot->tickets[0]) {
+            slot->state.transform = state.transform;
+            slot->tickets[0] = ticket;
+            changed = true;
+        }
+        if ((fields & S_COLOR) && ticket >= slot->tickets[1]) {
+            slot->state.color = state.color;
+            slot->tickets[1] = ticket;
+            changed = true;
+        }
+        if ((fields & S_VISIBLE) && ticket >= slot->tickets[2]) {
+            slot->state.visible = state.visible;
+            slot->tickets[2] = ticket;
+            changed = true;
+        }
+        if (changed) slot->pending.fetch_add(1, std::memory_order_relaxed);
+        slot->sequence.store(changed ? seq + 2 : seq, std::memory_order_release);
+        return true;
+    }
+
+    bool SceneState::read(int handle, RenderState& state) {
+        auto slot = _slots.at(SlotMap<int>::indexOf(handle));
+        if (slot == nullptr) return false;
+        unsigned int seq;
+        while (true) {
+            seq = slot->sequence.load(std::memory_order_acquire);
+            if (seq == slot->synced) return false;
+            if (seq & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            bool same = slot->handle == handle;
+            if (same) state = slot->state;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->sequence.load(std::memory_order_relaxed) != seq) continue;
+            if (!same) return false;
+            break;
+        }
+        slot->synced = seq;
+        auto writes = slot->pending.exchange(0, std::memory_order_relaxed);
+        _applied.fetch_add(1, std::memory_order_relaxed);
+        if (writes > 1) _coalesced.fetch_add(writes - 1, std::memory_order_relaxed);
+        return true;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include "common/transform.h"
+#include "paged_array.h"
+#include "slot_map.h"
+
+namespace simple_viewer {
+
+    // per-object render state
+    struct RenderState {
+        common::Transform<float> transform;
+        common::Vector3<float> color = {1, 1, 1};
+        bool visible = true;
+    };
+
+    /**
+     * @brief Seqlock-versioned render states of all objects, indexed by slot
+     *
+     * Producers write the state of an object in place, and the render thread
+     * copies a consistent snapshot of it at frame start, retrying while a write
+     * is in progress; neither side ever waits for the other to draw or update.
+     * Each slot remembers the handle (and type) it belongs to, so writes through
+     * a stale handle are dropped, and one ticket per field, so the latest issued
+     * write wins even if an older one (e.g. from a queued batch) lands later.
+     * Writes between two frames coalesce: only the last one is read.
+     */
+    class SceneState {
+    public:
+        enum Field {
+            S_TRANSFORM = 1,
+            S_COLOR = 2,
+            S_VISIBLE = 4
+        };
+
+        SceneState();
+        SceneState(const SceneState& other) = delete;
+
+        unsigned long long ticket() { return _ticket.fetch_add(1) + 1; }
+
+        //// thread-safe
+        void reset(int handle, int type, const RenderState& state);
+        bool write(int handle, int type, int fields, const RenderState& state, unsigned long long ticket);
+
+        //// render thread only
+        bool read(int handle, RenderState& state);
+
+        // writes read by the render thread / overwritten before being read
+        unsigned long long appliedCount() const { return _applied.load(std::memory_order_relaxed); }
+        unsigned long long coalescedCount() const { return _coalesced.load(std::memory_order_relaxed); }
+
+    private:
+        struct Slot {
+            std::atomic<unsigned int> sequence;
+            std::atomic<unsigned int> pending;  // writes since the last read
+            int handle = -1;
+            int type = 0;
+            unsigned long long tickets[3] = {0, 0, 0};
+            RenderState state;
+            unsigned int synced = 0;    // last sequence read by the render thread
+            Slot(): sequence(0), pending(0) {}
+        };
+
+        unsigned int lock(Slot& slot);
+
+        PagedArray<Slot, 10, SlotMap<int>::MaxSlots> _slots;
+        std::atomic<unsigned long long> _ticket;
+        std::atomic<unsigned long long> _applied;
+        std::atomic<unsigned long long> _coalesced;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -6,19 +6,18 @@
 "in VS_OUT {\n"\
 "    vec3 position;\n"\
 "    vec3 normal;\n"\
+"    flat vec3 color;\n"\
+"    flat vec2 light;\n"\
+"    flat uint record;\n"\
 "} fs_in;\n"\
 "\n"\
 "out vec4 FragColor;\n"\
 "\n"\
 "\n"\
-"uniform float gAmbientIntensity;\n"\
-"uniform float gDiffuseIntensity;\n"\
 "uniform vec3 gLightDirection;\n"\
-"uniform vec3 gColor;\n"\
 "\n"\
 "void main() {\n"\
-"    vec3 ambient = gColor * gAmbientIntensity;\n"\
-"    vec3 diffuse = gColor * gDiffuseIntensity * clamp(dot(fs_in.normal, -gLightDirection), 0, 1);\n"\
+"    vec3 ambient = fs_in.color * fs_in.light.x;\n"\
+"    vec3 diffuse = fs_in.color * fs_in.light.y * clamp(dot(fs_in.normal, -gLightDirection), 0, 1);\n"\
 "    FragColor = vec4(ambient + diffuse, 1.0f);\n"\
-"    //FragColor = vec4(gColor, 1.0f);\n"\
 "}"
@@ -0,0 +1,22 @@
+#pragma once
+
+// writes the draw record and triangle of every pixel, for picking
+#define shader_id_frag \
+"#version 450\n"\
+"\n"\
+"in VS_OUT {\n"\
+"    vec3 position;\n"\
+"    vec3 normal;\n"\
+"    flat vec3 color;\n"\
+"    flat vec2 light;\n"\
+"    flat uint record;\n"\
+"} fs_in;\n"\
+"\n"\
+"// first triangle of the chunk drawn\n"\
+"uniform int gTriangleOffset;\n"\
+"\n"\
+"out uvec2 FragId;\n"\
+"\n"\
+"void main() {\n"\
+"    FragId = uvec2(fs_in.record, uint(gl_PrimitiveID + gTriangleOffset));\n"\
+"}\n"
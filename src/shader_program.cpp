@@ -2,11 +2,13 @@
 
 #include <GL/glew.h>
 #include <iostream>
+#include <cstring>
 #include "common/general.h"
 
 namespace simple_viewer {
 
-    ShaderProgram::ShaderProgram(const char* vert_path, const char* frag_path) {
+    ShaderProgram::ShaderProgram(const char* vert_path, const char* frag_path):
+            _vao(0), _polygon_mode(0), _line_width(0), _issued(0), _elided(0) {
         _program_id = glCreateProgram();
 
         int vert_id = createShader(vert_path, GL_VERTEX_SHADER);
@@ -18,6 +20,8 @@ namespace simple_viewer {
         glDeleteShader(frag_id);
 
         linkProgramAndCheck(_program_id);
+        loadUniforms();
+        resetState();
     }
 
     ShaderProgram::~ShaderProgram() {
@@ -55,32 +59,132 @@ namespace simple_viewer {
         }
     }
 
+    void ShaderProgram::loadUniforms() {
+        int count = 0;
+        glGetProgramiv(_program_id, GL_ACTIVE_UNIFORMS, &count);
+        char name[256];
+        for (int i = 0; i < count; i++) {
+            int size; GLenum type;
+            glGetActiveUniform(_program_id, i, sizeof(name), nullptr, &size, &type, name);
+            // register every element of an array as "name[i]"
+            std::string base(name);
+            auto bracket = base.find('[');
+            if (bracket != std::string::npos) base.resize(bracket);
+            for (int j = 0; j < size; j++) {
+                auto full = size > 1 ? base + "[" + std::to_string(j) + "]" : base;
+                int location = glGetUniformLocation(_program_id, full.c_str());
+                if (location >= 0) _uniforms.push_back({ full, location, 0, {} });
+            }
+        }
+    }
+
+    bool ShaderProgram::changed(int uniform, const float* value, int size) {
+        if (uniform < 0) return false;
+        auto& u = _uniforms[uniform];
+        if (u.size == size && std::memcmp(u.value, value, sizeof(float) * size) == 0) {
+            _elided++;
+            return false;
+        }
+        u.size = size;
+        std::memcpy(u.value, value, sizeof(float) * size);
+        _issued++;
+        return true;
+    }
+
     void ShaderProgram::use() const {
         glUseProgram(_program_id);
     }
 
-    void ShaderProgram::setBool(const char* name, bool value) const {
-        glUniform1i(glGetUniformLocation(_program_id, name), (int)value);
+    int ShaderProgram::uniform(const char* name) const {
+        for (int i = 0; i < (int)_uniforms.size(); i++) {
+            if (std::strcmp(_uniforms[i].name.c_str(), name) == 0) return i;
+        }
+        return -1;
+    }
+
+    void ShaderProgram::bindUniformBlock(const char* name, int binding) const {
+        auto index = glGetUniformBlockIndex(_program_id, name);
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(_program_id, index, binding);
+    }
+
+    void ShaderProgram::setBool(const char* name, bool value) {
+        setInt(uniform(name), (int)value);
+    }
+
+    void ShaderProgram::setInt(const char* name, int value) {
+        setInt(uniform(name), value);
+    }
+
+    void ShaderProgram::setFloat(const char* name, float value) {
+        setFloat(uniform(name), value);
     }
 
-    void ShaderProgram::setInt(const char* name, int value) const {
-        glUniform1i(glGetUniformLocation(_program_id, name), value);
+    void ShaderProgram::setVec3(const char* name, const common::Vector3<float>& value) {
+        setVec3(uniform(name), value);
     }
 
-    void ShaderProgram::setFloat(const char* name, float value) const {
-        glUniform1f(glGetUniformLocation(_program_id, name), value);
+    void ShaderProgram::setMat3(const char* name, const common::Matrix3<float>& value) {
+        setMat3(uniform(name), value);
     }
 
-    void ShaderProgram::setVec3(const char* name, const common::Vector3<float>& value) const {
-        glUniform3f(glGetUniformLocation(_program_id, name), value.x(), value.y(), value.z());
+    void ShaderProgram::setInt(int uniform, int value) {
+        // the bits of the int, as a conversion would make the ones above 2^24 compare equal
+        float buf;
+        std::memcpy(&buf, &value, sizeof(buf));
+        if (!changed(uniform, &buf, 1)) return;
+        glUniform1i(_uniforms[uniform].location, value);
+    }
+
+    void ShaderProgram::setFloat(int uniform, float value) {
+        if (!changed(uniform, &value, 1)) return;
+        glUniform1f(_uniforms[uniform].location, value);
+    }
+
+    void ShaderProgram::setVec3(int uniform, const common::Vector3<float>& value) {
+        if (!changed(uniform, value.data(), 3)) return;
+        glUniform3f(_uniforms[uniform].location, value.x(), value.y(), value.z());
+    }
+
+    void ShaderProgram::setMat3(int uniform, const common::Matrix3<float>& value) {
+        // Eigen stores column-major, as gl expects
+        if (!changed(uniform, value.data(), 9)) return;
+        glUniformMatrix3fv(_uniforms[uniform].location, 1, GL_FALSE, value.data());
+    }
+
+    void ShaderProgram::bindVertexArray(unsigned int vao) {
+        if (vao == _vao) {
+            _elided++;
+            return;
+        }
+        _vao = vao;
+        _issued++;
+        glBindVertexArray(vao);
+    }
+
+    void ShaderProgram::setPolygonMode(int mode) {
+        if (mode == _polygon_mode) {
+            _elided++;
+            return;
+        }
+        _polygon_mode = mode;
+        _issued++;
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+
+    void ShaderProgram::setLineWidth(float width) {
+        if (width == _line_width) {
+            _elided++;
+            return;
+        }
+        _line_width = width;
+        _issued++;
+        glLineWidth(width);
     }
 
-    void ShaderProgram::setMat3(const char* name, const common::Matrix3<float>& value) const {
-        static float buf[9];
-        buf[0] = value(0, 0); buf[1] = value(1, 0); buf[2] = value(2, 0);
-        buf[3] = value(0, 1); buf[4] = value(1, 1); buf[5] = value(2, 1);
-        buf[6] = value(0, 2); buf[7] = value(1, 2); buf[8] = value(2, 2);
-        glUniformMatrix3fv(glGetUniformLocation(_program_id, name), 1, GL_FALSE, buf);
+    void ShaderProgram::resetState() {
+        _vao = (unsigned int)-1;
+        _polygon_mode = -1;
+        _line_width = -1;
     }
 
 } // namespace simple_viewer
\ No newline at end of file
@@ -1,28 +1,69 @@
 #pragma once
 
+#include <string>
+#include <vector>
 #include "common/general.h"
 
 namespace simple_viewer {
 
+    /**
+     * @brief Shader program with a uniform table resolved at link time
+     *
+     * The current value of each uniform, the bound vertex array, the polygon
+     * mode and the line width are shadowed, so calls that would not change
+     * anything are skipped (and counted).
+     */
     class ShaderProgram {
     private:
+        struct Uniform {
+            std::string name;
+            int location;
+            int size;           // floats (or ints, as their bits) shadowed, 0 if nothing is set yet
+            float value[9];
+        };
+
         int _program_id;
+        std::vector<Uniform> _uniforms;
+        unsigned int _vao;
+        int _polygon_mode;
+        float _line_width;
+        unsigned long long _issued;
+        unsigned long long _elided;
 
         static int createShader(const char* buf, int type);
         static void compileShaderAndCheck(int shader);
         static void linkProgramAndCheck(int program);
 
+        void loadUniforms();
+        bool changed(int uniform, const float* value, int size);
+
     public:
         ShaderProgram(const char* vert_path, const char* frag_path);
         ~ShaderProgram();
 
         void use() const;
+        int uniform(const char* name) const;
+        void bindUniformBlock(const char* name, int binding) const;
+
+        void setBool(const char* name, bool value);
+        void setInt(const char* name, int value);
+        void setFloat(const char* name, float value);
+        void setVec3(const char* name, const common::Vector3<float>& value);
+        void setMat3(const char* name, const common::Matrix3<float>& value);
+        void setInt(int uniform, int value);
+        void setFloat(int uniform, float value);
+        void setVec3(int uniform, const common::Vector3<float>& value);
+        void setMat3(int uniform, const common::Matrix3<float>& value);
+
+        void bindVertexArray(unsigned int vao);
+        void setPolygonMode(int mode);
+        void setLineWidth(float width);
+        // forget the shadowed gl state, after it was changed behind our back
+        void resetState();
 
-        void setBool(const char* name, bool value) const;
-        void setInt(const char* name, int value) const;
-        void setFloat(const char* name, float value) const;
-        void setVec3(const char* name, const common::Vector3<float>& value) const;
-        void setMat3(const char* name, const common::Matrix3<float>& value) const;
+        unsigned long long issuedCount() const { return _issued; }
+        unsigned long long elidedCount() const { return _elided; }
+        void resetCounters() { _issued = _elided = 0; }
     };
 
 } // namespace simple_viewer
\ No newline at end of file
@@ -3,27 +3,50 @@
 #define shader_vert \
 "#version 450\n"\
 "\n"\
-"layout (location = 1) in vec3 gPosition;\n"\
+"// the 4th component tells the vertex format, see MeshRenderer\n"\
+"layout (location = 1) in vec4 gPosition;\n"\
 "layout (location = 2) in vec3 gNormal;\n"\
+"layout (location = 3) in uint gDrawId;\n"\
 "\n"\
 "out VS_OUT {\n"\
 "    vec3 position;\n"\
 "    vec3 normal;\n"\
+"    flat vec3 color;\n"\
+"    flat vec2 light;\n"\
+"    flat uint record;\n"\
 "} vs_out;\n"\
 "\n"\
-"uniform mat3 gWorldBasis;\n"\
-"uniform vec3 gWorldOrigin;\n"\
-"uniform mat3 gCameraBasis;\n"\
-"uniform vec3 gCameraOrigin;\n"\
-"uniform vec3 gScreenOffset;\n"\
-"uniform float gProj[4];\n"\
+"layout (std140) uniform Camera {\n"\
+"    mat4 gViewProj;\n"\
+"};\n"\
+"uniform samplerBuffer gObjects;\n"\
+"\n"\
+"vec3 decodeOctahedral(vec2 e) {\n"\
+"    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"\
+"    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"\
+"    return n;\n"\
+"}\n"\
+"\n"\
+"vec3 vertexNormal() {\n"\
+"    if (gPosition.w == 1.0) return gNormal;\n"\
+"    if (gPosition.w == 0.0) return decodeOctahedral(gNormal.xy);\n"\
+"    uint bits = uint(gPosition.w * 65535.0 + 0.5);\n"\
+"    return decodeOctahedral((vec2(bits & 255u, bits >> 8) - 128.0) / 126.0);\n"\
+"}\n"\
 "\n"\
 "void main() {\n"\
-"    vec3 worldPos = gWorldBasis * gPosition + gWorldOrigin;\n"\
+"    int record = (int(gDrawId) + gl_InstanceID) * 5;\n"\
+"    vec4 r0 = texelFetch(gObjects, record);\n"\
+"    vec4 r1 = texelFetch(gObjects, record + 1);\n"\
+"    vec4 r2 = texelFetch(gObjects, record + 2);\n"\
+"    vec4 r3 = texelFetch(gObjects, record + 3);\n"\
+"    vec4 r4 = texelFetch(gObjects, record + 4);\n"\
+"    mat3 basis = mat3(r0.xyz, r1.xyz, r2.xyz);\n"\
+"    vec3 worldPos = basis * (r4.xyz * gPosition.xyz) + vec3(r0.w, r1.w, r2.w);\n"\
 "    vs_out.position = worldPos;\n"\
-"    vs_out.normal = normalize(gWorldBasis * gNormal);\n"\
-"    vec3 cameraPos = transpose(gCameraBasis) * (worldPos - gCameraOrigin);\n"\
-"    gl_Position = vec4(gProj[0] * cameraPos.x, gProj[1] * cameraPos.y,\n"\
-"                       gProj[2] * cameraPos.z + gProj[3], -cameraPos.z);\n"\
-"    gl_Position.xyz -= (gScreenOffset * cameraPos.z);\n"\
+"    vs_out.normal = normalize(basis * (vertexNormal() / r4.xyz));\n"\
+"    vs_out.color = r3.xyz;\n"\
+"    vs_out.light = vec2(r3.w, r4.w);\n"\
+"    vs_out.record = uint(int(gDrawId) + gl_InstanceID);\n"\
+"    gl_Position = gViewProj * vec4(worldPos, 1.0);\n"\
 "}\n"
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include "paged_array.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief A generational slot map with O(1) insertion, lookup and deletion
+     *
+     * A handle encodes the slot index (low bits) and the slot generation (high
+     * bits). The generation is bumped whenever a handle is retired, so a stale
+     * handle is never confused with the object that later reuses its slot.
+     *
+     * Handles are reserved/retired by any thread (reserve() takes a short lock,
+     * alive() is lock-free), while the values are owned by a single consumer
+     * thread, which keeps them in a dense array and erases by swapping with the
+     * last one.
+     */
+    template <typename T>
+    class SlotMap {
+    public:
+        static const int IndexBits = 20;
+        static const int GenerationBits = 11;
+        static const uint32_t MaxSlots = 1u << IndexBits;
+
+        SlotMap();
+        SlotMap(const SlotMap& other) = delete;
+
+        //// thread-safe
+        int reserve();
+        void release(int handle);
+        bool retire(int handle);
+        bool alive(int handle) const;
+
+        //// consumer thread only
+        void insert(int handle, const T& value);
+        T* find(int handle);
+        T erase(int handle);
+        size_t size() const { return _dense.size(); }
+        T& valueAt(size_t i) { return _dense[i]; }
+        int handleAt(size_t i) const { return _dense_handles[i]; }
+
+        static uint32_t indexOf(int handle) { return (uint32_t)handle & (MaxSlots - 1); }
+        static uint32_t generationOf(int handle) { return (uint32_t)handle >> IndexBits; }
+
+    private:
+        static const uint32_t GenerationMask = (1u << GenerationBits) - 1;
+
+        static int makeHandle(uint32_t index, uint32_t gen) { return (int)((gen << IndexBits) | index); }
+        void recycle(int handle);
+
+        PagedArray<std::atomic<uint32_t>, 12, MaxSlots> _generations;
+        std::atomic<uint32_t> _slot_count;
+        std::mutex _mutex;
+        std::vector<uint32_t> _free;
+
+        // consumer-owned dense storage
+        std::vector<T> _dense;
+        std::vector<int> _dense_handles;
+        std::vector<uint32_t> _sparse;
+    };
+
+    template <typename T>
+    SlotMap<T>::SlotMap(): _slot_count(0) {} // NOLINT
+
+    template <typename T>
+    int SlotMap<T>::reserve() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        uint32_t index;
+        if (!_free.empty()) {
+            index = _free.back();
+            _free.pop_back();
+        } else {
+            index = _slot_count.load(std::memory_order_relaxed);
+            if (index >= MaxSlots) return -1;
+            _generations.grow(index);
+            _slot_count.store(index + 1, std::memory_order_release);
+        }
+        return makeHandle(index, _generations.at(index)->load(std::memory_order_relaxed));
+    }
+
+    template <typename T>
+    void SlotMap<T>::recycle(int handle) {
+        uint32_t index = indexOf(handle);
+        std::unique_lock<std::mutex> lock(_mutex);
+        retire(handle);
+        _free.push_back(index);
+    }
+
+    template <typename T>
+    void SlotMap<T>::release(int handle) {
+        if (handle >= 0) recycle(handle);
+    }
+
+    template <typename T>
+    bool SlotMap<T>::retire(int handle) {
+        if (!alive(handle)) return false;
+        auto gen = generationOf(handle);
+        return _generations.at(indexOf(handle))->compare_exchange_strong(gen, (gen + 1) & GenerationMask);
+    }
+
+    template <typename T>
+    bool SlotMap<T>::alive(int handle) const {
+        if (handle < 0) return false;
+        uint32_t index = indexOf(handle);
+        if (index >= _slot_count.load(std::memory_order_acquire)) return false;
+        return _generations.at(index)->load(std::memory_order_acquire) == generationOf(handle);
+    }
+
+    template <typename T>
+    void SlotMap<T>::insert(int handle, const T& value) {
+        uint32_t index = indexOf(handle);
+        if (index >= _sparse.size()) _sparse.resize(index + 1, (uint32_t)-1);
+        _sparse[index] = (uint32_t)_dense.size();
+        _dense.push_back(value);
+        _dense_handles.push_back(handle);
+    }
+
+    template <typename T>
+    T* SlotMap<T>::find(int handle) {
+        if (handle < 0) return nullptr;
+        uint32_t index = indexOf(handle);
+        if (index >= _sparse.size() || _sparse[index] >= _dense.size()) return nullptr;
+        uint32_t pos = _sparse[index];
+        return _dense_handles[pos] == handle ? &_dense[pos] : nullptr;
+    }
+
+    template <typename T>
+    T SlotMap<T>::erase(int handle) {
+        uint32_t index = indexOf(handle);
+        uint32_t pos = _sparse[index];
+        T value = _dense[pos];
+        uint32_t last = (uint32_t)_dense.size() - 1;
+        if (pos != last) {
+            _dense[pos] = _dense[last];
+            _dense_handles[pos] = _dense_handles[last];
+            _sparse[indexOf(_dense_handles[pos])] = pos;
+        }
+        _dense.pop_back();
+        _dense_handles.pop_back();
+        _sparse[index] = (uint32_t)-1;
+        recycle(handle);
+        return value;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
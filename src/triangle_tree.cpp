@@ -0,0 +1,320 @@
+#include "triangle_tree.h"
+
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+
+namespace simple_viewer {
+
+    TriangleTree::TriangleTree(const float* vertices, size_t vertex_count, size_t stride,
+                               const unsigned int* indices, size_t triangle_count):
+            _vertex_count(vertex_count), _triangle_count(triangle_count),
+            _positions(vertex_count * 3), _indices(indices, indices + triangle_count * 3) {
+        for (size_t i = 0; i < vertex_count; i++) {
+            std::copy(vertices + i * stride, vertices + i * stride + 3, &_positions[i * 3]);
+        }
+    }
+
+    TriangleTree::TriangleTree(std::vector<float> positions, std::vector<unsigned int> indices):
+            _vertex_count(positions.size() / 3), _triangle_count(indices.size() / 3),
+            _positions(std::move(positions)), _indices(std::move(indices)) {}
+
+    std::shared_ptr<TriangleTree> TriangleTree::fromMesh(const common::Mesh<float>& mesh) {
+        std::vector<float> vertices;
+        vertices.reserve(mesh.vertices.size() * 3);
+        for (auto& v : mesh.vertices) {
+            vertices.insert(vertices.end(), v.position.data(), v.position.data() + 3);
+        }
+        std::vector<unsigned int> indices;
+        for (auto& f : mesh.faces) {
+            for (size_t j = 1; j + 1 < f.indices.size(); j++) {
+                indices.push_back(f.indices[0]);
+                indices.push_back(f.indices[j]);
+                indices.push_back(f.indices[j + 1]);
+            }
+        }
+        return std::make_shared<TriangleTree>(vertices.data(), mesh.vertices.size(), 3,
+                                              indices.data(), indices.size() / 3);
+    }
+
+    bool TriangleTree::sameTriangles(const unsigned int* indices, size_t triangle_count) const {
+        std::shared_lock<std::shared_timed_mutex> lock(_mutex);
+        return !_released && triangle_count == _triangle_count &&
+               std::equal(_indices.begin(), _indices.end(), indices);
+    }
+
+    void TriangleTree::updatePositions(size_t first, size_t count, const float* positions) {
+        std::unique_lock<std::shared_timed_mutex> lock(_mutex);
+        std::copy(positions, positions + count * 3, &_positions[first * 3]);
+        _stale = true;
+    }
+
+    void TriangleTree::copyPositions(std::vector<float>& positions) const {
+        std::shared_lock<std::shared_timed_mutex> lock(_mutex);
+        positions = _positions;
+    }
+
+    void TriangleTree::release(int policy) {
+        std::unique_lock<std::shared_timed_mutex> lock(_mutex);
+        if (_released) return;
+        if (policy == C_COMPRESSED || policy == C_DISK) {
+            std::vector<unsigned char> positions(_positions.size() * sizeof(float));
+            std::vector<unsigned char> indices(_indices.size() * sizeof(unsigned int));
+            if (!positions.empty()) std::memcpy(positions.data(), _positions.data(), positions.size());
+            if (!indices.empty()) std::memcpy(indices.data(), _indices.data(), indices.size());
+            _cache.reset(new GeometryCache(policy, std::move(positions), sizeof(float) * 3, sizeof(float),
+                                           std::move(indices), sizeof(unsigned int)));
+        }
+        std::vector<float>().swap(_positions);
+        std::vector<unsigned int>().swap(_indices);
+        std::vector<Node>().swap(_nodes);
+        std::vector<unsigned int>().swap(_order);
+        _built = false;
+        _stale = false;
+        _released = true;
+    }
+
+    void TriangleTree::reload(std::vector<float> positions, std::vector<unsigned int> indices) {
+        std::unique_lock<std::shared_timed_mutex> lock(_mutex);
+        if (!_released) return;
+        _positions = std::move(positions);
+        _indices = std::move(indices);
+        _cache = nullptr;
+        _released = false;
+        _wanted = false;
+    }
+
+    bool TriangleTree::load() const {
+        if (!_released) return true;
+        std::vector<unsigned char> positions, indices;
+        if (!_cache || !_cache->load(positions, indices)) {
+            // lost with its temporary file, the owner gives the arrays back instead
+            _cache = nullptr;
+            return false;
+        }
+        _positions.resize(positions.size() / sizeof(float));
+        _indices.resize(indices.size() / sizeof(unsigned int));
+        if (!positions.empty()) std::memcpy(_positions.data(), positions.data(), positions.size());
+        if (!indices.empty()) std::memcpy(_indices.data(), indices.data(), indices.size());
+        _cache = nullptr;
+        _released = false;
+        return true;
+    }
+
+    size_t TriangleTree::residentBytes() const {
+        std::shared_lock<std::shared_timed_mutex> lock(_mutex);
+        return _positions.capacity() * sizeof(float) + _indices.capacity() * sizeof(unsigned int) +
+               _nodes.capacity() * sizeof(Node) + _order.capacity() * sizeof(unsigned int) +
+               (_cache ? _cache->residentBytes() : 0);
+    }
+
+    void TriangleTree::build() const {
+        size_t count = triangleCount();
+        _order.resize(count);
+        _nodes.clear();
+        if (count == 0) return;
+
+        // triangle boxes and centroids
+        std::vector<common::Vector3<float>> mins(count), maxs(count), centers(count);
+        for (size_t i = 0; i < count; i++) {
+            Eigen::Map<const common::Vector3<float>> a(&_positions[_indices[i * 3] * 3]);
+            Eigen::Map<const common::Vector3<float>> b(&_positions[_indices[i * 3 + 1] * 3]);
+            Eigen::Map<const common::Vector3<float>> c(&_positions[_indices[i * 3 + 2] * 3]);
+            mins[i] = a.cwiseMin(b).cwiseMin(c);
+            maxs[i] = a.cwiseMax(b).cwiseMax(c);
+            centers[i] = (mins[i] + maxs[i]) * 0.5f;
+            _order[i] = (unsigned int)i;
+        }
+
+        auto area = [](const common::Vector3<float>& min, const common::Vector3<float>& max) {
+            common::Vector3<float> d = (max - min).cwiseMax(0);
+            return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+        };
+
+        // split with a binned surface area heuristic, leaves of at most LeafSize triangles
+        const int BinCount = 16;
+        const unsigned int LeafSize = 4;
+        _nodes.reserve(count * 2 / LeafSize + 1);
+        const common::Vector3<float> zero = common::Vector3<float>::Zero();
+        _nodes.push_back({ zero, zero, 0, (unsigned int)count });
+        std::vector<unsigned int> stack = { 0 };
+        while (!stack.empty()) {
+            unsigned int node = stack.back();
+            stack.pop_back();
+            unsigned int first = _nodes[node].first, n = _nodes[node].count;
+            common::Vector3<float> min = mins[_order[first]], max = maxs[_order[first]];
+            common::Vector3<float> cmin = centers[_order[first]], cmax = cmin;
+            for (unsigned int i = first + 1; i < first + n; i++) {
+                min = min.cwiseMin(mins[_order[i]]);
+                max = max.cwiseMax(maxs[_order[i]]);
+                cmin = cmin.cwiseMin(centers[_order[i]]);
+                cmax = cmax.cwiseMax(centers[_order[i]]);
+            }
+            _nodes[node].min = min;
+            _nodes[node].max = max;
+            if (n <= LeafSize) continue;
+
+            int axis;
+            float extent = (cmax - cmin).maxCoeff(&axis);
+            unsigned int mid = first + n / 2;
+            if (extent > 0) {
+                struct Bin { common::Vector3<float> min, max; unsigned int count = 0; } bins[BinCount];
+                auto binOf = [&](unsigned int t) {
+                    return std::min((int)((centers[t][axis] - cmin[axis]) / extent * BinCount), BinCount - 1);
+                };
+                for (unsigned int i = first; i < first + n; i++) {
+                    auto t = _order[i];
+                    auto& bin = bins[binOf(t)];
+                    bin.min = bin.count ? bin.min.cwiseMin(mins[t]) : mins[t];
+                    bin.max = bin.count ? bin.max.cwiseMax(maxs[t]) : maxs[t];
+                    bin.count++;
+                }
+                float right_cost[BinCount];
+                common::Vector3<float> rmin, rmax;
+                unsigned int right = 0;
+                for (int i = BinCount - 1; i > 0; i--) {
+                    if (bins[i].count) {
+                        rmin = right ? rmin.cwiseMin(bins[i].min) : bins[i].min;
+                        rmax = right ? rmax.cwiseMax(bins[i].max) : bins[i].max;
+                        right += bins[i].count;
+                    }
+                    right_cost[i] = right ? area(rmin, rmax) * right : 0;
+                }
+                common::Vector3<float> lmin, lmax;
+                unsigned int left = 0;
+                float best = std::numeric_limits<float>::max();
+                int split = -1;
+                for (int i = 0; i < BinCount - 1; i++) {
+                    if (bins[i].count) {
+                        lmin = left ? lmin.cwiseMin(bins[i].min) : bins[i].min;
+                        lmax = left ? lmax.cwiseMax(bins[i].max) : bins[i].max;
+                        left += bins[i].count;
+                    }
+                    if (left == 0 || left == n) continue;
+                    float cost = area(lmin, lmax) * left + right_cost[i + 1];
+                    if (cost < best) {
+                        best = cost;
+                        split = i;
+                    }
+                }
+                if (split >= 0) {
+                    auto it = std::partition(_order.begin() + first, _order.begin() + first + n,
+                                             [&](unsigned int t) { return binOf(t) <= split; });
+                    mid = (unsigned int)(it - _order.begin());
+                }
+            }
+
+            auto children = (unsigned int)_nodes.size();
+            _nodes[node].first = children;
+            _nodes[node].count = 0;
+            // bounded by the loop when popped
+            _nodes.push_back({ zero, zero, first, mid - first });
+            _nodes.push_back({ zero, zero, mid, first + n - mid });
+            stack.push_back(children);
+            stack.push_back(children + 1);
+        }
+    }
+
+    void TriangleTree::refit() const {
+        for (size_t i = _nodes.size(); i-- > 0;) {
+            auto& node = _nodes[i];
+            if (node.count == 0) {
+                node.min = _nodes[node.first].min.cwiseMin(_nodes[node.first + 1].min);
+                node.max = _nodes[node.first].max.cwiseMax(_nodes[node.first + 1].max);
+                continue;
+            }
+            for (unsigned int j = node.first; j < node.first + node.count; j++) {
+                for (int k = 0; k < 3; k++) {
+                    Eigen::Map<const common::Vector3<float>> p(&_positions[_indices[_order[j] * 3 + k] * 3]);
+                    node.min = j == node.first && k == 0 ? common::Vector3<float>(p) : node.min.cwiseMin(p);
+                    node.max = j == node.first && k == 0 ? common::Vector3<float>(p) : node.max.cwiseMax(p);
+                }
+            }
+        }
+    }
+
+    bool TriangleTree::raycast(const common::Vector3<float>& origin, const common::Vector3<float>& direction,
+                               float max_t, Hit& hit) const {
+        std::shared_lock<std::shared_timed_mutex> lock(_mutex);
+        while (!_built || _stale) {
+            lock.unlock();
+            {
+                std::unique_lock<std::shared_timed_mutex> update(_mutex);
+                if (!load()) {
+                    _wanted = true;
+                    return false;
+                }
+                if (!_built) {
+                    build();
+                } else if (_stale) {
+                    refit();
+                }
+                _built = true;
+                _stale = false;
+            }
+            lock.lock();
+        }
+        if (_nodes.empty()) return false;
+
+        common::Vector3<float> inv_dir = direction.cwiseInverse();
+        auto enter = [&](const Node& node, float limit) {
+            common::Vector3<float> t0 = (node.min - origin).cwiseProduct(inv_dir);
+            common::Vector3<float> t1 = (node.max - origin).cwiseProduct(inv_dir);
+            float near = std::max(t0.cwiseMin(t1).maxCoeff(), 0.f);
+            float far = std::min(t0.cwiseMax(t1).minCoeff(), limit);
+            return near <= far ? near : -1.f;
+        };
+
+        hit.t = max_t;
+        hit.triangle = -1;
+        std::vector<unsigned int> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        while (!stack.empty()) {
+            auto& node = _nodes[stack.back()];
+            stack.pop_back();
+            if (enter(node, hit.t) < 0) continue;
+            if (node.count > 0) {
+                // Moller-Trumbore
+                for (unsigned int i = node.first; i < node.first + node.count; i++) {
+                    auto t = _order[i];
+                    Eigen::Map<const common::Vector3<float>> a(&_positions[_indices[t * 3] * 3]);
+                    Eigen::Map<const common::Vector3<float>> b(&_positions[_indices[t * 3 + 1] * 3]);
+                    Eigen::Map<const common::Vector3<float>> c(&_positions[_indices[t * 3 + 2] * 3]);
+                    common::Vector3<float> e1 = b - a, e2 = c - a;
+                    common::Vector3<float> p = direction.cross(e2);
+                    float det = e1.dot(p);
+                    if (std::abs(det) < 1e-12f) continue;
+                    float inv_det = 1 / det;
+                    common::Vector3<float> s = origin - a;
+                    float u = s.dot(p) * inv_det;
+                    if (u < 0 || u > 1) continue;
+                    common::Vector3<float> q = s.cross(e1);
+                    float v = direction.dot(q) * inv_det;
+                    if (v < 0 || u + v > 1) continue;
+                    float d = e2.dot(q) * inv_det;
+                    if (d >= 0 && d < hit.t) {
+                        hit.t = d;
+                        hit.triangle = (int)t;
+                    }
+                }
+                continue;
+            }
+            // push the farther child first, so the nearer one is visited first
+            float t0 = enter(_nodes[node.first], hit.t);
+            float t1 = enter(_nodes[node.first + 1], hit.t);
+            if (t0 >= 0 && t1 >= 0) {
+                bool near_first = t0 <= t1;
+                stack.push_back(node.first + (near_first ? 1 : 0));
+                stack.push_back(node.first + (near_first ? 0 : 1));
+            } else if (t0 >= 0) {
+                stack.push_back(node.first);
+            } else if (t1 >= 0) {
+                stack.push_back(node.first + 1);
+            }
+        }
+        return hit.triangle >= 0;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+#include "common/mesh.h"
+#include "common/transform.h"
+#include "geometry_cache.h"
+
+namespace simple_viewer {
+
+    /**
+     * @brief Bounding volume hierarchy over the triangles of one geometry, for ray queries
+     *
+     * It keeps its own copy of the positions and indices, and the hierarchy
+     * is only built by the first query, so an unqueried tree costs a copy.
+     * Moved vertices only refit the boxes of the hierarchy, on the next query.
+     * The tree of released geometry follows its CachePolicy: it keeps its
+     * arrays in a GeometryCache, loaded again by the next query, or drops them
+     * entirely (C_MEMORY) and misses until its owner gives them back.
+     * Queries and updates are thread-safe.
+     */
+    class TriangleTree {
+    public:
+        struct Hit {
+            float t;            // ray parameter, hit point = origin + t * direction
+            int triangle;       // index of the triangle in the indices
+        };
+
+        // vertex positions are the first 3 floats of every stride
+        TriangleTree(const float* vertices, size_t vertex_count, size_t stride,
+                     const unsigned int* indices, size_t triangle_count);
+        // 3 floats per vertex, taken as they are
+        TriangleTree(std::vector<float> positions, std::vector<unsigned int> indices);
+        TriangleTree(const TriangleTree& other) = delete;
+
+        // triangles of a mesh, in the order Renderer::loadMesh triangulates its faces
+        static std::shared_ptr<TriangleTree> fromMesh(const common::Mesh<float>& mesh);
+
+        bool raycast(const common::Vector3<float>& origin, const common::Vector3<float>& direction,
+                     float max_t, Hit& hit) const;
+        size_t vertexCount() const { return _vertex_count; }
+        size_t triangleCount() const { return _triangle_count; }
+        // whether the triangles are these, 3 indices each
+        bool sameTriangles(const unsigned int* indices, size_t triangle_count) const;
+        // move count vertices from first to positions, 3 floats each, not once released
+        void updatePositions(size_t first, size_t count, const float* positions);
+        // 3 floats per vertex, not once released
+        void copyPositions(std::vector<float>& positions) const;
+
+        // drop the arrays and the hierarchy, cached as the policy says
+        void release(int policy);
+        // whether a query missed the arrays dropped entirely, which reload() gives back
+        bool wanted() const { return _wanted; }
+        void reload(std::vector<float> positions, std::vector<unsigned int> indices);
+        // memory held by the arrays, the hierarchy and the cache
+        size_t residentBytes() const;
+
+    private:
+        struct Node {
+            common::Vector3<float> min, max;
+            unsigned int first;     // first child (the second one follows), or first triangle of a leaf
+            unsigned int count;     // triangles of a leaf, 0 for internal nodes
+        };
+
+        void build() const;
+        // the boxes of the nodes around the moved positions, children coming after their parent
+        void refit() const;
+        // the released arrays back from the cache, false if they are not there
+        bool load() const;
+
+        size_t _vertex_count, _triangle_count;
+        mutable std::vector<float> _positions;
+        mutable std::vector<unsigned int> _indices;
+        mutable std::unique_ptr<GeometryCache> _cache;
+        mutable bool _released = false;
+        mutable std::atomic<bool> _wanted{false};
+        mutable std::shared_timed_mutex _mutex;
+        mutable bool _built = false;
+        mutable bool _stale = false;    // positions moved since the boxes were fitted
+        mutable std::vector<Node> _nodes;
+        mutable std::vector<unsigned int> _order;   // triangles in leaf order
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
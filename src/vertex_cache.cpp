@@ -0,0 +1,136 @@
+#include "vertex_cache.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace simple_viewer {
+
+    static const int CacheSize = 32;
+
+    static const unsigned int ValenceTableSize = 32;
+
+    // scores tabulated by position in the cache and triangles left
+    struct ScoreTables {
+        float cache[CacheSize];
+        float valence[ValenceTableSize];
+
+        ScoreTables() {
+            for (int i = 0; i < CacheSize; i++) {
+                // the last triangle's vertices are scored the same, so that its neighbours are not favoured
+                cache[i] = i < 3 ? 0.75f : std::pow(1.f - (float)(i - 3) / (CacheSize - 3), 1.5f);
+            }
+            for (unsigned int i = 0; i < ValenceTableSize; i++) valence[i] = i == 0 ? 0 : 2.f / std::sqrt((float)i);
+        }
+    };
+
+    static float vertexScore(const ScoreTables& tables, int cache_position, unsigned int remaining) {
+        if (remaining == 0) return -1;
+        float score = cache_position >= 0 ? tables.cache[cache_position] : 0;
+        return score + (remaining < ValenceTableSize ? tables.valence[remaining] : 2.f / std::sqrt((float)remaining));
+    }
+
+    std::vector<unsigned int> VertexCache::optimize(const unsigned int* indices, size_t triangle_count,
+                                                    size_t vertex_count) {
+        // triangles of every vertex
+        std::vector<unsigned int> offsets(vertex_count + 1, 0), remaining(vertex_count, 0);
+        for (size_t i = 0; i < triangle_count * 3; i++) offsets[indices[i] + 1]++;
+        for (size_t v = 0; v < vertex_count; v++) {
+            remaining[v] = offsets[v + 1];
+            offsets[v + 1] += offsets[v];
+        }
+        std::vector<unsigned int> adjacency(triangle_count * 3);
+        {
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < triangle_count * 3; i++) adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+
+        static const ScoreTables tables;
+        std::vector<int> cache_positions(vertex_count, -1);
+        std::vector<float> vertex_scores(vertex_count), triangle_scores(triangle_count, 0);
+        std::vector<char> emitted(triangle_count, 0);
+        for (size_t v = 0; v < vertex_count; v++) vertex_scores[v] = vertexScore(tables, -1, remaining[v]);
+        for (size_t i = 0; i < triangle_count * 3; i++) triangle_scores[i / 3] += vertex_scores[indices[i]];
+
+        std::vector<unsigned int> order;
+        order.reserve(triangle_count);
+        int cache[CacheSize + 3], cache_count = 0;
+        size_t next_scan = 0;
+        long long best = -1;
+        while (order.size() < triangle_count) {
+            if (best < 0) {
+                // nothing left around the cache, take the best triangle anywhere
+                float best_score = -1;
+                for (size_t t = next_scan; t < triangle_count; t++) {
+                    if (emitted[t]) {
+                        if (t == next_scan) next_scan++;
+                        continue;
+                    }
+                    if (triangle_scores[t] > best_score) {
+                        best_score = triangle_scores[t];
+                        best = (long long)t;
+                    }
+                }
+            }
+            auto triangle = (unsigned int)best;
+            emitted[triangle] = 1;
+            order.push_back(triangle);
+
+            // put its vertices in front of the cache and drop it from their triangles
+            int updated[CacheSize + 3], updated_count = 0;
+            for (int k = 0; k < 3; k++) {
+                auto v = indices[triangle * 3 + k];
+                auto* first = &adjacency[offsets[v]];
+                auto* last = first + remaining[v];
+                std::iter_swap(std::find(first, last, triangle), last - 1);
+                remaining[v]--;
+                updated[updated_count++] = (int)v;
+            }
+            for (int i = 0; i < cache_count; i++) {
+                if (cache[i] != updated[0] && cache[i] != updated[1] && cache[i] != updated[2]) {
+                    updated[updated_count++] = cache[i];
+                }
+            }
+            cache_count = std::min(updated_count, CacheSize);
+            for (int i = 0; i < updated_count; i++) {
+                if (i < CacheSize) cache[i] = updated[i];
+                cache_positions[updated[i]] = i < CacheSize ? i : -1;
+            }
+
+            // rescore the vertices that moved, and the triangles around them
+            best = -1;
+            float best_score = -1;
+            for (int i = 0; i < updated_count; i++) {
+                auto v = (unsigned int)updated[i];
+                float score = vertexScore(tables, cache_positions[v], remaining[v]);
+                float delta = score - vertex_scores[v];
+                vertex_scores[v] = score;
+                for (unsigned int j = 0; j < remaining[v]; j++) {
+                    auto t = adjacency[offsets[v] + j];
+                    triangle_scores[t] += delta;
+                    if (i < cache_count && triangle_scores[t] > best_score) {
+                        best_score = triangle_scores[t];
+                        best = t;
+                    }
+                }
+            }
+        }
+        return order;
+    }
+
+    float VertexCache::acmr(const unsigned int* indices, size_t triangle_count, size_t vertex_count,
+                            int cache_size) {
+        if (triangle_count == 0) return 0;
+        // a vertex is in the cache if it was loaded within the last cache_size misses
+        std::vector<unsigned long long> loaded(vertex_count, 0);
+        unsigned long long misses = 0;
+        for (size_t i = 0; i < triangle_count * 3; i++) {
+            auto& time = loaded[indices[i]];
+            if (time == 0 || misses - time >= (unsigned long long)cache_size) {
+                misses++;
+                time = misses;
+            }
+        }
+        return (float)misses / (float)triangle_count;
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
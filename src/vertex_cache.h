@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace simple_viewer {
+
+    /**
+     * @brief Post-transform vertex cache optimization of triangle lists
+     *
+     * Triangles are reordered with Forsyth's linear-speed algorithm: each step
+     * emits the triangle whose vertices score best, a vertex scoring higher
+     * when it was used recently (and so likely still in the cache), or when few
+     * of its triangles are left (so it does not linger and get evicted).
+     */
+    class VertexCache {
+    public:
+        // order to emit the triangles in, the indices referring to vertex_count vertices
+        static std::vector<unsigned int> optimize(const unsigned int* indices, size_t triangle_count,
+                                                  size_t vertex_count);
+        // average cache misses per triangle of a FIFO cache, 0.5 at best and 3 at worst
+        static float acmr(const unsigned int* indices, size_t triangle_count, size_t vertex_count,
+                          int cache_size = 16);
+    };
+
+} // namespace simple_viewer
\ No newline at end of file
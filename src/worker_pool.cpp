@@ -0,0 +1,122 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include "common/mesh.h"
+
+namespace simple_viewer {
+
+    // the parallel loops of the common headers (vertex normals, mesh parsing) run on the shared pool
+    static const bool common_executor = (common::detail::executor() =
+            [](size_t count, const std::function<void(size_t)>& body) {
+        WorkerPool::shared().parallelFor(count, 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) body(i);
+        });
+    }, true);
+
+    WorkerPool::WorkerPool(unsigned int threads): // NOLINT
+            _func(nullptr), _count(0), _grain(1), _next(0),
+            _busy(0), _generation(0), _running(0), _stop(false) {
+        if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        for (unsigned int i = 0; i < threads; i++) {
+            _threads.emplace_back(&WorkerPool::work, this);
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto& thread : _threads) thread.join();
+    }
+
+    WorkerPool& WorkerPool::shared() {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    void WorkerPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& func) {
+        if (count == 0) return;
+        if (grain == 0) grain = 1;
+        if (_threads.empty() || count <= grain) {
+            func(0, count);
+            return;
+        }
+
+        // another thread's loop has the workers: run this one alone rather than queue behind it
+        std::unique_lock<std::mutex> run_lock(_run_mutex, std::try_to_lock);
+        if (!run_lock.owns_lock()) {
+            func(0, count);
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _func = &func;
+            _count = count;
+            _grain = grain;
+            _next.store(0);
+            _generation++;
+        }
+        _wake.notify_all();
+        runChunks();
+
+        // the workers that joined in time, the others find no chunk left and stay out
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _busy == 0; });
+        _func = nullptr;
+    }
+
+    void WorkerPool::submit(std::function<void()> task) {
+        if (_threads.empty()) {
+            task();
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _tasks.push_back(std::move(task));
+        }
+        _wake.notify_one();
+    }
+
+    void WorkerPool::wait() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _tasks.empty() && _running == 0; });
+    }
+
+    void WorkerPool::runChunks() {
+        while (true) {
+            size_t begin = _next.fetch_add(_grain);
+            if (begin >= _count) break;
+            (*_func)(begin, std::min(begin + _grain, _count));
+        }
+    }
+
+    void WorkerPool::work() {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _wake.wait(lock, [&]() { return _stop || _generation != seen || !_tasks.empty(); });
+            if (_stop) return;
+            if (_generation != seen) {
+                seen = _generation;
+                if (_func == nullptr || _next.load() >= _count) continue;
+                _busy++;
+                lock.unlock();
+                runChunks();
+                lock.lock();
+                if (--_busy == 0) _done.notify_all();
+                continue;
+            }
+            auto task = std::move(_tasks.front());
+            _tasks.pop_front();
+            _running++;
+            lock.unlock();
+            task();
+            lock.lock();
+            _running--;
+            if (_tasks.empty() && _running == 0) _done.notify_all();
+        }
+    }
+
+} // namespace simple_viewer
\ No newline at end of file
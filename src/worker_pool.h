@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace simple_viewer {
+
+    /**
+     * @brief A fixed set of worker threads running parallel loops and background tasks
+     *
+     * parallelFor() cuts [0, count) into chunks of grain items, which the
+     * idle workers and the calling thread take in turn, and returns when all of
+     * them are done. Loops of one chunk run on the calling thread only, and so
+     * does a loop started while another thread's loop has the workers, so that
+     * the render thread never waits for a parse or normal pass. Loops must not
+     * be nested.
+     *
+     * submit() queues a task for the first idle worker, loops going first.
+     * A loop never waits for the workers busy with a task, the calling thread
+     * taking their share, so long tasks only slow it down.
+     */
+    class WorkerPool {
+    public:
+        // 0 threads: one less than the hardware threads, as the caller works too
+        explicit WorkerPool(unsigned int threads = 0);
+        WorkerPool(const WorkerPool& other) = delete;
+        ~WorkerPool();
+
+        void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& func);
+        // run on the calling thread if there are no workers. Tasks still queued when the pool goes are dropped
+        void submit(std::function<void()> task);
+        // until the tasks queued so far, and those they queue, are done
+        void wait();
+        unsigned int size() const { return (unsigned int)_threads.size(); }
+
+        static WorkerPool& shared();
+
+    private:
+        void work();
+        void runChunks();
+
+        std::vector<std::thread> _threads;
+        std::mutex _run_mutex;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::condition_variable _done;
+        const std::function<void(size_t, size_t)>* _func;
+        size_t _count, _grain;
+        std::atomic<size_t> _next;
+        unsigned int _busy;                 // workers in the loop
+        unsigned long long _generation;
+        std::deque<std::function<void()>> _tasks;
+        unsigned int _running;              // tasks being run
+        bool _stop;
+    };
+
+} // namespace simple_viewer
\ No newline at end of file